@@ -6,6 +6,7 @@ import (
 	"encoding/json"
 	"log/slog"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/audioapi"
@@ -16,6 +17,11 @@ import (
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
 )
 
+// The number of peers mixed into the client's audio output at once, by default.
+// Rarely do more than two or three people talk at once, so the quietest peers of a large room
+// are not mixed, nor is their audio processed beyond measuring its loudness.
+const DEFAULT_MAX_ACTIVE_SPEAKERS = 3
+
 // The main application representation for the client.
 //
 // Holds references to the audio input / output devices,
@@ -59,27 +65,49 @@ type App struct {
 	audioIODeviceAPI audioapi.AudioIODeviceAPI
 
 	// Audio Data Flow from Application to Peer (input path)
-	// | ----------------------------------- Application ----------------------------------- |	   | -------- ApplicationPeer -------- |
-	// Client's audio input device (e.g. microphone) -> AudioAugmentationDevice -> FanOutDevice -> [AudioFormatConversionDevice -> Peer]
+	// | -------------------------------------------------------- Application -------------------------------------------------------- |
+	// Client's audio input device (e.g. microphone) -> AudioAugmentationDevice -> FanOutDevice -> AudioFormatConversionDevice -> EncoderGroup -> Peers
+	//
+	// There is one AudioFormatConversionDevice and EncoderGroup per distinct negotiated codec,
+	// so the audio is converted and encoded once per codec, rather than once per peer.
 
 	// The audio input device of the client, i.e. the microphone of choice
 	audioInputDevice audiodevice.AudioSourceDevice
 
-	// Augmentation of the input audio, e.g. for setting this client's volume before sending to the remote peer
-	inputAugmentationDevice *device.AudioAugmentationDevice
+	// Augmentation of the input audio, e.g. for setting this client's volume before sending to the remote peer,
+	// and detection of whether this client is speaking (dropping silence, if suppressSilence is set).
+	// Atomic, as it is replaced by SetInputDevice while it may be read (e.g. by IsSpeaking) on another goroutine.
+	inputAugmentationDevice atomic.Pointer[device.AudioAugmentationDevice]
+	// Whether silence from the audio input device is dropped rather than encoded and sent.
+	// Atomic, as it may be set while the input device is being changed.
+	suppressSilence atomic.Bool
 
-	// FanOutDevice to copy audio data from the microphone (more specifically the inputAugmentationDevice) to all connected peers
+	// FanOutDevice to copy audio data from the microphone (more specifically the inputAugmentationDevice) to all encoder groups
 	inputFanOutDevice *device.FanOutDevice
 
+	// Encode audio once for all peers sharing a codec, then send it to each of those peers
+	encoderGroups *peer.EncoderGroups
+
+	// Convert from client format to the codec format of each encoder group
+	// e.g. from microphone device properties to connection device properties.
+	encoderGroupConversionDevices map[*peer.EncoderGroup]*device.AudioFormatConversionDevice
+
 	// Audio Data Flow from Peer to Application (output path)
 	// | ---------------------- ApplicationPeer ---------------------- |    | -------------------- Application -------------------- |
-	// [ Peer -> AudioFormatConversionDevice -> AudioAugmentationDevice] -> FanInDevice -> Client's audio output device (e.g. speaker)
+	// [ Peer -> PipelineDevice (format conversion + augmentation) ] -> FanInDevice -> Client's audio output device (e.g. speaker)
+	//
+	// Where the output device supports it (see audiodevice.AudioPullSinkDevice), the output device
+	// pulls the mix from the FanInDevice directly, rather than the FanInDevice pushing frames on a ticker.
 
 	// The audio output device, i.e. the speaker of choice
 	audioOutputDevice audiodevice.AudioSinkDevice
 
 	// FanInDevice to mix audio from all connected peers back into a single frame to send to speakers
 	outputFanInDevice *device.FanInDevice
+
+	// The number of the loudest peers mixed by the outputFanInDevice, or 0 to mix every peer.
+	// Atomic, as it may be set while the output device is being changed.
+	maxActiveSpeakers atomic.Int32
 }
 
 // --------------------------------------------------------------------------------
@@ -96,9 +124,14 @@ func NewApp(
 		connectedPeers:          make([]*ApplicationPeer, 0),
 		rejectedPeerIdentifiers: make([]signalling.PeerIdentifier, 0),
 
+		encoderGroups:                 peer.NewEncoderGroups(),
+		encoderGroupConversionDevices: make(map[*peer.EncoderGroup]*device.AudioFormatConversionDevice),
+
 		audioIODeviceAPI: audioIODeviceAPI,
 		// The remaining audio struct items are initialized by calls to SetInputDevice, SetOutputDevice
 	}
+	app.maxActiveSpeakers.Store(int32(DEFAULT_MAX_ACTIVE_SPEAKERS))
+	app.suppressSilence.Store(true)
 
 	// --------------------------------------------------------------------------------
 	// Set the initial input/output devices to defaults.
@@ -135,34 +168,60 @@ func (app *App) handleConnectedPeer(newPeer *peer.Peer) {
 	app.connectedPeersMutex.Lock()
 	defer app.connectedPeersMutex.Unlock()
 
-	sinkAudioFormatConversionDevice := device.NewAudioFormatConversionDevice(
-		app.audioInputDevice.GetDeviceProperties(),
-		newPeer.GetDeviceProperties(),
-	)
-	newPeer.SetStream(sinkAudioFormatConversionDevice.GetStream())
-	sinkAudioFormatConversionDevice.SetStream(app.inputFanOutDevice.GetStream())
+	encoderGroup, isNewEncoderGroup, err := app.encoderGroups.Join(newPeer)
+	if err != nil {
+		slog.Error("failed to join encoder group", "peer", newPeer.Identifier(), "err", err)
+		newPeer.Close()
+		return
+	}
+	// Only a new group needs a source, otherwise the group is already sending audio
+	if isNewEncoderGroup {
+		conversionDevice := device.NewAudioFormatConversionDevice(
+			app.audioInputDevice.GetDeviceProperties(),
+			encoderGroup.GetDeviceProperties(),
+		)
+		conversionDevice.SetStream(app.inputFanOutDevice.GetStream())
+		audiodevice.Connect(&conversionDevice, encoderGroup)
+		app.encoderGroupConversionDevices[encoderGroup] = &conversionDevice
+		go app.closeEncoderGroupSource(encoderGroup)
+	}
 
-	sourceAudioFormatConversionDevice := device.NewAudioFormatConversionDevice(
+	sourceActivity := device.NewSourceActivity()
+	sourceAudioAugmentation := device.NewAudioAugmentation()
+	// The peer ranks among the speakers at the volume it is played at
+	sourceActivity.WeightByVolume(sourceAudioAugmentation)
+	sourcePipelineDevice := newSourcePipelineDevice(
 		newPeer.GetDeviceProperties(),
 		app.audioOutputDevice.GetDeviceProperties(),
+		sourceActivity,
+		sourceAudioAugmentation,
 	)
-	sourceAudioAugmentationDevice := device.NewAudioAugmentationDevice(
-		app.audioInputDevice.GetDeviceProperties(),
-	)
-	sourceAudioFormatConversionDevice.SetStream(newPeer.GetStream())
-	sourceAudioAugmentationDevice.SetStream(sourceAudioFormatConversionDevice.GetStream())
-	app.outputFanInDevice.SetStream(sourceAudioAugmentationDevice.GetStream())
+	sourcePipelineDevice.SetStream(newPeer.GetStream())
+	app.outputFanInDevice.ConnectWithActivity(sourcePipelineDevice, sourceActivity)
 
 	appPeer := ApplicationPeer{
-		peer:                              newPeer,
-		sourceAudioAugmentationDevice:     sourceAudioAugmentationDevice,
-		sourceAudioFormatConversionDevice: &sourceAudioFormatConversionDevice,
-		sinkAudioFormatConversionDevice:   &sinkAudioFormatConversionDevice,
+		peer:                    newPeer,
+		sourceActivity:          sourceActivity,
+		sourceAudioAugmentation: sourceAudioAugmentation,
+		sourcePipelineDevice:    sourcePipelineDevice,
 	}
 
 	app.connectedPeers = append(app.connectedPeers, &appPeer)
 }
 
+// Once the given group is dropped (i.e. its last peer is closed), stop converting audio for it.
+func (app *App) closeEncoderGroupSource(encoderGroup *peer.EncoderGroup) {
+	<-encoderGroup.Done()
+
+	app.connectedPeersMutex.Lock()
+	defer app.connectedPeersMutex.Unlock()
+	// The conversion device may have been replaced since (see SetInputDevice), so it is looked up now
+	if conversionDevice, ok := app.encoderGroupConversionDevices[encoderGroup]; ok {
+		conversionDevice.Close()
+		delete(app.encoderGroupConversionDevices, encoderGroup)
+	}
+}
+
 // --------------------------------------------------------------------------------
 // Getters and Setters for App
 // May be useful in TUI calls
@@ -185,7 +244,8 @@ func (app *App) Close() {
 func (app *App) SetInputDevice(inputDevice audiodevice.AudioSourceDevice) {
 	inputDeviceProperties := inputDevice.GetDeviceProperties()
 
-	inputAugmentationDevice := device.NewAudioAugmentationDevice(inputDeviceProperties)
+	inputAugmentationDevice := device.NewAudioAugmentationDeviceWithVoiceActivityDetection(inputDeviceProperties)
+	inputAugmentationDevice.VoiceActivityDetector().SetSuppressSilence(app.suppressSilence.Load())
 	inputAugmentationDevice.SetStream(inputDevice.GetStream())
 
 	inputFanOutDevice := device.NewFanOutDevice(inputDeviceProperties)
@@ -198,21 +258,22 @@ func (app *App) SetInputDevice(inputDevice audiodevice.AudioSourceDevice) {
 	// Update affected devices moving from right to left
 	// To avoid accidentally sending new frames to peers before all conversion are set up
 	//
-	// | ----------------------------------- Application ----------------------------------- |	   | -------- ApplicationPeer -------- |
-	// Client's audio input device (e.g. microphone) -> AudioAugmentationDevice -> FanOutDevice -> [AudioFormatConversionDevice -> Peer]
+	// | -------------------------------------------------------- Application -------------------------------------------------------- |
+	// Client's audio input device (e.g. microphone) -> AudioAugmentationDevice -> FanOutDevice -> AudioFormatConversionDevice -> EncoderGroup -> Peers
 
 	app.connectedPeersMutex.Lock()
-	for _, appPeer := range app.connectedPeers {
-		newSinkAudioFormatConversionDevice := device.NewAudioFormatConversionDevice(
+	for encoderGroup, oldConversionDevice := range app.encoderGroupConversionDevices {
+		newConversionDevice := device.NewAudioFormatConversionDevice(
 			inputDeviceProperties,
-			appPeer.peer.GetDeviceProperties(),
+			encoderGroup.GetDeviceProperties(),
 		)
 
-		appPeer.peer.SetStream(newSinkAudioFormatConversionDevice.GetStream())
-		newSinkAudioFormatConversionDevice.SetStream(inputFanOutDevice.GetStream())
+		newConversionDevice.SetStream(inputFanOutDevice.GetStream())
+		audiodevice.Connect(&newConversionDevice, encoderGroup)
 
-		appPeer.sinkAudioFormatConversionDevice.Close()
-		appPeer.sinkAudioFormatConversionDevice = &newSinkAudioFormatConversionDevice
+		// Closing the old device closes the RingStream the group reads it from
+		oldConversionDevice.Close()
+		app.encoderGroupConversionDevices[encoderGroup] = &newConversionDevice
 	}
 	app.connectedPeersMutex.Unlock()
 
@@ -222,8 +283,10 @@ func (app *App) SetInputDevice(inputDevice audiodevice.AudioSourceDevice) {
 		defer oldInputDevice.Close()
 	}
 	app.audioInputDevice = inputDevice
-	app.inputAugmentationDevice = inputAugmentationDevice
+	app.inputAugmentationDevice.Store(inputAugmentationDevice)
 	app.inputFanOutDevice = &inputFanOutDevice
+	// Apply the setting again, in case it was changed while the new device was being made
+	inputAugmentationDevice.VoiceActivityDetector().SetSuppressSilence(app.suppressSilence.Load())
 
 	slog.Debug("updated set input device", "new properties", app.audioInputDevice.GetDeviceProperties())
 }
@@ -234,7 +297,8 @@ func (app *App) SetOutputDevice(outputDevice audiodevice.AudioSinkDevice) {
 	// TODO: Handle wait latency better
 	// Maybe have this be dependency injected? Or read from Viper?
 	outputFanInDevice := device.NewFanInDevice(outputDeviceProperties, 20*time.Millisecond)
-	outputDevice.SetStream(outputFanInDevice.GetStream())
+	outputFanInDevice.SetMaxActiveSources(int(app.maxActiveSpeakers.Load()))
+	audiodevice.Connect(outputFanInDevice, outputDevice)
 
 	// Change all peers to work with new output
 	// Note we are changing the output device, and hence possibly also the output device properties
@@ -244,21 +308,23 @@ func (app *App) SetOutputDevice(outputDevice audiodevice.AudioSinkDevice) {
 	// to avoid the FanInDevice consuming frames in the wrong format
 	//
 	// | ---------------------- ApplicationPeer ---------------------- |    | -------------------- Application -------------------- |
-	// [ Peer -> AudioFormatConversionDevice -> AudioAugmentationDevice] -> FanInDevice -> Client's audio output device (e.g. speaker)
+	// [ Peer -> PipelineDevice (format conversion + augmentation) ] -> FanInDevice -> Client's audio output device (e.g. speaker)
 
 	app.connectedPeersMutex.Lock()
 	for _, appPeer := range app.connectedPeers {
-		newSourceAudioFormatConversionDevice := device.NewAudioFormatConversionDevice(
+		// The activity and augmentation are carried over, so the peer's loudness and volume are kept
+		newSourcePipelineDevice := newSourcePipelineDevice(
 			appPeer.peer.GetDeviceProperties(),
 			outputDeviceProperties,
+			appPeer.sourceActivity,
+			appPeer.sourceAudioAugmentation,
 		)
 
-		newSourceAudioFormatConversionDevice.SetStream(appPeer.peer.GetStream())
-		appPeer.sourceAudioAugmentationDevice.SetStream(newSourceAudioFormatConversionDevice.GetStream())
-		outputFanInDevice.SetStream(appPeer.sourceAudioAugmentationDevice.GetStream())
+		newSourcePipelineDevice.SetStream(appPeer.peer.GetStream())
+		outputFanInDevice.ConnectWithActivity(newSourcePipelineDevice, appPeer.sourceActivity)
 
-		appPeer.sourceAudioFormatConversionDevice.Close()
-		appPeer.sourceAudioFormatConversionDevice = &newSourceAudioFormatConversionDevice
+		appPeer.sourcePipelineDevice.Close()
+		appPeer.sourcePipelineDevice = newSourcePipelineDevice
 	}
 	app.connectedPeersMutex.Unlock()
 
@@ -269,10 +335,36 @@ func (app *App) SetOutputDevice(outputDevice audiodevice.AudioSinkDevice) {
 	}
 	app.outputFanInDevice = outputFanInDevice
 	app.audioOutputDevice = outputDevice
+	// Apply the limit again, in case it was changed while the new device was being made
+	outputFanInDevice.SetMaxActiveSources(int(app.maxActiveSpeakers.Load()))
 
 	slog.Debug("updated set output device", "new properties", app.audioOutputDevice.GetDeviceProperties())
 }
 
+// Set the number of the loudest peers mixed into the client's audio output at once,
+// or 0 to mix every peer. See DEFAULT_MAX_ACTIVE_SPEAKERS.
+func (app *App) SetMaxActiveSpeakers(maxActiveSpeakers int) {
+	app.maxActiveSpeakers.Store(int32(max(maxActiveSpeakers, 0)))
+	if app.outputFanInDevice != nil {
+		app.outputFanInDevice.SetMaxActiveSources(maxActiveSpeakers)
+	}
+}
+
+// Whether this client is currently speaking, i.e. whether voice is detected on the audio input device.
+func (app *App) IsSpeaking() bool {
+	inputAugmentationDevice := app.inputAugmentationDevice.Load()
+	return inputAugmentationDevice != nil && inputAugmentationDevice.VoiceActivityDetector().Speaking()
+}
+
+// Set whether silence on the audio input device is dropped, rather than encoded and sent to every peer.
+// Enabled by default, as silence then costs (almost) no CPU or bandwidth.
+func (app *App) SetSuppressSilence(suppressSilence bool) {
+	app.suppressSilence.Store(suppressSilence)
+	if inputAugmentationDevice := app.inputAugmentationDevice.Load(); inputAugmentationDevice != nil {
+		inputAugmentationDevice.VoiceActivityDetector().SetSuppressSilence(suppressSilence)
+	}
+}
+
 // Taking the remote peer information as a Base64-encoded JSON-representation of the signalling.PeerIdentifier
 // dial the peer specified and return.
 //
@@ -303,3 +395,23 @@ func (app *App) DialRemotePeer(ctx context.Context, encodedPeerIdentifier string
 	// but unblock the main thread in the mean time.
 	return nil
 }
+
+// Create the device processing the audio received from a peer, before it is mixed by the FanInDevice.
+//
+// The format conversion and augmentation are fused into a single pipeline,
+// so each peer costs one processing goroutine rather than one per stage.
+// The activity is measured first, so a peer that is not being mixed skips the rest of the pipeline,
+// and is weighted by the volume of the augmentation (see SourceActivity.WeightByVolume).
+func newSourcePipelineDevice(
+	peerDeviceProperties audiodevice.DeviceProperties,
+	outputDeviceProperties audiodevice.DeviceProperties,
+	activity *device.SourceActivity,
+	augmentation *device.AudioAugmentation,
+) *device.PipelineDevice {
+	pipeline := device.NewPipelineBuilder(peerDeviceProperties).
+		MeasureActivity(activity).
+		ConvertFormat(outputDeviceProperties).
+		Augment(augmentation).
+		Build()
+	return device.NewPipelineDevice(pipeline)
+}
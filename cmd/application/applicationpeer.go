@@ -4,7 +4,6 @@ import (
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/peer"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice/device"
-	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
 )
 
 // A wrapper around a Peer (github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/peer/peer.go)
@@ -12,8 +11,7 @@ import (
 //
 // The Peer itself is included, meaning the codec and many networking elements are included,
 // as is the PeerIdentifier (github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling/peeridentifier.go)
-// so is the AudioFormatConversionDevice (github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice/device/audioformatconversiondevice.go)
-// and so is the AudioAugmentationDevice (github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice/device/audioaugmentationdevice.go)
+// and so is the PipelineDevice (github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice/device/pipelinedevice.go)
 //
 // Effectively, this struct is a nice interface for sending/receiving audio from the network at an application-level without
 // worrying about the underlying devices.
@@ -21,8 +19,8 @@ import (
 // If you need an identifier for this struct, consider appPeer.peer.Identifier(), which gives the identifier
 // of the underlying peer (i.e. the UUID and address of the remote client represented by this peer)
 //
-// When modelling this struct as a AudioSourceDevice, the PCMFrames are sourced from the AudioAugmentationDevice,
-// (which comes after the AudioFormatConversionDevice) and not the Peer directly.
+// When modelling this struct as a AudioSourceDevice, the PCMFrames are sourced from the PipelineDevice,
+// (which applies both the format conversion and the audio augmentation) and not the Peer directly.
 // This means that, assuming everything has been constructed correctly, the PCMFrames sourced are in the same format as the
 // client's AudioOutputDevice.
 // It is *not* enforced that the audio arrives with a specific frame duration, e.g. one ApplicationPeer might source frames
@@ -31,56 +29,65 @@ import (
 // It is expected that the SourceStream of this struct is added to a FanInDevice to mix the audio from multiple peers at once.
 // The FanInDevice will also handle the above issue of frame durations by buffering the sourced frames and producing
 // evenly sampled lengths from each input.
-// | ---------------------- ApplicationPeer ---------------------- |
-// [ Peer -> AudioFormatConversionDevice -> AudioAugmentationDevice] -> FanInDevice -> Client's audio output device (e.g. speaker)
+// | ------------------------- ApplicationPeer ------------------------- |
+// [ Peer -> PipelineDevice (format conversion + augmentation) ] -> FanInDevice -> Client's audio output device (e.g. speaker)
 //
-// When modelling this struct as a AudioSinkDevice, the PCMFrames are fed into an AudioFormatConversionDevice, and not the Peer directly.
-// This means that the sink frames are expected to be in the format of the client's audio input device, i.e.
-// frames may have a different sample rate, different number of channels, or a different frame duration than
-// what is expected by the underlying peer, but this is handled by the audioFormatConversionDevice.
-// The SinkStream of this peer should be added to a FanOutDevice to allow the client's audio input device to be passed to multiple peers.
-// \							 															   | -------- ApplicationPeer -------- |
-// Client's audio input device (e.g. microphone) -> AudioAugmentationDevice -> FanOutDevice -> [AudioFormatConversionDevice -> Peer]
+// Audio is sent to the peer through an EncoderGroup (github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/peer/encodergroup.go)
+// shared by all peers with the same negotiated codec, so the client's audio is converted and encoded once per codec, not once per peer.
+// The App owns the EncoderGroups, and feeds each from the FanOutDevice through its own AudioFormatConversionDevice.
+// Client's audio input device (e.g. microphone) -> AudioAugmentationDevice -> FanOutDevice -> AudioFormatConversionDevice -> EncoderGroup -> Peers
 //
 // A new ApplicationPeer should be constructed by listening to the ConnectionManager's ConnectedPeerChannel for newly connected peers
 // (github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/networking/connectionmanager.go)
 type ApplicationPeer struct {
 	peer *peer.Peer
 
-	// Process the audio coming from the connection
+	// The loudness of the audio coming from the connection, used to decide whether
+	// the peer is one of the active speakers mixed by the FanInDevice
+	sourceActivity *device.SourceActivity
+
+	// Augmentations applied to the audio coming from the connection
 	// This augments the audio from a remote peer, *not* the audio from the client!
 	// The client audio augmentation should occur before the FanOutDevice,
 	// i.e. right after the microphone input.
-	sourceAudioAugmentationDevice *device.AudioAugmentationDevice
-
-	// Convert from peer format to client format
-	// e.g. from connection device properties to speaker device properties.
-	sourceAudioFormatConversionDevice *device.AudioFormatConversionDevice
+	sourceAudioAugmentation *device.AudioAugmentation
 
-	// Convert from client format to peer format
-	// e.g. from microphone device properties to connection device properties.
-	sinkAudioFormatConversionDevice *device.AudioFormatConversionDevice
+	// Process the audio coming from the connection in a single pipeline:
+	// convert from peer format to client format (e.g. from connection device properties
+	// to speaker device properties), then apply the sourceAudioAugmentation.
+	sourcePipelineDevice *device.PipelineDevice
 }
 
+// Close the peer. Closing the peer also removes it from its EncoderGroup.
 func (p ApplicationPeer) Close() {
-	// This is a tremendously unfortunate hack, but since we have no way to
-	// naturally close the fan-out device, we have to just make the peer stop listening
-	//
-	// Eventually, the timeout on the fanout device will deal with this
-	p.sinkAudioFormatConversionDevice.SetStream(make(<-chan frame.PCMFrame))
 	p.peer.Close()
 }
 
 // Get the device properties for the sourced PCMFrames, i.e. the properties of the device *after* conversion
-// through the AudioFormatConversionDevice
+// through the PipelineDevice
 func (p ApplicationPeer) GetDeviceProperties() audiodevice.DeviceProperties {
-	return p.sourceAudioAugmentationDevice.GetDeviceProperties()
+	return p.sourcePipelineDevice.GetDeviceProperties()
 }
 
+// Set the volume of the audio from the remote peer. A volume of 0 mutes the peer, which skips
+// decoding, converting, and mixing its audio altogether (see peer.Peer.SetMuted).
 func (p ApplicationPeer) SetVolume(newVolume float32) {
-	p.sourceAudioAugmentationDevice.SetVolumeAdjustMagnitude(newVolume)
+	p.sourceAudioAugmentation.SetVolumeAdjustMagnitude(newVolume)
+	muted := p.sourceAudioAugmentation.GetVolumeAdjustMagnitude() == 0
+	// Mute first, so no audio is decoded after the loudness of the peer is forgotten
+	p.peer.SetMuted(muted)
+	if muted {
+		// No more audio arrives to lower the loudness of the peer, so make sure it gives up its place among the active speakers.
+		// The loudness itself is reset by the pipeline of the peer, which measures it.
+		p.sourceActivity.Silence()
+	}
 }
 
 func (p ApplicationPeer) GetVolume() float32 {
-	return p.sourceAudioAugmentationDevice.GetVolumeAdjustMagnitude()
+	return p.sourceAudioAugmentation.GetVolumeAdjustMagnitude()
+}
+
+// Whether the peer is currently one of the active speakers mixed into the client's audio output.
+func (p ApplicationPeer) IsActiveSpeaker() bool {
+	return p.sourceActivity.Selected()
 }
@@ -55,9 +55,27 @@ func setViperDefaults() {
 	viper.SetDefault("logfile", "")
 	viper.SetDefault("localport", 1066)
 	viper.SetDefault("timeout", 30)
+	viper.SetDefault("TrickleICE", false)
 	viper.SetDefault("codecs", []string{"CodecOpus48000Mono", "CodecOpus24000Mono", "CodecOpus48000Stereo", "CodecOpus24000Stereo"})
 	viper.SetDefault("OPUSFrameDuration", encoderdecoder.OPUS_FRAME_DURATION_20_MS)
+	viper.SetDefault("OPUSMinFrameDuration", encoderdecoder.OPUS_FRAME_DURATION_10_MS)
+	viper.SetDefault("OPUSMaxFrameDuration", encoderdecoder.OPUS_FRAME_DURATION_60_MS)
 	viper.SetDefault("OPUSBufferSafetyFactor", 16)
+
+	defaultOpusEncoderSettings := encoderdecoder.DefaultOpusEncoderSettings()
+	viper.SetDefault("OPUSBitrate", defaultOpusEncoderSettings.Bitrate)
+	viper.SetDefault("OPUSComplexity", defaultOpusEncoderSettings.Complexity)
+	viper.SetDefault("OPUSInBandFEC", defaultOpusEncoderSettings.InBandFEC)
+	viper.SetDefault("OPUSDTX", defaultOpusEncoderSettings.DTX)
+	viper.SetDefault("OPUSPacketLossPercentage", defaultOpusEncoderSettings.PacketLossPercentage)
+	viper.SetDefault("OPUSCodecWorkers", 0)
+	viper.SetDefault("Forwarder", false)
+	viper.SetDefault("ForwarderMaxActiveSpeakers", 3)
+	viper.SetDefault("ForwarderClient", false)
+	viper.SetDefault("Mixer", false)
+	viper.SetDefault("MixerMaxActiveSpeakers", 3)
+	viper.SetDefault("MixerSampleRate", 48000)
+	viper.SetDefault("MixerNumChannels", 1)
 }
 
 func LoadConfig(configFilePath string) {
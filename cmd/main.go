@@ -9,6 +9,7 @@ import (
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/networking"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/peer"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/utils"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
 	"github.com/google/uuid"
 	"github.com/pion/webrtc/v4"
@@ -39,12 +40,39 @@ func initializeConnectionManager(localPeerIdentifier signalling.PeerIdentifier)
 		slog.Error("error when creating OPUS factory", "err", err)
 		panic(err)
 	}
+	opusFactory, err = opusFactory.WithEncoderSettings(encoderdecoder.OpusEncoderSettings{
+		Bitrate:              viper.GetInt("OPUSBitrate"),
+		Complexity:           viper.GetInt("OPUSComplexity"),
+		InBandFEC:            viper.GetBool("OPUSInBandFEC"),
+		DTX:                  viper.GetBool("OPUSDTX"),
+		PacketLossPercentage: viper.GetInt("OPUSPacketLossPercentage"),
+	})
+	if err != nil {
+		slog.Error("error when configuring OPUS encoder settings", "err", err)
+		panic(err)
+	}
+	// The frame duration of each peer adapts to its network, within the configured range (always including OPUSFrameDuration)
+	opusFactory, err = opusFactory.WithFrameDurationRange(
+		min(viper.GetDuration("OPUSMinFrameDuration"), opusFactory.GetFrameDuration()),
+		max(viper.GetDuration("OPUSMaxFrameDuration"), opusFactory.GetFrameDuration()),
+	)
+	if err != nil {
+		slog.Error("error when configuring OPUS frame duration range", "err", err)
+		panic(err)
+	}
+	// Every peer's encoder and decoder runs on one of a fixed set of workers, rather than on its own goroutines
+	opusFactory = opusFactory.WithCodecWorkerPool(encoderdecoder.NewCodecWorkerPool(viper.GetInt("OPUSCodecWorkers")))
 
 	peerFactory := peer.NewPeerFactory(
 		codecs[0],
 		opusFactory,
 		slog.Default(),
 	)
+	// Through a forwarding node, each active speaker is received on an audio track of its own.
+	// In a full mesh, each connection carries a single peer, so needs no more than one track.
+	if viper.GetBool("Forwarder") || viper.GetBool("ForwarderClient") {
+		peerFactory.SetNumAudioTracks(viper.GetInt("ForwarderMaxActiveSpeakers"))
+	}
 
 	// --------------------------------------------------------------------------------
 
@@ -55,7 +83,7 @@ func initializeConnectionManager(localPeerIdentifier signalling.PeerIdentifier)
 	offerOptions := webrtc.OfferOptions{}
 	answerOptions := webrtc.AnswerOptions{}
 
-	return networking.NewConnectionManager(
+	connectionManager := networking.NewConnectionManager(
 		viper.GetInt("localport"),
 		viper.GetString("signallingserver"),
 		peerFactory,
@@ -66,6 +94,8 @@ func initializeConnectionManager(localPeerIdentifier signalling.PeerIdentifier)
 		answerOptions,
 		slog.Default(),
 	)
+	connectionManager.SetTrickleICE(viper.GetBool("TrickleICE"))
+	return connectionManager
 }
 
 func main() {
@@ -95,6 +125,25 @@ func main() {
 
 	connectionManager := initializeConnectionManager(localPeerIdentifier)
 
+	switch {
+	case viper.GetBool("Forwarder"):
+		// As the forwarding node of a room, every peer that connects joins the room, and has its audio forwarded to the others
+		forwarder := peer.NewForwarder()
+		forwarder.SetMaxActiveSpeakers(max(viper.GetInt("ForwarderMaxActiveSpeakers"), 1))
+		go forwarder.Serve(connectionManager.ConnectedPeerChannel)
+	case viper.GetBool("Mixer"):
+		// As the mixing node of a room, every peer that connects joins the room, and is sent the mix of the others
+		mixer := peer.NewMixer(
+			audiodevice.DeviceProperties{
+				SampleRate:  viper.GetInt("MixerSampleRate"),
+				NumChannels: viper.GetInt("MixerNumChannels"),
+			},
+			viper.GetDuration("OPUSFrameDuration"),
+		)
+		mixer.SetMaxActiveSpeakers(viper.GetInt("MixerMaxActiveSpeakers"))
+		go mixer.Serve(connectionManager.ConnectedPeerChannel)
+	}
+
 	// Keep process alive for pings to pass
 	select {}
 }
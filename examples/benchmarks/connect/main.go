@@ -0,0 +1,221 @@
+package main
+
+import (
+	"bytes"
+	"context"
+	"encoding/json"
+	"flag"
+	"fmt"
+	"io"
+	"log/slog"
+	"net"
+	"net/http"
+	"os"
+	"slices"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/networking"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/peer"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
+	"github.com/google/uuid"
+	"github.com/pion/webrtc/v4"
+)
+
+// Benchmark the time from ConnectionManager.Dial to both peers being connected, with and without trickle ICE.
+//
+// Two ConnectionManagers connect over the loopback interface, through a local stand-in for the signalling server,
+// which forwards each request to the answering peer after a configurable delay. Each is measured with only host
+// candidates, and with a STUN server that never responds (as a slow or unreachable STUN server would), in which
+// case gathering only completes once the STUN requests time out.
+func main() {
+	iterations := flag.Int("iterations", 3, "number of connections measured for each scenario")
+	signallingLatency := flag.Duration("signallingLatency", 20*time.Millisecond, "delay of the signalling server, each way")
+	basePort := flag.Int("basePort", 1370, "local port of the signalling server. Peers listen on the ports after it")
+	flag.Parse()
+
+	slog.SetDefault(slog.New(slog.NewTextHandler(os.Stderr, &slog.HandlerOptions{Level: slog.LevelError})))
+
+	signallingServerAddress := fmt.Sprintf("http://127.0.0.1:%d", *basePort)
+	go serveSignalling(*basePort, *signallingLatency)
+
+	// A STUN server that never responds
+	unresponsiveSTUNServer, err := net.ListenPacket("udp4", "127.0.0.1:0")
+	if err != nil {
+		panic(err)
+	}
+	defer unresponsiveSTUNServer.Close()
+	go func() {
+		buffer := make([]byte, 1500)
+		for {
+			if _, _, err := unresponsiveSTUNServer.ReadFrom(buffer); err != nil {
+				return
+			}
+		}
+	}()
+
+	scenarios := []struct {
+		name       string
+		iceServers []webrtc.ICEServer
+	}{
+		{"host candidates", nil},
+		{"unresponsive STUN", []webrtc.ICEServer{{URLs: []string{"stun:" + unresponsiveSTUNServer.LocalAddr().String()}}}},
+	}
+
+	fmt.Printf(
+		"%-20s %-14s %14s %16s %16s %16s\n",
+		"scenario", "ICE", "dial ms", "connected ms", "min ms", "max ms",
+	)
+	port := *basePort + 1
+	for _, scenario := range scenarios {
+		for _, trickleICE := range []bool{false, true} {
+			dialDurations := make([]time.Duration, 0, *iterations)
+			connectDurations := make([]time.Duration, 0, *iterations)
+			for range *iterations {
+				dialDuration, connectDuration, err := connect(port, signallingServerAddress, scenario.iceServers, trickleICE)
+				port += 2
+				if err != nil {
+					fmt.Fprintln(os.Stderr, "connection failed:", err)
+					continue
+				}
+				dialDurations = append(dialDurations, dialDuration)
+				connectDurations = append(connectDurations, connectDuration)
+			}
+			if len(connectDurations) == 0 {
+				continue
+			}
+
+			mode := "full gathering"
+			if trickleICE {
+				mode = "trickle"
+			}
+			fmt.Printf(
+				"%-20s %-14s %14d %16d %16d %16d\n",
+				scenario.name,
+				mode,
+				mean(dialDurations).Milliseconds(),
+				mean(connectDurations).Milliseconds(),
+				slices.Min(connectDurations).Milliseconds(),
+				slices.Max(connectDurations).Milliseconds(),
+			)
+		}
+	}
+}
+
+// Connect a new pair of peers, listening on the given port and the next, returning how long Dial took to return,
+// and how long it took for both peers to be connected.
+func connect(
+	port int,
+	signallingServerAddress string,
+	iceServers []webrtc.ICEServer,
+	trickleICE bool,
+) (time.Duration, time.Duration, error) {
+	answeringIdentifier := signalling.PeerIdentifier{Uuid: uuid.New(), PublicIP: fmt.Sprintf("http://127.0.0.1:%d", port)}
+	answeringManager := newConnectionManager(port, signallingServerAddress, answeringIdentifier, iceServers)
+	offeringManager := newConnectionManager(port+1, signallingServerAddress, signalling.PeerIdentifier{Uuid: uuid.New()}, iceServers)
+	offeringManager.SetTrickleICE(trickleICE)
+	// Let the signalling server and the answering peer start listening
+	time.Sleep(50 * time.Millisecond)
+
+	ctx, cancel := context.WithTimeout(context.Background(), 30*time.Second)
+	defer cancel()
+
+	start := time.Now()
+	if err := offeringManager.Dial(ctx, answeringIdentifier); err != nil {
+		return 0, 0, err
+	}
+	dialDuration := time.Since(start)
+
+	peers := make([]*peer.Peer, 0, 2)
+	defer func() {
+		for _, p := range peers {
+			p.Close()
+		}
+	}()
+	for len(peers) < 2 {
+		select {
+		case p := <-offeringManager.ConnectedPeerChannel:
+			peers = append(peers, p)
+		case p := <-answeringManager.ConnectedPeerChannel:
+			peers = append(peers, p)
+		case <-ctx.Done():
+			return 0, 0, ctx.Err()
+		}
+	}
+	return dialDuration, time.Since(start), nil
+}
+
+func newConnectionManager(
+	localPort int,
+	signallingServerAddress string,
+	localPeerIdentifier signalling.PeerIdentifier,
+	iceServers []webrtc.ICEServer,
+) *networking.ConnectionManager {
+	opusFactory, err := encoderdecoder.NewOpusFactory(20*time.Millisecond, 16)
+	if err != nil {
+		panic(err)
+	}
+	codec := networking.CodecMap["CodecOpus48000Mono"]
+	return networking.NewConnectionManager(
+		localPort,
+		signallingServerAddress,
+		peer.NewPeerFactory(codec, opusFactory, slog.Default()),
+		localPeerIdentifier,
+		[]webrtc.RTPCodecCapability{codec},
+		webrtc.Configuration{ICEServers: iceServers},
+		webrtc.OfferOptions{},
+		webrtc.AnswerOptions{},
+		slog.Default(),
+	)
+}
+
+// A local stand-in for the signalling server, forwarding offers and candidates to the answering peer they name,
+// and the response back, each after the given latency.
+func serveSignalling(port int, latency time.Duration) {
+	forward := func(w http.ResponseWriter, r *http.Request) {
+		requestBody, err := io.ReadAll(r.Body)
+		if err != nil {
+			w.WriteHeader(http.StatusBadRequest)
+			return
+		}
+		// Both signalling.SignallingOffer and signalling.SignallingCandidates name the answering peer
+		var route struct{ AnsweringPeerID signalling.PeerIdentifier }
+		if err := json.Unmarshal(requestBody, &route); err != nil {
+			w.WriteHeader(http.StatusBadRequest)
+			return
+		}
+
+		time.Sleep(latency)
+		resp, err := http.Post(route.AnsweringPeerID.PublicIP+r.URL.Path, "application/json", bytes.NewBuffer(requestBody))
+		if err != nil {
+			w.WriteHeader(http.StatusBadGateway)
+			return
+		}
+		defer resp.Body.Close()
+		responseBody, err := io.ReadAll(resp.Body)
+		if err != nil {
+			w.WriteHeader(http.StatusBadGateway)
+			return
+		}
+
+		time.Sleep(latency)
+		w.Header().Set("Content-Type", "application/json")
+		w.WriteHeader(resp.StatusCode)
+		w.Write(responseBody)
+	}
+
+	mux := http.NewServeMux()
+	mux.HandleFunc(fmt.Sprintf("POST /%s", signalling.SIGNAL_ENDPOINT), forward)
+	mux.HandleFunc(fmt.Sprintf("POST /%s", signalling.CANDIDATES_ENDPOINT), forward)
+	if err := http.ListenAndServe(fmt.Sprintf("localhost:%d", port), mux); err != nil {
+		panic(err)
+	}
+}
+
+func mean(durations []time.Duration) time.Duration {
+	var total time.Duration
+	for _, duration := range durations {
+		total += duration
+	}
+	return total / time.Duration(len(durations))
+}
@@ -141,7 +141,7 @@ func main() {
 	}
 
 	fanInDevice := device.NewFanInDevice(speakerProperties, frameDuration)
-	outputDevice.SetStream(fanInDevice.GetStream())
+	audiodevice.Connect(fanInDevice, outputDevice)
 
 	for {
 		select {
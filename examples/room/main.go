@@ -0,0 +1,249 @@
+package main
+
+import (
+	"context"
+	"flag"
+	"fmt"
+	"log/slog"
+	"math"
+	"os"
+	"sync"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/networking"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/peer"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
+	"github.com/google/uuid"
+	"github.com/pion/webrtc/v4"
+)
+
+const frameDuration = 20 * time.Millisecond
+
+// The result of a participant of the room.
+type participantResult struct {
+	sentLevel     peer.AudioLevel
+	receivedLevel peer.AudioLevel
+	// The number of frames of the stream the participant receives
+	framesReceived int
+	// The number of packets received at each voiced level, from which receivedLevel is chosen
+	receivedLevelCounts map[peer.AudioLevel]int
+}
+
+// Run a room of participants, all connected to a single node of the room, in this process.
+// The node is either a forwarding node (a peer.Forwarder) or a mixing node (a peer.Mixer).
+//
+// Each participant sends a tone of its own pitch, each 10dB quieter than the last, over its single connection to the node.
+//
+// Either node picks the loudest participants (by default, the first three) as the speakers, and every participant hears
+// every speaker but itself. The forwarding node decodes nothing, and forwards each speaker on an audio track of its own,
+// which each participant mixes, while the mixing node mixes the speakers, and sends each participant a single mix.
+// Each participant reports the audio level of what it receives, which should be the level of the mix of the speakers
+// it hears. The process exits with a non-zero status if any participant does not hear what it should.
+func main() {
+	role := flag.String("role", "forwarder", "role of the node of the room: forwarder or mixer")
+	numParticipants := flag.Int("numParticipants", 4, "number of participants in the room")
+	duration := flag.Duration("duration", 3*time.Second, "how long every participant sends audio for")
+	basePort := flag.Int("basePort", 1170, "local port of the node of the room. Participants listen on the ports after it")
+	codecName := flag.String("codec", "CodecOpus48000Mono", "codec of networking.CodecMap every connection uses")
+	flag.Parse()
+
+	slog.SetDefault(slog.New(slog.NewTextHandler(os.Stderr, &slog.HandlerOptions{Level: slog.LevelWarn})))
+	codec, ok := networking.CodecMap[*codecName]
+	if !ok {
+		panic(fmt.Sprintf("unknown codec %q", *codecName))
+	}
+
+	// --------------------------------------------------------------------------------
+	// The node of the room, which is also the signalling server of the participants
+
+	nodeAddress := fmt.Sprintf("http://127.0.0.1:%d", *basePort)
+	nodeIdentifier := signalling.PeerIdentifier{Uuid: uuid.New(), PublicIP: nodeAddress}
+	var numJoined func() int
+	// The number of speakers heard at once, and the number of audio tracks of every connection (one for each forwarded speaker)
+	var maxActiveSpeakers, numAudioTracks int
+	switch *role {
+	case "forwarder":
+		maxActiveSpeakers, numAudioTracks = peer.DEFAULT_FORWARDER_MAX_ACTIVE_SPEAKERS, peer.DEFAULT_FORWARDER_MAX_ACTIVE_SPEAKERS
+		nodeManager := newConnectionManager(*basePort, nodeAddress, nodeIdentifier, codec, numAudioTracks)
+		forwarder := peer.NewForwarder()
+		go forwarder.Serve(nodeManager.ConnectedPeerChannel)
+		numJoined = forwarder.NumParticipants
+	case "mixer":
+		maxActiveSpeakers, numAudioTracks = peer.DEFAULT_MIXER_MAX_ACTIVE_SPEAKERS, 1
+		nodeManager := newConnectionManager(*basePort, nodeAddress, nodeIdentifier, codec, numAudioTracks)
+		mixer := peer.NewMixer(audiodevice.DeviceProperties{SampleRate: 48000, NumChannels: 1}, frameDuration)
+		defer mixer.Close()
+		go mixer.Serve(nodeManager.ConnectedPeerChannel)
+		numJoined = mixer.NumParticipants
+	default:
+		panic(fmt.Sprintf("unknown role %q", *role))
+	}
+	// Every participant hears the loudest participants but itself
+	heard := func(i int, numParticipants int) []int {
+		others := make([]int, 0)
+		for j := range min(numParticipants, maxActiveSpeakers) {
+			if j != i {
+				others = append(others, j)
+			}
+		}
+		return others
+	}
+
+	// --------------------------------------------------------------------------------
+	// The participants
+
+	ctx, cancel := context.WithTimeout(context.Background(), *duration+5*time.Second)
+	defer cancel()
+
+	results := make([]participantResult, *numParticipants)
+	participants := make([]*peer.Peer, *numParticipants)
+	for i := range participants {
+		identifier := signalling.PeerIdentifier{Uuid: uuid.New()}
+		manager := newConnectionManager(*basePort+1+i, nodeAddress, identifier, codec, numAudioTracks)
+		if err := manager.Dial(ctx, nodeIdentifier); err != nil {
+			panic(err)
+		}
+		select {
+		case participants[i] = <-manager.ConnectedPeerChannel:
+		case <-ctx.Done():
+			panic("participant did not connect to the node of the room")
+		}
+	}
+	for numJoined() < *numParticipants {
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	var wg sync.WaitGroup
+	for i, participant := range participants {
+		// Every participant is 10dB quieter than the last. Beyond the fifth, participants are too quiet to be voice, so are never heard.
+		// Each has a pitch of its own, so that mixed tones add in power.
+		amplitude := 0.5 * math.Pow(10, -float64(i)/2)
+		results[i].sentLevel = toneLevel(amplitude)
+		results[i].receivedLevel = peer.AudioLevel{Level: 127}
+		results[i].receivedLevelCounts = make(map[peer.AudioLevel]int)
+		participant.SetStream(tone(ctx, participant, amplitude, 440*float64(i+1), *duration))
+
+		wg.Add(1)
+		go func(i int, participant *peer.Peer) {
+			defer wg.Done()
+			for pcmFrame := range participant.GetStream() {
+				pcmFrame.Release()
+				results[i].framesReceived += 1
+				// The level of the stream received, as read from each packet before decoding
+				if level := participant.AudioLevel(); level.Voice {
+					results[i].receivedLevelCounts[level] += 1
+				}
+			}
+		}(i, participant)
+	}
+
+	time.Sleep(*duration + time.Second)
+	for _, participant := range participants {
+		participant.Close()
+	}
+	wg.Wait()
+
+	// --------------------------------------------------------------------------------
+
+	fmt.Printf("%-12s %-12s %-16s %-16s %-10s\n", "participant", "sent level", "received level", "frames received", "expected")
+	allOk := true
+	for i, result := range results {
+		// The level received most often, as the first and last packets may hear only some of the participants
+		for level, count := range result.receivedLevelCounts {
+			if count > result.receivedLevelCounts[result.receivedLevel] {
+				result.receivedLevel = level
+			}
+		}
+		// The mean squares of the tones heard add up
+		var meanSquare float64
+		for _, j := range heard(i, len(results)) {
+			if j < len(results) {
+				meanSquare += math.Pow(10, -float64(results[j].sentLevel.Level)/10)
+			}
+		}
+		// The level measured by the sender may differ from that of the ideal tones by rounding
+		ok := meanSquare > 0 && result.framesReceived > 0 &&
+			math.Abs(float64(result.receivedLevel.Level)+10*math.Log10(meanSquare)) <= 1
+		fmt.Printf(
+			"%-12d %-12s %-16s %-16d %-10t\n",
+			i,
+			fmt.Sprintf("-%ddBov", result.sentLevel.Level),
+			fmt.Sprintf("-%ddBov", result.receivedLevel.Level),
+			result.framesReceived,
+			ok,
+		)
+		allOk = allOk && ok
+	}
+	if !allOk {
+		fmt.Fprintln(os.Stderr, "some participants did not hear what they should")
+		os.Exit(1)
+	}
+}
+
+func newConnectionManager(
+	localPort int,
+	signallingServerAddress string,
+	localPeerIdentifier signalling.PeerIdentifier,
+	codec webrtc.RTPCodecCapability,
+	numAudioTracks int,
+) *networking.ConnectionManager {
+	opusFactory, err := encoderdecoder.NewOpusFactory(frameDuration, 16)
+	if err != nil {
+		panic(err)
+	}
+	peerFactory := peer.NewPeerFactory(codec, opusFactory, slog.Default())
+	peerFactory.SetNumAudioTracks(numAudioTracks)
+	return networking.NewConnectionManager(
+		localPort,
+		signallingServerAddress,
+		peerFactory,
+		localPeerIdentifier,
+		[]webrtc.RTPCodecCapability{codec},
+		webrtc.Configuration{},
+		webrtc.OfferOptions{},
+		webrtc.AnswerOptions{},
+		slog.Default(),
+	)
+}
+
+// A stream of frames of a tone with the given amplitude and frequency, in the format of the given peer, in real time.
+func tone(ctx context.Context, p *peer.Peer, amplitude float64, frequency float64, duration time.Duration) <-chan *frame.PooledPCMFrame {
+	deviceProperties := p.GetDeviceProperties()
+	frameLength := deviceProperties.SampleRate * deviceProperties.NumChannels * int(frameDuration) / int(time.Second)
+	stream := make(chan *frame.PooledPCMFrame)
+	go func() {
+		defer close(stream)
+		ticker := time.NewTicker(frameDuration)
+		defer ticker.Stop()
+		sampleIndex := 0
+		for start := time.Now(); time.Since(start) < duration; {
+			pcmFrame := frame.GetPooledPCMFrame(frameLength)
+			samples := pcmFrame.Samples()
+			for i := range samples {
+				samples[i] = float32(amplitude * math.Sin(2*math.Pi*frequency*float64(sampleIndex)/float64(deviceProperties.SampleRate)))
+				if (i+1)%deviceProperties.NumChannels == 0 {
+					sampleIndex += 1
+				}
+			}
+			select {
+			case stream <- pcmFrame:
+			case <-ctx.Done():
+				pcmFrame.Release()
+				return
+			}
+			<-ticker.C
+		}
+	}()
+	return stream
+}
+
+// The audio level of a tone with the given amplitude, i.e. of its root mean square (the amplitude over the square root of 2).
+func toneLevel(amplitude float64) peer.AudioLevel {
+	return peer.AudioLevel{
+		Level: uint8(math.Round(-20 * math.Log10(amplitude/math.Sqrt2))),
+		Voice: true,
+	}
+}
@@ -23,7 +23,7 @@ type RtAudioInputDevice struct {
 	audio        rtaudiowrapper.RtAudio
 	sampleRate   uint
 	numChannels  int
-	dataChannel  chan frame.PCMFrame
+	dataChannel  chan *frame.PooledPCMFrame
 	errorChannel chan error
 	framesLost   atomic.Uint64
 	DeviceID     int
@@ -48,7 +48,7 @@ func NewRtAudioInputDevice(
 	sampleRate := deviceInfo.PreferredSampleRate
 
 	ctx, ctxCancelFunc := context.WithCancel(context.Background())
-	dataChannel := make(chan frame.PCMFrame)
+	dataChannel := make(chan *frame.PooledPCMFrame)
 	errorChannel := make(chan error, 5)
 
 	bufferFrames := uint(int(sampleRate) * int(frameDuration) / int(time.Second))
@@ -98,10 +98,9 @@ func NewRtAudioInputDevice(
 		if inputData == nil {
 			return 0
 		}
-		// Convert float32 slice to PCMFrame (already in correct format)
-		pcmFrame := make(frame.PCMFrame, len(inputData))
-		copy(pcmFrame, inputData)
-		dataChannel <- pcmFrame
+		// Copy float32 slice into a pooled PCMFrame (already in correct format)
+		// The callback's buffer is reused by RtAudio, so we cannot send it directly
+		dataChannel <- frame.NewPooledPCMFrameFrom(inputData)
 
 		// Check for input overflow
 		if status&rtaudiowrapper.StatusInputOverflow != 0 {
@@ -132,7 +131,7 @@ func NewRtAudioInputDevice(
 }
 
 // GetStream returns the channel that will receive PCM audio frames from the microphone.
-func (d *RtAudioInputDevice) GetStream() <-chan frame.PCMFrame {
+func (d *RtAudioInputDevice) GetStream() <-chan *frame.PooledPCMFrame {
 	return d.dataChannel
 }
 
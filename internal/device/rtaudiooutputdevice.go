@@ -13,6 +13,11 @@ import (
 
 // RtAudioOutputDevice is an AudioOutputDevice that plays audio to speakers using RtAudio.
 // It implements the AudioSinkDevice interface.
+//
+// It also implements the AudioPullSinkDevice interface: given a source that can render
+// audio on demand (e.g. a FanInDevice), the RtAudio output callback renders exactly one
+// buffer of audio straight into the device buffer. This is preferred over SetStream,
+// as no channels, goroutines or tickers sit between the mixer and the speaker.
 type RtAudioOutputDevice struct {
 	logger *slog.Logger
 	uuid   uuid.UUID
@@ -20,12 +25,12 @@ type RtAudioOutputDevice struct {
 	audio        rtaudiowrapper.RtAudio
 	sampleRate   int
 	numChannels  int
-	dataChannel  <-chan frame.PCMFrame
+	dataChannel  <-chan *frame.PooledPCMFrame
 	bufferFrames uint
 	DeviceID     int
 
 	// Internal buffer to handle streaming from channel to rtaudio callback
-	frameQueue   chan frame.PCMFrame
+	frameQueue   chan *frame.PooledPCMFrame
 	shutdownOnce sync.Once
 	closeWg      sync.WaitGroup
 }
@@ -62,16 +67,14 @@ func NewRtAudioOutputDevice(
 		sampleRate:   sampleRate,
 		numChannels:  channels,
 		bufferFrames: bufferFrames,
-		frameQueue:   make(chan frame.PCMFrame), // Buffer to smooth out playback
+		frameQueue:   make(chan *frame.PooledPCMFrame), // Buffer to smooth out playback
 	}
 	return device, nil
 }
 
-// SetStream sets the source channel for audio data and starts playback.
-// This method starts the RtAudio stream and begins consuming PCM frames from the channel.
-func (d *RtAudioOutputDevice) SetStream(sourceChannel <-chan frame.PCMFrame) {
-	d.dataChannel = sourceChannel
-
+// Open and start the RtAudio stream, with the given output callback.
+// Returns false if the stream could not be started.
+func (d *RtAudioOutputDevice) startStream(cb rtaudiowrapper.Callback) bool {
 	// Set up stream parameters for output
 	params := rtaudiowrapper.StreamParams{
 		DeviceID:     uint(d.DeviceID),
@@ -79,9 +82,56 @@ func (d *RtAudioOutputDevice) SetStream(sourceChannel <-chan frame.PCMFrame) {
 		FirstChannel: 0,
 	}
 
+	err := d.audio.Open(&params, nil, rtaudiowrapper.FormatFloat32, uint(d.sampleRate), d.bufferFrames, cb, nil)
+	if err != nil {
+		d.logger.Error("failed to open audio stream", "err", err)
+		return false
+	}
+
+	err = d.audio.Start()
+	if err != nil {
+		d.logger.Error("failed to start audio stream", "err", err)
+		d.audio.Close()
+		return false
+	}
+
+	d.logger.Info("rtaudio output device started successfully")
+	return true
+}
+
+// SetRenderSource sets the source to pull audio from and starts playback.
+// Each time RtAudio requests output, the source renders exactly one buffer of audio
+// (bufferFrames samples per channel) directly into the device buffer,
+// so the output latency is a single device period.
+//
+// Playback stops once the source is closed.
+func (d *RtAudioOutputDevice) SetRenderSource(source audiodevice.AudioRendererSourceDevice) {
+	cb := func(out rtaudiowrapper.Buffer, in rtaudiowrapper.Buffer, dur time.Duration, status rtaudiowrapper.StreamStatus) int {
+		outputData := out.Float32()
+		if outputData == nil {
+			return 0
+		}
+
+		if !source.Render(outputData) {
+			// Source closed, play silence and stop
+			clear(outputData)
+			return 2 // Stop stream
+		}
+		return 0
+	}
+
+	d.startStream(cb)
+}
+
+// SetStream sets the source channel for audio data and starts playback.
+// This method starts the RtAudio stream and begins consuming PCM frames from the channel.
+//
+// Where the source can render audio on demand, prefer SetRenderSource (see audiodevice.Connect).
+func (d *RtAudioOutputDevice) SetStream(sourceChannel <-chan *frame.PooledPCMFrame) {
+	d.dataChannel = sourceChannel
+
 	// Output callback function
 	cb := func(out rtaudiowrapper.Buffer, in rtaudiowrapper.Buffer, dur time.Duration, status rtaudiowrapper.StreamStatus) int {
-		// d.logger.Debug("sending output from: ", "DeviceID", d.DeviceID)
 		outputData := out.Float32()
 		if outputData == nil {
 			return 0
@@ -97,26 +147,16 @@ func (d *RtAudioOutputDevice) SetStream(sourceChannel <-chan frame.PCMFrame) {
 			}
 			return 2 // Stop stream
 		}
-		copy(outputData, pcmFrame)
+		copy(outputData, pcmFrame.Samples())
+		pcmFrame.Release()
 
 		return 0
 	}
 
-	err := d.audio.Open(&params, nil, rtaudiowrapper.FormatFloat32, uint(d.sampleRate), d.bufferFrames, cb, nil)
-	if err != nil {
-		d.logger.Error("failed to open audio stream", "err", err)
+	if !d.startStream(cb) {
 		return
 	}
 
-	err = d.audio.Start()
-	if err != nil {
-		d.logger.Error("failed to start audio stream", "err", err)
-		d.audio.Close()
-		return
-	}
-
-	d.logger.Info("rtaudio output device started successfully")
-
 	// Start goroutine to feed frames from source channel to internal queue
 	d.closeWg.Add(1)
 	go func() {
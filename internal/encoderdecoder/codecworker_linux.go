@@ -0,0 +1,25 @@
+package encoderdecoder
+
+import "golang.org/x/sys/unix"
+
+// The CPU cores the process may run on (e.g. as restricted by taskset, or a cgroup cpuset), in ascending order.
+func allowedCPUs() ([]int, error) {
+	var set unix.CPUSet
+	if err := unix.SchedGetaffinity(0, &set); err != nil {
+		return nil, err
+	}
+	cpus := make([]int, 0, set.Count())
+	for cpu := 0; len(cpus) < cap(cpus); cpu++ {
+		if set.IsSet(cpu) {
+			cpus = append(cpus, cpu)
+		}
+	}
+	return cpus, nil
+}
+
+// Restrict the calling thread to the given CPU core, which must be one of allowedCPUs.
+func pinToCPU(cpu int) error {
+	var set unix.CPUSet
+	set.Set(cpu)
+	return unix.SchedSetaffinity(0, &set)
+}
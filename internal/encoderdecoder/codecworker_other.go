@@ -0,0 +1,12 @@
+//go:build !linux
+
+package encoderdecoder
+
+// Threads cannot be restricted to a core on this platform, so workers are only locked to their own thread.
+func allowedCPUs() ([]int, error) {
+	return nil, nil
+}
+
+func pinToCPU(cpu int) error {
+	return nil
+}
@@ -0,0 +1,245 @@
+package encoderdecoder
+
+import (
+	"log/slog"
+	"runtime"
+	"sync"
+	"sync/atomic"
+)
+
+// The number of jobs that may queue up on a single codecWorker (in each of its queues) before queueing blocks.
+// Comfortably more than one audio period of work for every codec a worker is likely to hold.
+const codecWorkerQueueCapacity = 256
+
+// The queue of a codecWorker a codec runs its jobs on.
+type codecQueue int
+
+const (
+	// Encoding jobs, run once no decoding job is waiting
+	encodeQueue codecQueue = iota
+	// Decoding jobs, run before any waiting encoding job. A decoded frame is due at its playout time,
+	// whereas an encoded packet sent a little later is only absorbed by the jitter buffer of the remote peer.
+	decodeQueue
+)
+
+type codecJob struct {
+	run func()
+	// Signalled once run has returned, if not nil
+	done chan struct{}
+}
+
+// A single goroutine running the jobs of the codecs assigned to it, locked to its own OS thread
+// (and, where supported, to its own CPU core).
+type codecWorker struct {
+	_ cacheLinePad
+
+	encodeJobs chan codecJob
+	decodeJobs chan codecJob
+	// The number of codecs currently assigned to this worker
+	load atomic.Int32
+
+	// Held (for reading) while queueing a job, so the worker is never stopped with a job half queued
+	stopMutex sync.RWMutex
+	stopped   bool
+	// Closed once stopped, after which no job is queued
+	stop chan struct{}
+
+	_ cacheLinePad
+}
+
+// A pool of codec workers, one per core, that OpusEncoders and OpusDecoders run their work on.
+//
+// Without a pool, each peer encodes and decodes on its own goroutines, which the Go scheduler moves between
+// cores freely. With a pool, each codec is assigned to a single worker for its whole life (the least loaded
+// worker at the time), so the libopus state of a codec stays in the cache of one core, and codec work is spread
+// evenly across cores. Each worker runs waiting decoding jobs before waiting encoding jobs, so a burst of
+// encoding never delays playout. Jobs only run the codec: sending the result (e.g. over the network)
+// is left to the caller, once the job is done, so a slow network never holds up a worker.
+//
+// A CodecWorkerPool is shared by setting it on an OpusFactory (see OpusFactory.WithCodecWorkerPool).
+type CodecWorkerPool struct {
+	workers []*codecWorker
+
+	// Serializes assignment, so load is balanced
+	assignMutex sync.Mutex
+
+	closeOnce sync.Once
+}
+
+// Create a new CodecWorkerPool with the given number of workers.
+// If numWorkers is not positive, one worker is created per core (i.e. runtime.GOMAXPROCS).
+//
+// Where supported, each worker is pinned to its own core, of those the process may run on.
+// If there are more workers than such cores, workers are not pinned.
+func NewCodecWorkerPool(numWorkers int) *CodecWorkerPool {
+	if numWorkers <= 0 {
+		numWorkers = runtime.GOMAXPROCS(0)
+	}
+	pool := &CodecWorkerPool{
+		workers: make([]*codecWorker, numWorkers),
+	}
+
+	cpus, err := allowedCPUs()
+	if err != nil {
+		slog.Warn("unable to read the CPU affinity of the process, codec workers are not pinned to a core", "err", err)
+	} else if len(cpus) < numWorkers {
+		cpus = nil
+	}
+	for i := range pool.workers {
+		worker := &codecWorker{
+			encodeJobs: make(chan codecJob, codecWorkerQueueCapacity),
+			decodeJobs: make(chan codecJob, codecWorkerQueueCapacity),
+			stop:       make(chan struct{}),
+		}
+		pool.workers[i] = worker
+		cpu := -1
+		if cpus != nil {
+			cpu = cpus[i]
+		}
+		go worker.run(cpu)
+	}
+	return pool
+}
+
+// The number of workers in the pool.
+func (pool *CodecWorkerPool) NumWorkers() int {
+	return len(pool.workers)
+}
+
+// Stop every worker once its queued jobs are done. Jobs run after the pool is closed run on the calling goroutine.
+//
+// This function is idempotent.
+func (pool *CodecWorkerPool) Close() {
+	pool.closeOnce.Do(func() {
+		for _, worker := range pool.workers {
+			worker.stopMutex.Lock()
+			worker.stopped = true
+			close(worker.stop)
+			worker.stopMutex.Unlock()
+		}
+	})
+}
+
+// Assign a new codec to the least loaded worker.
+func (pool *CodecWorkerPool) assign() *codecWorker {
+	pool.assignMutex.Lock()
+	defer pool.assignMutex.Unlock()
+
+	assigned := pool.workers[0]
+	for _, worker := range pool.workers[1:] {
+		if worker.load.Load() < assigned.load.Load() {
+			assigned = worker
+		}
+	}
+	assigned.load.Add(1)
+	return assigned
+}
+
+// Run jobs on the calling goroutine, pinned to the given CPU core (if not negative), until the worker is stopped.
+func (worker *codecWorker) run(cpu int) {
+	// Keep the worker on one thread (and core), so the codec state it touches stays in that core's cache
+	runtime.LockOSThread()
+	if cpu >= 0 {
+		if err := pinToCPU(cpu); err != nil {
+			slog.Warn("unable to pin codec worker to its core", "cpu", cpu, "err", err)
+		}
+	}
+
+	for {
+		if worker.runDecodeJob() {
+			continue
+		}
+		select {
+		case job := <-worker.decodeJobs:
+			worker.runJob(job)
+		case job := <-worker.encodeJobs:
+			worker.runJob(job)
+		case <-worker.stop:
+			// Nothing is queued once stopped, so the queues only need emptying once
+			for worker.runDecodeJob() {
+			}
+			for range len(worker.encodeJobs) {
+				worker.runJob(<-worker.encodeJobs)
+			}
+			return
+		}
+	}
+}
+
+// Run the next decoding job, if one is waiting. Returns whether a job was run.
+func (worker *codecWorker) runDecodeJob() bool {
+	select {
+	case job := <-worker.decodeJobs:
+		worker.runJob(job)
+		return true
+	default:
+		return false
+	}
+}
+
+func (worker *codecWorker) runJob(job codecJob) {
+	job.run()
+	if job.done != nil {
+		job.done <- struct{}{}
+	}
+}
+
+// Queue job on the given queue of the worker. Returns false (without queueing the job) if the worker is stopped.
+func (worker *codecWorker) queue(queue codecQueue, job codecJob) bool {
+	worker.stopMutex.RLock()
+	defer worker.stopMutex.RUnlock()
+	if worker.stopped {
+		return false
+	}
+	if queue == decodeQueue {
+		worker.decodeJobs <- job
+	} else {
+		worker.encodeJobs <- job
+	}
+	return true
+}
+
+// --------------------------------------------------------------------------------
+// Codec affinity
+// The worker a single OpusEncoder or OpusDecoder runs its work on.
+
+// The worker a codec is assigned to, and the queue of the worker it runs its jobs on.
+// A codec without a worker runs its work inline.
+type codecAffinity struct {
+	worker *codecWorker
+	queue  codecQueue
+	// Reused by run, which is only called from one goroutine at a time
+	done chan struct{}
+
+	releaseOnce sync.Once
+}
+
+func newCodecAffinity(pool *CodecWorkerPool, queue codecQueue) *codecAffinity {
+	if pool == nil {
+		return &codecAffinity{}
+	}
+	return &codecAffinity{
+		worker: pool.assign(),
+		queue:  queue,
+		done:   make(chan struct{}, 1),
+	}
+}
+
+// Run job on the worker, and wait for it to finish. Once the pool is closed, job runs inline.
+func (a *codecAffinity) run(job func()) {
+	if a.worker == nil || !a.worker.queue(a.queue, codecJob{run: job, done: a.done}) {
+		job()
+		return
+	}
+	<-a.done
+}
+
+// Stop counting the codec against the load of its worker.
+func (a *codecAffinity) release() {
+	if a.worker == nil {
+		return
+	}
+	a.releaseOnce.Do(func() {
+		a.worker.load.Add(-1)
+	})
+}
@@ -0,0 +1,81 @@
+package encoderdecoder
+
+import (
+	"errors"
+	"sync/atomic"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+var errEncodedPacketRingFull error = errors.New("every encoded packet is still held by its consumer, dropping encoded frame")
+
+// An encoded OPUS packet, held in a slot of the encodedPacketRing of an OpusEncoder.
+//
+// The bytes of the packet belong to the consumer until it calls Release, after which the slot
+// is reused for a later packet. The packet must not be used after it is released.
+type EncodedPacket struct {
+	// The full slot, large enough for the largest packet the encoder may produce
+	buffer frame.EncodedFrame
+	// The number of bytes of buffer holding the packet
+	length int
+	// The duration of audio encoded in the packet
+	duration time.Duration
+
+	inUse atomic.Bool
+}
+
+// The encoded bytes of the packet. Only valid until the packet is released.
+func (p *EncodedPacket) Data() frame.EncodedFrame {
+	return p.buffer[:p.length]
+}
+
+// The duration of audio encoded in the packet, i.e. the frame duration of the encoder when it was encoded.
+// Use this (rather than OpusEncoder.GetFrameDuration) as the duration of the packet when sending it,
+// as the frame duration of the encoder may change between packets.
+func (p *EncodedPacket) Duration() time.Duration {
+	return p.duration
+}
+
+// Return the slot of the packet to its encoder, to hold a later packet.
+func (p *EncodedPacket) Release() {
+	p.inUse.Store(false)
+}
+
+// A fixed set of slots for encoded packets, each large enough for the largest packet.
+//
+// Slots are handed out in turn, and only once their previous packet has been released,
+// so a consumer holding on to packets (e.g. during a burst) never sees them overwritten.
+// If every slot is still held, no packet can be encoded until one is released:
+// memory is bounded, and nothing is ever reallocated.
+type encodedPacketRing struct {
+	packets []EncodedPacket
+	// The index of the slot to try first on the next acquire
+	next int
+}
+
+func newEncodedPacketRing(numPackets int, maxPacketSize int) *encodedPacketRing {
+	ring := &encodedPacketRing{
+		packets: make([]EncodedPacket, numPackets),
+	}
+	// A single allocation backs every slot
+	buffer := make(frame.EncodedFrame, numPackets*maxPacketSize)
+	for i := range ring.packets {
+		ring.packets[i].buffer = buffer[i*maxPacketSize : (i+1)*maxPacketSize : (i+1)*maxPacketSize]
+	}
+	return ring
+}
+
+// Take the next free slot, or nil if every slot is still held.
+// Only the goroutine encoding may call acquire, but packets may be released from any goroutine.
+func (ring *encodedPacketRing) acquire() *EncodedPacket {
+	for range len(ring.packets) {
+		packet := &ring.packets[ring.next]
+		ring.next = (ring.next + 1) % len(ring.packets)
+		if packet.inUse.CompareAndSwap(false, true) {
+			packet.length = 0
+			return packet
+		}
+	}
+	return nil
+}
@@ -0,0 +1,227 @@
+package encoderdecoder
+
+import (
+	"fmt"
+	"math"
+	"slices"
+	"testing"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+// The number of OPUS frames encoded (or decoded) by each operation of a benchmark.
+// Results are also reported per frame (ns/frame).
+const benchmarkFramesPerOp = 8
+
+// The codec formats negotiated by Roundtable (see networking.CodecMap), as sample rate and number of channels.
+var benchmarkCodecs = []struct {
+	sampleRate  int
+	numChannels int
+}{
+	{48000, 2}, {48000, 1},
+	{24000, 2}, {24000, 1},
+	{16000, 2}, {16000, 1},
+	{12000, 2}, {12000, 1},
+	{8000, 2}, {8000, 1},
+}
+
+var benchmarkFrameDurations = []OPUSFrameDuration{
+	OPUS_FRAME_DURATION_2_POINT_5_MS,
+	OPUS_FRAME_DURATION_5_MS,
+	OPUS_FRAME_DURATION_10_MS,
+	OPUS_FRAME_DURATION_20_MS,
+	OPUS_FRAME_DURATION_40_MS,
+	OPUS_FRAME_DURATION_60_MS,
+	OPUS_FRAME_DURATION_120_MS,
+}
+
+// Benchmark the OpusEncoder for every negotiable codec and every OPUS frame duration.
+//
+// Input arrives in chunks of several sizes (relative to the OPUS frame), exercising the buffering of
+// partial frames, and the encoder is measured for several buffer safety factors. Select a subset with
+// -bench, e.g.
+//
+//	go test ./internal/encoderdecoder -run '^$' -bench 'Encode/48000Hz_mono/20ms/'
+func BenchmarkEncode(b *testing.B) {
+	for _, codec := range benchmarkCodecs {
+		for _, frameDuration := range benchmarkFrameDurations {
+			frameSize := int(frameDuration) * codec.sampleRate * codec.numChannels / int(time.Second)
+			pcmData := benchmarkTone(benchmarkFramesPerOp*frameSize, codec.sampleRate)
+
+			for _, bufferSafetyFactor := range []int{2, 16} {
+				for _, chunkRatio := range []float64{0.5, 1, 3.3} {
+					name := fmt.Sprintf(
+						"%s/%s/chunk=%.2gx/factor=%d",
+						benchmarkCodecName(codec.sampleRate, codec.numChannels),
+						time.Duration(frameDuration),
+						chunkRatio,
+						bufferSafetyFactor,
+					)
+					b.Run(name, func(b *testing.B) {
+						opusFactory, err := NewOpusFactory(time.Duration(frameDuration), bufferSafetyFactor)
+						if err != nil {
+							b.Fatal(err)
+						}
+						encoder, err := opusFactory.NewOpusEncoder(codec.sampleRate, codec.numChannels)
+						if err != nil {
+							b.Fatal(err)
+						}
+						chunkSize := max(int(chunkRatio*float64(frameSize)), 1)
+						release := func(packet *EncodedPacket) { packet.Release() }
+
+						b.ReportAllocs()
+						b.ResetTimer()
+						for range b.N {
+							// Handed to the encoder chunkSize samples at a time, as an audio device would
+							for start := 0; start < len(pcmData); start += chunkSize {
+								if err := encoder.Encode(pcmData[start:min(start+chunkSize, len(pcmData))], release); err != nil {
+									b.Fatal(err)
+								}
+							}
+						}
+						reportNsPerFrame(b)
+					})
+				}
+			}
+		}
+	}
+}
+
+// Encode a burst of 20ms frames (e.g. a RingStream batch read after a stall) holding far more packets than the packet ring,
+// consumed as an EncoderGroup does: the packets of each frame are held until Encode returns, then written and released
+// before the next frame. However small the buffer safety factor and short the frame duration, no frame may be dropped.
+//
+// BenchmarkEncode releases every packet as soon as it is emitted, so never fills the ring.
+func TestEncodeBurstLargerThanPacketRing(t *testing.T) {
+	const sampleRate, numChannels = 48000, 1
+	const numRingFrames = 16
+	ringFrameSize := int(OPUS_FRAME_DURATION_20_MS) * sampleRate * numChannels / int(time.Second)
+	pcmData := benchmarkTone(numRingFrames*ringFrameSize, sampleRate)
+
+	for _, frameDuration := range []OPUSFrameDuration{
+		OPUS_FRAME_DURATION_2_POINT_5_MS,
+		OPUS_FRAME_DURATION_5_MS,
+		OPUS_FRAME_DURATION_10_MS,
+	} {
+		for _, bufferSafetyFactor := range []int{1, 2, 16} {
+			t.Run(fmt.Sprintf("%s/factor=%d", time.Duration(frameDuration), bufferSafetyFactor), func(t *testing.T) {
+				opusFactory, err := NewOpusFactory(time.Duration(frameDuration), bufferSafetyFactor)
+				if err != nil {
+					t.Fatal(err)
+				}
+				encoder, err := opusFactory.NewOpusEncoder(sampleRate, numChannels)
+				if err != nil {
+					t.Fatal(err)
+				}
+				frameSize := int(frameDuration) * sampleRate * numChannels / int(time.Second)
+				expectedPackets := len(pcmData) / frameSize
+				if numSlots := len(encoder.encodedPackets.packets); expectedPackets <= numSlots {
+					t.Fatalf("burst of %d packets fits the %d slots of the packet ring", expectedPackets, numSlots)
+				}
+
+				held := make([]*EncodedPacket, 0)
+				numPackets := 0
+				for start := 0; start < len(pcmData); start += ringFrameSize {
+					err := encoder.Encode(pcmData[start:start+ringFrameSize], func(packet *EncodedPacket) {
+						held = append(held, packet)
+					})
+					if err != nil {
+						t.Fatalf("ring frame %d: %v", start/ringFrameSize, err)
+					}
+					numPackets += len(held)
+					for _, packet := range held {
+						packet.Release()
+					}
+					held = held[:0]
+				}
+				if numPackets != expectedPackets {
+					t.Errorf("encoded %d packets, want %d", numPackets, expectedPackets)
+				}
+			})
+		}
+	}
+}
+
+// Benchmark the OpusDecoder for every negotiable codec and every OPUS frame duration.
+// Decoding depends on neither the chunk size nor the buffer safety factor of the encoder.
+func BenchmarkDecode(b *testing.B) {
+	for _, codec := range benchmarkCodecs {
+		for _, frameDuration := range benchmarkFrameDurations {
+			name := fmt.Sprintf(
+				"%s/%s",
+				benchmarkCodecName(codec.sampleRate, codec.numChannels),
+				time.Duration(frameDuration),
+			)
+			b.Run(name, func(b *testing.B) {
+				opusFactory, err := NewOpusFactory(time.Duration(frameDuration), 1)
+				if err != nil {
+					b.Fatal(err)
+				}
+				packets := benchmarkPackets(b, opusFactory, codec.sampleRate, codec.numChannels, frameDuration)
+				decoder, err := opusFactory.NewOpusDecoder(codec.sampleRate, codec.numChannels)
+				if err != nil {
+					b.Fatal(err)
+				}
+
+				b.ReportAllocs()
+				b.ResetTimer()
+				for range b.N {
+					for _, packet := range packets {
+						decodedFrame, err := decoder.Decode(packet)
+						if err != nil {
+							b.Fatal(err)
+						}
+						decodedFrame.Release()
+					}
+				}
+				reportNsPerFrame(b)
+			})
+		}
+	}
+}
+
+// Report the time taken per OPUS frame, to size hosts by the number of frames (i.e. peers and frame durations) they handle.
+func reportNsPerFrame(b *testing.B) {
+	b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N*benchmarkFramesPerOp), "ns/frame")
+}
+
+// Encode benchmarkFramesPerOp frames of a tone into (copies of) their packets, to be decoded.
+func benchmarkPackets(
+	b *testing.B,
+	opusFactory OpusFactory,
+	sampleRate int,
+	numChannels int,
+	frameDuration OPUSFrameDuration,
+) []frame.EncodedFrame {
+	encoder, err := opusFactory.NewOpusEncoder(sampleRate, numChannels)
+	if err != nil {
+		b.Fatal(err)
+	}
+	frameSize := int(frameDuration) * sampleRate * numChannels / int(time.Second)
+	packets := make([]frame.EncodedFrame, 0, benchmarkFramesPerOp)
+	err = encoder.Encode(benchmarkTone(benchmarkFramesPerOp*frameSize, sampleRate), func(packet *EncodedPacket) {
+		packets = append(packets, slices.Clone(packet.Data()))
+		packet.Release()
+	})
+	if err != nil {
+		b.Fatal(err)
+	}
+	return packets
+}
+
+// A 440Hz tone, so the encoder has real work to do.
+func benchmarkTone(length int, sampleRate int) frame.PCMFrame {
+	pcmData := make(frame.PCMFrame, length)
+	for i := range pcmData {
+		pcmData[i] = float32(0.5 * math.Sin(2*math.Pi*440*float64(i)/float64(sampleRate)))
+	}
+	return pcmData
+}
+
+func benchmarkCodecName(sampleRate int, numChannels int) string {
+	if numChannels == 1 {
+		return fmt.Sprintf("%dHz_mono", sampleRate)
+	}
+	return fmt.Sprintf("%dHz_stereo", sampleRate)
+}
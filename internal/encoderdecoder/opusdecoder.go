@@ -0,0 +1,127 @@
+package encoderdecoder
+
+import (
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/opus"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+// Decodes OPUS packets into PCM audio.
+//
+// An OpusDecoder holds only the state of decoding, so it is independent of any OpusEncoder.
+// Decoded frames are drawn from the frame pool, so no buffers are held between calls.
+// An OpusDecoder should only be used from one goroutine at a time.
+type OpusDecoder struct {
+	_ cacheLinePad
+
+	sampleRate  int
+	numChannels int
+
+	decoder *opus.Decoder
+	// The largest number of samples a single OPUS packet may decode to,
+	// i.e. sampleRate * numChannels * the longest OPUS frame duration (120ms).
+	// Decoded frames are drawn from the frame pool with this length, then truncated.
+	maxDecodedFrameSize int
+
+	// The worker of a CodecWorkerPool this decoder runs its work on, if any
+	affinity *codecAffinity
+
+	_ cacheLinePad
+}
+
+func newOpusDecoder(sampleRate int, numChannels int, codecWorkerPool *CodecWorkerPool) (*OpusDecoder, error) {
+	decoder, err := opus.NewDecoder(sampleRate, numChannels)
+	if err != nil {
+		return nil, err
+	}
+	return &OpusDecoder{
+		sampleRate:          sampleRate,
+		numChannels:         numChannels,
+		decoder:             decoder,
+		maxDecodedFrameSize: int(OPUS_FRAME_DURATION_120_MS) * sampleRate * numChannels / int(time.Second),
+		affinity:            newCodecAffinity(codecWorkerPool, decodeQueue),
+	}, nil
+}
+
+// Run job (e.g. decoding a packet) on the worker this decoder is assigned to, and wait for it to finish.
+// Decoding jobs run ahead of any encoding jobs waiting on the same worker.
+// Without a CodecWorkerPool (see OpusFactory.WithCodecWorkerPool), job runs on the calling goroutine.
+// Only one goroutine at a time may call Run.
+func (dec *OpusDecoder) Run(job func()) {
+	dec.affinity.run(job)
+}
+
+// Unassign this decoder from its worker, once it will no longer be used.
+//
+// This function is idempotent.
+func (dec *OpusDecoder) Close() {
+	dec.affinity.release()
+}
+
+func (dec *OpusDecoder) Decode(encodedData frame.EncodedFrame) (*frame.PooledPCMFrame, error) {
+	// Decode the incoming frame into a new pooled frame.
+	// This side of things is MUCH easier than encoding, since we may decode an arbitrary number of bytes
+	// All we need to worry about is having enough room for the decoded samples.
+	//
+	// No OPUS packet decodes to more than 120ms of audio, so a frame of maxDecodedFrameSize
+	// is always large enough. Since the frame is drawn from the pool and owned by the caller,
+	// decoded audio can never be overwritten while it is still in flight downstream.
+
+	decodedFrame := frame.GetPooledPCMFrame(dec.maxDecodedFrameSize)
+	numDecodedSamples, err := dec.decoder.DecodeFloat32(encodedData, decodedFrame.Samples())
+	if err != nil {
+		decodedFrame.Release()
+		return nil, err
+	}
+	decodedFrame.Truncate(numDecodedSamples * dec.numChannels)
+	return decodedFrame, nil
+}
+
+// Discard the state of the decoder, as if no packet had been decoded yet.
+// Use before decoding again after packets were skipped for a while, so stale state
+// (e.g. of the audio before a long gap) is not blended into the new audio.
+func (dec *OpusDecoder) Reset() error {
+	decoder, err := opus.NewDecoder(dec.sampleRate, dec.numChannels)
+	if err != nil {
+		return err
+	}
+	dec.decoder = decoder
+	return nil
+}
+
+// Recover a lost packet of the given duration from the forward error correction (FEC) data
+// carried by the packet *after* it, encodedData. encodedData itself must still be decoded
+// with Decode afterwards.
+//
+// If encodedData carries no FEC data (e.g. the remote encoder has FEC disabled),
+// the lost packet is concealed instead, as with DecodePLC.
+func (dec *OpusDecoder) DecodeFEC(encodedData frame.EncodedFrame, duration time.Duration) (*frame.PooledPCMFrame, error) {
+	decodedFrame := frame.GetPooledPCMFrame(dec.lostFrameSize(duration))
+	if err := dec.decoder.DecodeFECFloat32(encodedData, decodedFrame.Samples()); err != nil {
+		decodedFrame.Release()
+		return nil, err
+	}
+	return decodedFrame, nil
+}
+
+// Conceal a lost packet of the given duration, extrapolating from the audio decoded so far
+// (packet loss concealment, PLC).
+func (dec *OpusDecoder) DecodePLC(duration time.Duration) (*frame.PooledPCMFrame, error) {
+	decodedFrame := frame.GetPooledPCMFrame(dec.lostFrameSize(duration))
+	if err := dec.decoder.DecodePLCFloat32(decodedFrame.Samples()); err != nil {
+		decodedFrame.Release()
+		return nil, err
+	}
+	return decodedFrame, nil
+}
+
+// The number of samples in a lost packet of the given duration.
+// The OPUS decoder only recovers whole multiples of 2.5ms, so the duration is rounded down to one,
+// and is at most the longest OPUS frame duration (120ms).
+func (dec *OpusDecoder) lostFrameSize(duration time.Duration) int {
+	duration = min(duration, time.Duration(OPUS_FRAME_DURATION_120_MS))
+	duration -= duration % time.Duration(OPUS_FRAME_DURATION_2_POINT_5_MS)
+	duration = max(duration, time.Duration(OPUS_FRAME_DURATION_2_POINT_5_MS))
+	return int(duration) * dec.sampleRate * dec.numChannels / int(time.Second)
+}
@@ -0,0 +1,307 @@
+package encoderdecoder
+
+import (
+	"errors"
+	"sync"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/opus"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+// The largest OPUS packet for 20ms of audio, in bytes
+const opusMaxPacketSize = 1275
+
+// Packets of at most this many bytes are produced during discontinuous transmission (DTX),
+// and need not be sent, as the decoder conceals them as silence anyway.
+const opusDTXPacketSize = 2
+
+// Padding to keep the fields of a struct off the cache lines of neighbouring allocations,
+// so that an encoder and decoder used from different goroutines never share a cache line.
+type cacheLinePad [64]byte
+
+// Encodes PCM audio into OPUS packets.
+//
+// An OpusEncoder holds only the state of encoding, so it is independent of any OpusDecoder:
+// the two directions of a connection may run (and be sized, and pooled) separately.
+// An OpusEncoder should only be used to Encode from one goroutine at a time,
+// although its settings may be changed from any goroutine.
+type OpusEncoder struct {
+	_ cacheLinePad
+
+	sampleRate  int
+	numChannels int
+
+	// The frame duration to use for OPUS encoding. Must be a very specific number,
+	// hence defined by the OPUSFrameDuration enumeration.
+	//
+	// Defines how many samples are required to be present before encoding and sending
+	// an encoded frame. See the documentation of the OPUSFrameDuration type for information.
+	//
+	// The frame duration may be changed at runtime (see SetFrameDuration), up to maxFrameDuration,
+	// which every buffer is sized for. Guarded by encoderMutex.
+	frameDuration    OPUSFrameDuration
+	maxFrameDuration OPUSFrameDuration
+
+	encoder *opus.Encoder
+	// The encoder settings may be changed at runtime (e.g. as network conditions change)
+	// while another goroutine encodes, so every use of the encoder is guarded.
+	encoderMutex    sync.Mutex
+	encoderSettings OpusEncoderSettings
+
+	// The number of samples in a single encoding frame.
+	// Equal to sampleRate * numChannels * frameDuration. Guarded by encoderMutex.
+	encodingFrameSize int
+
+	// Buffer to hold incoming PCM Frames before using them for encoding.
+	// Should be large enough to hold potentially many PCM frames,
+	// in case encoding and forwarding the frames does not happen for some time.
+	pcmFrameBuffer frame.PCMFrame
+	// The current bounds of the unencoded data in the pcmFrameBuffer.
+	// Head is always less than or equal to Tail.
+	// Head defines the first sample that has *not* been encoded and sent.
+	// Head therefore increments in sizes of the valid OPUS frame size.
+	pcmFrameBufferHead int
+	// Tail defines the last frame that has not been encoded and sent.
+	// Since data may come in with arbitrary numbers of samples, Tail may
+	// increment with arbitrary intervals.
+	//
+	// If a new PCM frame would ever push Tail beyond the end of the buffer,
+	// the unencoded data is instead copied to the start of the buffer
+	// and Head/Tail are set appropriately.
+	pcmFrameBufferTail int
+
+	// Slots for encoded packets, handed to the consumer of Encode and reused once released.
+	encodedPackets *encodedPacketRing
+
+	// The largest number of bytes a single encoded frame may take
+	maxEncodedFrameSize int
+
+	// The worker of a CodecWorkerPool this encoder runs its work on, if any
+	affinity *codecAffinity
+
+	_ cacheLinePad
+}
+
+func newOpusEncoder(
+	sampleRate int,
+	numChannels int,
+	frameDuration OPUSFrameDuration,
+	minFrameDuration OPUSFrameDuration,
+	maxFrameDuration OPUSFrameDuration,
+	bufferSafetyFactor int,
+	encoderSettings OpusEncoderSettings,
+	codecWorkerPool *CodecWorkerPool,
+) (*OpusEncoder, error) {
+	encoder, err := opus.NewEncoder(sampleRate, numChannels, opus.Application(opus.AppVoIP))
+	if err != nil {
+		return nil, err
+	}
+	if err := encoderSettings.apply(encoder); err != nil {
+		return nil, err
+	}
+
+	encodingFrameSize := int(frameDuration) * sampleRate * numChannels / int(time.Second)
+
+	// The buffer needs to be large enough such that an incoming frame of PCM data
+	// can be loaded into the pcmFrameBuffer without overwriting the already present data
+	//
+	// Recall that the frameDuration determines the number of samples possible before the data
+	// is encoded and sent. The number of samples required to encode and send a frame is:
+	// sampleRate * numChannels * frameDuration
+	//
+	// For safety, we introduce an additional safety factor of several multiples of this frame size
+	// This incurs a static additional memory cost per device, but prevents allocations.
+	//
+	// For a concrete worst-case example, consider sampleRate = 48000 stereo (numChannels = 2) data with
+	// frameDuration = OPUS_FRAME_DURATION_120_MS. Each frame would therefore require 11520 samples
+	// which (at 32 bits per sample) is 46080 bytes, i.e. 45 kilobytes of memory. With a safety factor of 16
+	// this gives up 720 kilobytes per buffer per device. This is likely negligible considering the
+	// constant memory cost and safety in audio streaming.
+	//
+	// The frame duration may later grow up to maxFrameDuration, so the buffer is sized for that.
+	bufferSize := bufferSafetyFactor * int(maxFrameDuration) * sampleRate * numChannels / int(time.Second)
+
+	// An OPUS frame is at most 1275 bytes (RFC 6716, Section 3.2.1), and frames longer than 20ms
+	// are made of several 20ms frames. Each slot of the packet ring holds one such frame, and the
+	// consumer may hold up to bufferSafetyFactor of them at once before encoding must wait.
+	maxEncodedFrameSize := max(
+		opusMaxPacketSize*int(maxFrameDuration)/int(OPUS_FRAME_DURATION_20_MS),
+		opusMaxPacketSize,
+	)
+	// A consumer may only release the packets of a call to Encode once it returns, so however small bufferSafetyFactor is,
+	// the ring holds the packets of a whole call: PCM data of up to maxFrameDuration (or 20ms, the longest frame audio devices
+	// and RingStreams hand over), encoded at minFrameDuration, plus one for samples left over from the previous call.
+	numEncodedPackets := max(
+		bufferSafetyFactor,
+		int(max(maxFrameDuration, OPUS_FRAME_DURATION_20_MS)/minFrameDuration)+1,
+	)
+
+	return &OpusEncoder{
+		sampleRate:          sampleRate,
+		numChannels:         numChannels,
+		frameDuration:       frameDuration,
+		maxFrameDuration:    maxFrameDuration,
+		encoder:             encoder,
+		encoderSettings:     encoderSettings,
+		encodingFrameSize:   encodingFrameSize,
+		pcmFrameBuffer:      make(frame.PCMFrame, bufferSize),
+		pcmFrameBufferHead:  0,
+		pcmFrameBufferTail:  0,
+		encodedPackets:      newEncodedPacketRing(numEncodedPackets, maxEncodedFrameSize),
+		maxEncodedFrameSize: maxEncodedFrameSize,
+		affinity:            newCodecAffinity(codecWorkerPool, encodeQueue),
+	}, nil
+}
+
+// Run job (e.g. encoding a frame) on the worker this encoder is assigned to, and wait for it to finish.
+// Without a CodecWorkerPool (see OpusFactory.WithCodecWorkerPool), job runs on the calling goroutine.
+// Only one goroutine at a time may call Run.
+//
+// Jobs should only encode: packets are best sent once Run returns, so the worker never waits on the network.
+func (enc *OpusEncoder) Run(job func()) {
+	enc.affinity.run(job)
+}
+
+// Unassign this encoder from its worker, once it will no longer be used.
+//
+// This function is idempotent.
+func (enc *OpusEncoder) Close() {
+	enc.affinity.release()
+}
+
+// The duration of audio in each packet encoded from now on.
+func (enc *OpusEncoder) GetFrameDuration() time.Duration {
+	enc.encoderMutex.Lock()
+	defer enc.encoderMutex.Unlock()
+	return time.Duration(enc.frameDuration)
+}
+
+// Change the duration of audio in each encoded packet, from the next packet on.
+// Samples already buffered are kept, and encoded into packets of the new duration.
+//
+// The frame duration must be a valid OPUS frame duration, no longer than the longest
+// frame duration of the factory that created this encoder (see OpusFactory.WithFrameDurationRange).
+func (enc *OpusEncoder) SetFrameDuration(frameDuration time.Duration) error {
+	opusFrameDuration := OPUSFrameDuration(frameDuration)
+	if !opusFrameDuration.isValid() {
+		return errInvalidFrameDuration
+	}
+
+	enc.encoderMutex.Lock()
+	defer enc.encoderMutex.Unlock()
+	if opusFrameDuration > enc.maxFrameDuration {
+		return errFrameDurationTooLong
+	}
+	enc.frameDuration = opusFrameDuration
+	enc.encodingFrameSize = int(opusFrameDuration) * enc.sampleRate * enc.numChannels / int(time.Second)
+	return nil
+}
+
+// The current settings of the encoder.
+func (enc *OpusEncoder) GetEncoderSettings() OpusEncoderSettings {
+	enc.encoderMutex.Lock()
+	defer enc.encoderMutex.Unlock()
+	return enc.encoderSettings
+}
+
+// Change the settings of the encoder. Takes effect from the next encoded frame.
+// If the settings are invalid, or cannot be applied, the previous settings are kept.
+func (enc *OpusEncoder) SetEncoderSettings(encoderSettings OpusEncoderSettings) error {
+	return enc.updateEncoderSettings(func(s *OpusEncoderSettings) { *s = encoderSettings })
+}
+
+// Change the target bitrate of the encoder (0 for automatic), keeping all other settings.
+func (enc *OpusEncoder) SetBitrate(bitrate int) error {
+	return enc.updateEncoderSettings(func(s *OpusEncoderSettings) { s.Bitrate = bitrate })
+}
+
+// Change the packet loss the encoder expects (in percent), keeping all other settings.
+func (enc *OpusEncoder) SetPacketLossPercentage(packetLossPercentage int) error {
+	return enc.updateEncoderSettings(func(s *OpusEncoderSettings) { s.PacketLossPercentage = packetLossPercentage })
+}
+
+// Apply update to a copy of the current settings, then apply the copy to the encoder.
+func (enc *OpusEncoder) updateEncoderSettings(update func(*OpusEncoderSettings)) error {
+	enc.encoderMutex.Lock()
+	defer enc.encoderMutex.Unlock()
+
+	encoderSettings := enc.encoderSettings
+	update(&encoderSettings)
+	if err := encoderSettings.apply(enc.encoder); err != nil {
+		// Restore the previous settings, as some may have been applied
+		enc.encoderSettings.apply(enc.encoder)
+		return err
+	}
+	enc.encoderSettings = encoderSettings
+	return nil
+}
+
+// Encode the given PCM data, calling emit with each complete encoded packet, in order.
+//
+// Samples left over (less than a whole encoding frame) are kept until the next call.
+// PCM data of any length is accepted, and encoded as it fits into the PCM buffer.
+//
+// emit takes ownership of each packet, and must Release it once done (e.g. once written to a track),
+// so that its slot may be reused. emit may hold packets beyond the call, but while every slot is held
+// no more packets can be encoded, and their frames are dropped (returning errEncodedPacketRingFull).
+// The packets of a single call with up to 20ms (or the longest frame duration) of PCM data always fit,
+// so a consumer releasing every packet after each call (e.g. after each frame of a batch) never drops a frame.
+//
+// emit is called while the encoder is locked, so it should only collect each packet, and leave
+// sending it (e.g. over the network) until Encode has returned.
+func (enc *OpusEncoder) Encode(pcmData frame.PCMFrame, emit func(*EncodedPacket)) error {
+	enc.encoderMutex.Lock()
+	defer enc.encoderMutex.Unlock()
+
+	var errs []error
+	for len(pcmData) > 0 {
+		// If the incoming data would push Tail beyond the end of the buffer,
+		// copy the unencoded data to the start of the buffer to make room.
+		if len(pcmData)+enc.pcmFrameBufferTail > len(enc.pcmFrameBuffer) {
+			copy(enc.pcmFrameBuffer, enc.pcmFrameBuffer[enc.pcmFrameBufferHead:enc.pcmFrameBufferTail])
+			enc.pcmFrameBufferTail = enc.pcmFrameBufferTail - enc.pcmFrameBufferHead
+			enc.pcmFrameBufferHead = 0
+		}
+
+		// Copy in as much of the new data as fits. Less than a single encoding frame is ever
+		// left unencoded, so there is always room for more when the buffer holds at least two frames.
+		numCopied := copy(enc.pcmFrameBuffer[enc.pcmFrameBufferTail:], pcmData)
+		enc.pcmFrameBufferTail += numCopied
+		pcmData = pcmData[numCopied:]
+
+		// While we can still encode something
+		for enc.pcmFrameBufferTail-enc.pcmFrameBufferHead >= enc.encodingFrameSize {
+			nextEncodingFrame := enc.pcmFrameBuffer[enc.pcmFrameBufferHead : enc.pcmFrameBufferHead+enc.encodingFrameSize]
+			// March the head of the PCM Frame buffer forward by the encoding frame size, since these samples are now dealt with
+			// (even if encoding fails, so a "bad" frame is skipped). This can never go past the end of the buffer, thanks to the loop condition
+			enc.pcmFrameBufferHead += enc.encodingFrameSize
+
+			packet := enc.encodedPackets.acquire()
+			if packet == nil {
+				errs = append(errs, errEncodedPacketRingFull)
+				continue
+			}
+
+			// The slot holds the largest possible packet, so the encoder can never overrun it.
+			// Each frame is its own cgo call: encoding several frames (or encoders) per call would need a batch entry point
+			// in the opus binding, which owns the libopus handles. BenchmarkEncode reports the cost per frame (ns/frame).
+			numEncodedBytes, err := enc.encoder.EncodeFloat32(nextEncodingFrame, packet.buffer)
+			if err != nil {
+				packet.Release()
+				errs = append(errs, err)
+				continue
+			}
+			if numEncodedBytes <= opusDTXPacketSize {
+				// The encoder is in discontinuous transmission, and this packet need not be sent
+				packet.Release()
+				continue
+			}
+			packet.length = numEncodedBytes
+			packet.duration = time.Duration(enc.frameDuration)
+			emit(packet)
+		}
+	}
+
+	return errors.Join(errs...)
+}
@@ -0,0 +1,90 @@
+package encoderdecoder
+
+import (
+	"errors"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/opus"
+)
+
+var (
+	errInvalidBitrate              error = errors.New("OPUS bitrate must be 0 (automatic) or between 6000 and 510000 bits per second")
+	errInvalidComplexity           error = errors.New("OPUS complexity must be between 0 and 10")
+	errInvalidPacketLossPercentage error = errors.New("OPUS expected packet loss must be between 0 and 100 percent")
+)
+
+const (
+	OPUS_MIN_BITRATE = 6000
+	OPUS_MAX_BITRATE = 510000
+)
+
+// Settings of an OPUS encoder, controlling the trade-off between bandwidth, CPU, and loss resilience.
+type OpusEncoderSettings struct {
+	// The target bitrate, in bits per second. 0 lets OPUS choose the bitrate from
+	// the sample rate and number of channels.
+	Bitrate int
+
+	// The computational complexity of the encoder, from 0 (cheapest) to 10 (best quality).
+	Complexity int
+
+	// Whether to carry in-band forward error correction (FEC) data in each packet, from which
+	// the receiver can recover the previous packet if it is lost. FEC costs a few kbps, and
+	// is only added once PacketLossPercentage is above zero.
+	InBandFEC bool
+
+	// Whether to use discontinuous transmission (DTX), i.e. to send packets only rarely during silence.
+	// The packets the encoder marks as not needing transmission are not emitted by OpusEncoder.Encode.
+	DTX bool
+
+	// The packet loss expected on the network, in percent. Higher values make the encoder
+	// spend more of the bitrate on FEC data (if InBandFEC is set).
+	PacketLossPercentage int
+}
+
+// The settings of encoders created by an OpusFactory unless given otherwise (see OpusFactory.WithEncoderSettings).
+//
+// FEC is enabled and a little loss expected, which costs little on a clean network but greatly reduces
+// concealment artifacts on a lossy one. DTX is enabled, so silence (that gets past voice activity detection)
+// costs almost no bandwidth.
+func DefaultOpusEncoderSettings() OpusEncoderSettings {
+	return OpusEncoderSettings{
+		Bitrate:              0,
+		Complexity:           10,
+		InBandFEC:            true,
+		DTX:                  true,
+		PacketLossPercentage: 10,
+	}
+}
+
+func (s OpusEncoderSettings) validate() error {
+	if s.Bitrate != 0 && (s.Bitrate < OPUS_MIN_BITRATE || s.Bitrate > OPUS_MAX_BITRATE) {
+		return errInvalidBitrate
+	}
+	if s.Complexity < 0 || s.Complexity > 10 {
+		return errInvalidComplexity
+	}
+	if s.PacketLossPercentage < 0 || s.PacketLossPercentage > 100 {
+		return errInvalidPacketLossPercentage
+	}
+	return nil
+}
+
+// Apply the settings to the given encoder.
+func (s OpusEncoderSettings) apply(encoder *opus.Encoder) error {
+	if err := s.validate(); err != nil {
+		return err
+	}
+
+	var errBitrate error
+	if s.Bitrate == 0 {
+		errBitrate = encoder.SetBitrateToAuto()
+	} else {
+		errBitrate = encoder.SetBitrate(s.Bitrate)
+	}
+	return errors.Join(
+		errBitrate,
+		encoder.SetComplexity(s.Complexity),
+		encoder.SetInBandFEC(s.InBandFEC),
+		encoder.SetDTX(s.DTX),
+		encoder.SetPacketLossPerc(s.PacketLossPercentage),
+	)
+}
@@ -8,38 +8,40 @@ import (
 var (
 	errInvalidFrameDuration      error = errors.New("given frame duration is not a valid OPUS frame duration")
 	errInvalidBufferSafetyFactor error = errors.New("buffer safety factor must be strictly positive")
+	errInvalidFrameDurationRange error = errors.New("frame duration range must contain the frame duration of the factory")
+	errFrameDurationTooLong      error = errors.New("frame duration is longer than the encoder was created for")
 )
 
 type OpusFactory struct {
-	frameDuration      OPUSFrameDuration
+	frameDuration OPUSFrameDuration
+	// The range the frame duration of each encoder may adapt within, see WithFrameDurationRange
+	minFrameDuration   OPUSFrameDuration
+	maxFrameDuration   OPUSFrameDuration
 	bufferSafetyFactor int
+	encoderSettings    OpusEncoderSettings
+	// The pool encoders and decoders run their work on, if any
+	codecWorkerPool *CodecWorkerPool
 }
 
-// Create a new OPUS factory that produces OPUSEncoderDecoder with the specified values.
+// Create a new OPUS factory that produces OpusEncoders and OpusDecoders with the specified values.
 //
 // frameDuration determines how many samples are required to encode a frame of audio.
 // longer frameDurations reduce network bandwidth, increase audioQuality, and increase latency.
 //
-// bufferSafetyFactor is a multiplier to all buffer lengths in the OPUSEncoderDecoder
-// to prevent the overwriting of memory (encoded/decoded frames) before it can be consumed.
+// bufferSafetyFactor is a multiplier to all buffer lengths in the OpusEncoder
+// to prevent the overwriting of memory (encoded frames) before it can be consumed.
 // A larger bufferSafetyFactor will result in a greater memory overhead (usually on the order of kilobytes)
-// but more robust encoding and decoding, especially when working in highly parallelized, high
-// throughput environments.
+// but more robust encoding, especially when working in highly parallelized, high
+// throughput environments. The OpusDecoder holds no buffers, so is unaffected.
 // For very small frameDurations, consider raising the safety factor.
+//
+// Encoders are created with DefaultOpusEncoderSettings. Use WithEncoderSettings to change them.
 func NewOpusFactory(
 	frameDuration time.Duration,
 	bufferSafetyFactor int,
 ) (OpusFactory, error) {
 	opusFrameDuration := OPUSFrameDuration(frameDuration)
-	switch opusFrameDuration {
-	case OPUS_FRAME_DURATION_2_POINT_5_MS:
-	case OPUS_FRAME_DURATION_5_MS:
-	case OPUS_FRAME_DURATION_10_MS:
-	case OPUS_FRAME_DURATION_20_MS:
-	case OPUS_FRAME_DURATION_40_MS:
-	case OPUS_FRAME_DURATION_60_MS:
-	case OPUS_FRAME_DURATION_120_MS:
-	default:
+	if !opusFrameDuration.isValid() {
 		return OpusFactory{}, errInvalidFrameDuration
 	}
 
@@ -49,10 +51,82 @@ func NewOpusFactory(
 
 	return OpusFactory{
 		frameDuration:      opusFrameDuration,
+		minFrameDuration:   opusFrameDuration,
+		maxFrameDuration:   opusFrameDuration,
 		bufferSafetyFactor: bufferSafetyFactor,
+		encoderSettings:    DefaultOpusEncoderSettings(),
 	}, nil
 }
 
-func (f OpusFactory) NewOpusEncoderDecoder(sampleRate int, numChannels int) (*OpusEncoderDecoder, error) {
-	return newOpusEncoderDecoder(sampleRate, numChannels, f.frameDuration, f.bufferSafetyFactor)
+// Return a copy of this factory, producing encoders with the given settings.
+func (f OpusFactory) WithEncoderSettings(encoderSettings OpusEncoderSettings) (OpusFactory, error) {
+	if err := encoderSettings.validate(); err != nil {
+		return OpusFactory{}, err
+	}
+	f.encoderSettings = encoderSettings
+	return f, nil
+}
+
+// Return a copy of this factory, producing encoders whose frame duration may be changed at runtime
+// (see OpusEncoder.SetFrameDuration) to any valid duration between minFrameDuration and maxFrameDuration.
+// Encoders still start at the frame duration of the factory, which must lie in the range.
+//
+// Short frames give the lowest latency, while long frames greatly reduce the number of packets sent,
+// and with it the overhead of the headers of every packet. Encoders buffer enough for maxFrameDuration,
+// so a wide range costs memory. By default, the range only holds the frame duration of the factory.
+func (f OpusFactory) WithFrameDurationRange(minFrameDuration time.Duration, maxFrameDuration time.Duration) (OpusFactory, error) {
+	opusMinFrameDuration := OPUSFrameDuration(minFrameDuration)
+	opusMaxFrameDuration := OPUSFrameDuration(maxFrameDuration)
+	if !opusMinFrameDuration.isValid() || !opusMaxFrameDuration.isValid() {
+		return OpusFactory{}, errInvalidFrameDuration
+	}
+	if opusMinFrameDuration > f.frameDuration || opusMaxFrameDuration < f.frameDuration {
+		return OpusFactory{}, errInvalidFrameDurationRange
+	}
+	f.minFrameDuration = opusMinFrameDuration
+	f.maxFrameDuration = opusMaxFrameDuration
+	return f, nil
+}
+
+// The range the frame duration of the encoders produced by this factory may adapt within.
+func (f OpusFactory) GetFrameDurationRange() (time.Duration, time.Duration) {
+	return time.Duration(f.minFrameDuration), time.Duration(f.maxFrameDuration)
+}
+
+// Return a copy of this factory, producing encoders and decoders that each run their work
+// on a worker of the given pool (see OpusEncoder.Run, and OpusDecoder.Run).
+// With a nil pool (the default), work runs on the goroutine that submits it.
+func (f OpusFactory) WithCodecWorkerPool(codecWorkerPool *CodecWorkerPool) OpusFactory {
+	f.codecWorkerPool = codecWorkerPool
+	return f
+}
+
+// The settings of the encoders produced by this factory.
+func (f OpusFactory) GetEncoderSettings() OpusEncoderSettings {
+	return f.encoderSettings
+}
+
+// The frame duration the encoders produced by this factory start with.
+func (f OpusFactory) GetFrameDuration() time.Duration {
+	return time.Duration(f.frameDuration)
+}
+
+// Create a new OpusEncoder, with the frame duration, buffer safety factor, encoder settings, and worker pool of this factory.
+func (f OpusFactory) NewOpusEncoder(sampleRate int, numChannels int) (*OpusEncoder, error) {
+	return newOpusEncoder(
+		sampleRate,
+		numChannels,
+		f.frameDuration,
+		f.minFrameDuration,
+		f.maxFrameDuration,
+		f.bufferSafetyFactor,
+		f.encoderSettings,
+		f.codecWorkerPool,
+	)
+}
+
+// Create a new OpusDecoder. A decoder decodes packets of any frame duration, and draws its
+// decoded frames from the frame pool, so only the worker pool of this factory applies.
+func (f OpusFactory) NewOpusDecoder(sampleRate int, numChannels int) (*OpusDecoder, error) {
+	return newOpusDecoder(sampleRate, numChannels, f.codecWorkerPool)
 }
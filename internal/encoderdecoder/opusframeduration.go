@@ -16,3 +16,18 @@ const (
 	OPUS_FRAME_DURATION_60_MS        OPUSFrameDuration = OPUSFrameDuration(60 * time.Millisecond)
 	OPUS_FRAME_DURATION_120_MS       OPUSFrameDuration = OPUSFrameDuration(120 * time.Millisecond)
 )
+
+// Whether the duration is one of the valid OPUS frame durations.
+func (d OPUSFrameDuration) isValid() bool {
+	switch d {
+	case OPUS_FRAME_DURATION_2_POINT_5_MS,
+		OPUS_FRAME_DURATION_5_MS,
+		OPUS_FRAME_DURATION_10_MS,
+		OPUS_FRAME_DURATION_20_MS,
+		OPUS_FRAME_DURATION_40_MS,
+		OPUS_FRAME_DURATION_60_MS,
+		OPUS_FRAME_DURATION_120_MS:
+		return true
+	}
+	return false
+}
@@ -0,0 +1,49 @@
+package encoderdecoder
+
+import (
+	"errors"
+	"time"
+)
+
+var errInvalidOpusPacket error = errors.New("OPUS packet is too short for its table of contents")
+
+// The duration of a single frame, for each configuration of the table of contents byte (RFC 6716, section 3.1).
+var opusConfigFrameDurations = [32]time.Duration{
+	// SILK-only, narrowband to wideband
+	10 * time.Millisecond, 20 * time.Millisecond, 40 * time.Millisecond, 60 * time.Millisecond,
+	10 * time.Millisecond, 20 * time.Millisecond, 40 * time.Millisecond, 60 * time.Millisecond,
+	10 * time.Millisecond, 20 * time.Millisecond, 40 * time.Millisecond, 60 * time.Millisecond,
+	// Hybrid, super-wideband to fullband
+	10 * time.Millisecond, 20 * time.Millisecond,
+	10 * time.Millisecond, 20 * time.Millisecond,
+	// CELT-only, narrowband to fullband
+	2500 * time.Microsecond, 5 * time.Millisecond, 10 * time.Millisecond, 20 * time.Millisecond,
+	2500 * time.Microsecond, 5 * time.Millisecond, 10 * time.Millisecond, 20 * time.Millisecond,
+	2500 * time.Microsecond, 5 * time.Millisecond, 10 * time.Millisecond, 20 * time.Millisecond,
+	2500 * time.Microsecond, 5 * time.Millisecond, 10 * time.Millisecond, 20 * time.Millisecond,
+}
+
+// The duration of audio held by an encoded OPUS packet, read from its table of contents (RFC 6716, section 3.1),
+// i.e. without decoding it. Used to forward packets without decoding them.
+func OpusPacketDuration(packet []byte) (time.Duration, error) {
+	if len(packet) < 1 {
+		return 0, errInvalidOpusPacket
+	}
+	toc := packet[0]
+	frameDuration := opusConfigFrameDurations[toc>>3]
+
+	var numFrames int
+	switch toc & 0x3 {
+	case 0:
+		numFrames = 1
+	case 1, 2:
+		numFrames = 2
+	case 3:
+		// An arbitrary number of frames, given by the following byte
+		if len(packet) < 2 {
+			return 0, errInvalidOpusPacket
+		}
+		numFrames = int(packet[1] & 0x3F)
+	}
+	return time.Duration(numFrames) * frameDuration, nil
+}
@@ -8,10 +8,13 @@ import (
 	"io"
 	"log/slog"
 	"net/http"
+	"sync"
 
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/peer"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
 	"github.com/google/uuid"
+	"github.com/pion/interceptor"
+	"github.com/pion/sdp/v3"
 	"github.com/pion/webrtc/v4"
 )
 
@@ -45,6 +48,10 @@ import (
 //     to the caller of Dial. The listening client takes the established and connected PeerConnection and feeds it
 //     into ConnectionManager.ConnectedPeerChannel, ready to be handled by the main program.
 //
+//  6. With trickle ICE (see SetTrickleICE), neither side waits for ICE gathering to complete before the exchange above.
+//     The answer is returned as soon as it is created, and the dialling client then exchanges ICE candidates with the listening
+//     client as each side gathers them (see signalling.SignallingCandidates), so connectivity checks start with the first candidates.
+//
 // In this way, a user need only publicly broadcast one piece of information which all remote peers can use to make a connection.
 // Security is still ensured, with separate keys per p2p connection, but without a horrendous user experience of per-user transmissions of information.
 //
@@ -58,6 +65,8 @@ type ConnectionManager struct {
 
 	// The URL (address and endpoint) for the signalling server to set up connections
 	signallingServerURL string
+	// The URL (address and endpoint) for the signalling server to trickle ICE candidates through
+	signallingCandidatesURL string
 
 	// Factory to create new Peers during Dial and answering.
 	// The PeerFactory handles setting up the webrtc.PeerConnection with
@@ -71,6 +80,12 @@ type ConnectionManager struct {
 	connectionOfferOptions  webrtc.OfferOptions
 	connectionAnswerOptions webrtc.AnswerOptions
 
+	// Whether offers made by Dial trickle ICE candidates. See SetTrickleICE.
+	trickleICE bool
+	// The connections answering offers made with trickle ICE, whose candidates are still being exchanged, by offer UUID
+	trickleICESessionsMutex sync.Mutex
+	trickleICESessions      map[uuid.UUID]*trickleICESession
+
 	// TODO Extract this to a ConnectRPC framework
 	incomingSDPOfferServer *http.ServeMux
 
@@ -135,20 +150,49 @@ func NewConnectionManager(
 			logger.Error("error while registering codec", "codec", codec, "err", err)
 		}
 	}
+
+	// Interceptors process RTP and RTCP as it is sent and received. The defaults send receiver and
+	// sender reports (RFC 3550) and transport-wide congestion control (TWCC) feedback on received audio.
+	// The TWCC header extension is added to sent audio, so that the remote peer sends TWCC feedback
+	// on it in return. Peers adapt their encoder to this feedback (see peer.bitrateController).
+	// Peers number their sent packets themselves, keeping the time each was sent, so no interceptor sets the extension.
+	interceptorRegistry := &interceptor.Registry{}
+	if err := webrtc.RegisterDefaultInterceptors(mediaEngine, interceptorRegistry); err != nil {
+		logger.Error("error while registering default interceptors", "err", err)
+	}
+	if err := mediaEngine.RegisterHeaderExtension(
+		webrtc.RTPHeaderExtensionCapability{URI: sdp.TransportCCURI},
+		webrtc.RTPCodecTypeAudio,
+	); err != nil {
+		logger.Error("error while registering TWCC header extension", "err", err)
+	}
+	// Sent audio carries the level of the audio in each packet (RFC 6464), so that peers can tell
+	// who is speaking without decoding (see peer.Peer.AudioLevel).
+	if err := mediaEngine.RegisterHeaderExtension(
+		webrtc.RTPHeaderExtensionCapability{URI: sdp.AudioLevelURI},
+		webrtc.RTPCodecTypeAudio,
+	); err != nil {
+		logger.Error("error while registering audio level header extension", "err", err)
+	}
+
 	api := webrtc.NewAPI(
 		webrtc.WithMediaEngine(mediaEngine),
+		webrtc.WithInterceptorRegistry(interceptorRegistry),
 	)
 
 	incomingSDPOfferServer := http.NewServeMux()
 	manager := &ConnectionManager{
 		logger:                  logger,
 		signallingServerURL:     fmt.Sprintf("%s/%s", signallingServerAddress, signalling.SIGNAL_ENDPOINT),
+		signallingCandidatesURL: fmt.Sprintf("%s/%s", signallingServerAddress, signalling.CANDIDATES_ENDPOINT),
 		peerFactory:             peerFactory,
 		localPeerIdentifier:     localPeerIdentifier,
 		webrtcAPI:               api,
 		connectionConfiguration: connectionConfig,
 		connectionOfferOptions:  connectionOfferOptions,
 		connectionAnswerOptions: connectionAnswerOptions,
+		trickleICE:              false,
+		trickleICESessions:      make(map[uuid.UUID]*trickleICESession),
 		incomingSDPOfferServer:  incomingSDPOfferServer,
 		ConnectedPeerChannel:    make(chan *peer.Peer),
 	}
@@ -157,11 +201,29 @@ func NewConnectionManager(
 		fmt.Sprintf("POST /%s", signalling.SIGNAL_ENDPOINT),
 		manager.listenForSessionOffers,
 	)
+	incomingSDPOfferServer.HandleFunc(
+		fmt.Sprintf("POST /%s", signalling.CANDIDATES_ENDPOINT),
+		manager.listenForCandidates,
+	)
 	go http.ListenAndServe(fmt.Sprintf("localhost:%d", localPort), incomingSDPOfferServer)
 
 	return manager
 }
 
+// Set whether offers made by Dial trickle ICE candidates, rather than wait for every candidate to be gathered (the default).
+//
+// Gathering may take seconds (e.g. while waiting on a slow STUN server), and without trickle ICE the answering peer gathers
+// every candidate before it answers, and Dial waits for every local candidate before it returns. With trickle ICE, candidates
+// are exchanged as they are gathered, so the connection is made as soon as the first pair of candidates connects.
+//
+// Trickle ICE requires the signalling server to forward the CANDIDATES_ENDPOINT (see signalling.SignallingCandidates).
+// If it does not, Dial closes the trickled connection, and dials again with full gathering.
+//
+// Offers received are answered the way they were made, whatever this setting. Must be called before Dial.
+func (manager *ConnectionManager) SetTrickleICE(trickleICE bool) {
+	manager.trickleICE = trickleICE
+}
+
 // Listen for an incoming SDP offer on HTTP.
 //
 // Uses the public signalling server to forward traffic back and forth to remote peer.
@@ -239,6 +301,12 @@ func (manager *ConnectionManager) listenForSessionOffers(w http.ResponseWriter,
 	// --------------------------------------------------------------------------------
 	// Create the answer to the incoming offer, set the values on this half of the PeerConnection
 
+	// Candidates are gathered from when the local description is set, so must be queued from before
+	var localCandidates *iceCandidateQueue
+	if signallingOffer.TrickleICE {
+		localCandidates = newICECandidateQueue(pc)
+	}
+
 	if err := pc.SetRemoteDescription(signallingOffer.WebRTCSessionDescription); err != nil {
 		requestLogger.Error(
 			"error while setting remote description of new peer connection",
@@ -274,9 +342,17 @@ func (manager *ConnectionManager) listenForSessionOffers(w http.ResponseWriter,
 
 	requestLogger.Debug("answering peer connection initialized")
 
-	// Wait for ICE to resolve, finalizing connection
-	<-webrtc.GatheringCompletePromise(pc)
-	requestLogger.Debug("answering peer connection ICE resolved")
+	if signallingOffer.TrickleICE {
+		// Answer straight away, and send candidates as they are gathered (see listenForCandidates)
+		manager.addTrickleICESession(signallingOffer.OfferUUID, &trickleICESession{
+			pc:              pc,
+			localCandidates: localCandidates,
+		})
+	} else {
+		// Wait for ICE to resolve, finalizing connection
+		<-webrtc.GatheringCompletePromise(pc)
+		requestLogger.Debug("answering peer connection ICE resolved")
+	}
 
 	// --------------------------------------------------------------------------------
 	// Respond to the signalling server with our answer and wait...
@@ -307,7 +383,14 @@ func (manager *ConnectionManager) listenForSessionOffers(w http.ResponseWriter,
 // If connection is successful, then the connection is returned to be owned by the caller.
 //
 // The returned connection is owned by the caller, meaning it should be closed by the called, too.
+//
+// With trickle ICE (see SetTrickleICE), Dial returns once the offer is answered and the first ICE candidates are exchanged,
+// and the remaining candidates are exchanged in the background.
 func (manager *ConnectionManager) Dial(ctx context.Context, remotePeerIdentifier signalling.PeerIdentifier) error {
+	return manager.dial(ctx, remotePeerIdentifier, manager.trickleICE)
+}
+
+func (manager *ConnectionManager) dial(ctx context.Context, remotePeerIdentifier signalling.PeerIdentifier, trickleICE bool) error {
 	offerUUID := uuid.New()
 	requestLogger := manager.logger.WithGroup("request").With(
 		"requestUUID", uuid.New().String(),
@@ -346,6 +429,12 @@ func (manager *ConnectionManager) Dial(ctx context.Context, remotePeerIdentifier
 	// --------------------------------------------------------------------------------
 	// Create a new offer, set our side of the PeerConnection
 
+	// Candidates are gathered from when the local description is set, so must be queued from before
+	var localCandidates *iceCandidateQueue
+	if trickleICE {
+		localCandidates = newICECandidateQueue(pc)
+	}
+
 	offer, err := pc.CreateOffer(&manager.connectionOfferOptions)
 	if err != nil {
 		requestLogger.Error(
@@ -375,6 +464,7 @@ func (manager *ConnectionManager) Dial(ctx context.Context, remotePeerIdentifier
 		OfferingPeerID:           manager.localPeerIdentifier,
 		OfferUUID:                offerUUID,
 		WebRTCSessionDescription: offer,
+		TrickleICE:               trickleICE,
 	}
 	signallingOfferJSON, err := json.Marshal(signallingOffer)
 	if err != nil {
@@ -442,6 +532,29 @@ func (manager *ConnectionManager) Dial(ctx context.Context, remotePeerIdentifier
 	}
 	requestLogger.Info("peer connection set")
 
+	if trickleICE {
+		exchange := &trickleICEExchange{
+			manager:              manager,
+			offerUUID:            offerUUID,
+			remotePeerIdentifier: remotePeerIdentifier,
+			pc:                   pc,
+			localCandidates:      localCandidates,
+			logger:               requestLogger,
+		}
+		// Neither description holds candidates, so the connection cannot succeed if candidates cannot be exchanged.
+		// The first exchange is made here, so that a signalling server that does not forward candidates is found before returning.
+		done, err := exchange.step(ctx)
+		if err != nil {
+			requestLogger.Warn("error while exchanging ICE candidates, dialing again with full gathering", "err", err)
+			pc.Close()
+			return manager.dial(ctx, remotePeerIdentifier, false)
+		}
+		if !done {
+			go exchange.run()
+		}
+		return nil
+	}
+
 	// Wait for ICE to resolve, finalizing connection
 	<-webrtc.GatheringCompletePromise(pc)
 	requestLogger.Debug("offering peer connection ICE resolved")
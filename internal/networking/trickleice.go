@@ -0,0 +1,311 @@
+package networking
+
+import (
+	"bytes"
+	"context"
+	"encoding/json"
+	"fmt"
+	"io"
+	"log/slog"
+	"net/http"
+	"sync"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
+	"github.com/google/uuid"
+	"github.com/pion/webrtc/v4"
+)
+
+const (
+	// How long candidates are exchanged for at most, once an offer is answered.
+	// Gathering normally completes long before, but a STUN or TURN server may never respond.
+	trickleICETimeout = 30 * time.Second
+
+	// How long the answering peer holds a request for candidates open, waiting for a candidate of its own to respond with.
+	// This bounds both the number of requests made while neither peer has a new candidate,
+	// and how long a new candidate of the offering peer waits to be sent.
+	trickleICEPollTimeout = 100 * time.Millisecond
+)
+
+// --------------------------------------------------------------------------------
+// Candidate Queue
+
+// The local ICE candidates of a webrtc.PeerConnection not yet sent to the remote peer.
+//
+// The queue must be created before the local description of the connection is set, as gathering starts then.
+type iceCandidateQueue struct {
+	mutex      sync.Mutex
+	candidates []webrtc.ICECandidateInit
+	complete   bool
+
+	// Signalled (without blocking) whenever a candidate is pushed, or gathering completes
+	notify chan struct{}
+}
+
+func newICECandidateQueue(pc *webrtc.PeerConnection) *iceCandidateQueue {
+	queue := &iceCandidateQueue{
+		candidates: make([]webrtc.ICECandidateInit, 0),
+		notify:     make(chan struct{}, 1),
+	}
+	pc.OnICECandidate(queue.push)
+	return queue
+}
+
+// The OnICECandidate handler of the connection. A nil candidate signals that gathering is complete.
+func (queue *iceCandidateQueue) push(candidate *webrtc.ICECandidate) {
+	queue.mutex.Lock()
+	if candidate == nil {
+		queue.complete = true
+	} else {
+		queue.candidates = append(queue.candidates, candidate.ToJSON())
+	}
+	queue.mutex.Unlock()
+
+	select {
+	case queue.notify <- struct{}{}:
+	default:
+	}
+}
+
+// Take every candidate queued so far, and whether gathering is complete (i.e. no more candidates will be queued).
+//
+// If no candidate is queued, and gathering is not complete, wait up to the given duration for one first.
+func (queue *iceCandidateQueue) take(wait time.Duration) ([]webrtc.ICECandidateInit, bool) {
+	if wait > 0 {
+		queue.mutex.Lock()
+		empty := len(queue.candidates) == 0 && !queue.complete
+		queue.mutex.Unlock()
+		if empty {
+			timer := time.NewTimer(wait)
+			select {
+			case <-queue.notify:
+			case <-timer.C:
+			}
+			timer.Stop()
+		}
+	}
+
+	queue.mutex.Lock()
+	defer queue.mutex.Unlock()
+	candidates := queue.candidates
+	queue.candidates = make([]webrtc.ICECandidateInit, 0)
+	return candidates, queue.complete
+}
+
+// Add each of the given candidates of the remote peer to the connection. Candidates that cannot be added are logged, and skipped.
+func addRemoteICECandidates(pc *webrtc.PeerConnection, candidates []webrtc.ICECandidateInit, logger *slog.Logger) {
+	for _, candidate := range candidates {
+		if err := pc.AddICECandidate(candidate); err != nil {
+			logger.Warn("error while adding remote ICE candidate", "candidate", candidate.Candidate, "err", err)
+		}
+	}
+}
+
+// --------------------------------------------------------------------------------
+// Answering Peer
+
+// The connection of an offer answered with trickle ICE, whose candidates are still being exchanged.
+type trickleICESession struct {
+	pc              *webrtc.PeerConnection
+	localCandidates *iceCandidateQueue
+}
+
+// Keep the session of the given offer until its candidates have been exchanged, or trickleICETimeout passes.
+func (manager *ConnectionManager) addTrickleICESession(offerUUID uuid.UUID, session *trickleICESession) {
+	manager.trickleICESessionsMutex.Lock()
+	defer manager.trickleICESessionsMutex.Unlock()
+	manager.trickleICESessions[offerUUID] = session
+	time.AfterFunc(trickleICETimeout, func() { manager.expireTrickleICESession(offerUUID) })
+}
+
+func (manager *ConnectionManager) getTrickleICESession(offerUUID uuid.UUID) (*trickleICESession, bool) {
+	manager.trickleICESessionsMutex.Lock()
+	defer manager.trickleICESessionsMutex.Unlock()
+	session, ok := manager.trickleICESessions[offerUUID]
+	return session, ok
+}
+
+// Remove the session of the given offer, returning it (if it was not removed before).
+func (manager *ConnectionManager) removeTrickleICESession(offerUUID uuid.UUID) (*trickleICESession, bool) {
+	manager.trickleICESessionsMutex.Lock()
+	defer manager.trickleICESessionsMutex.Unlock()
+	session, ok := manager.trickleICESessions[offerUUID]
+	delete(manager.trickleICESessions, offerUUID)
+	return session, ok
+}
+
+// Remove the session of the given offer once trickleICETimeout has passed, if its candidates were never fully exchanged.
+//
+// Unless the connection has connected regardless, it is closed (closing its peer too), as it cannot connect without the
+// candidates of the offering peer. This is the case when the offering peer fell back to dialing again with full gathering.
+func (manager *ConnectionManager) expireTrickleICESession(offerUUID uuid.UUID) {
+	session, ok := manager.removeTrickleICESession(offerUUID)
+	if !ok {
+		return
+	}
+	if session.pc.ConnectionState() == webrtc.PeerConnectionStateConnected {
+		return
+	}
+	manager.logger.Info("closing connection whose ICE candidates were not exchanged in time", "offerUUID", offerUUID.String())
+	if err := session.pc.Close(); err != nil {
+		manager.logger.Warn("error while closing connection of expired trickle ICE session", "offerUUID", offerUUID.String(), "err", err)
+	}
+}
+
+// Listen for the ICE candidates of an offering peer, for an offer answered with trickle ICE.
+//
+// The candidates of the offering peer are added to the connection answering the offer,
+// and the response holds the candidates gathered by the answering connection since the last request.
+// If there are none yet, the request is held open for up to trickleICEPollTimeout, waiting for one.
+func (manager *ConnectionManager) listenForCandidates(w http.ResponseWriter, r *http.Request) {
+	requestBody, err := io.ReadAll(r.Body)
+	if err != nil {
+		manager.logger.Error("error while decoding signalling candidates", "err", err)
+		w.WriteHeader(http.StatusBadRequest)
+		return
+	}
+	var remoteCandidates signalling.SignallingCandidates
+	if err := json.Unmarshal(requestBody, &remoteCandidates); err != nil {
+		manager.logger.Error("error while unmarshalling signalling candidates", "err", err)
+		w.WriteHeader(http.StatusBadRequest)
+		return
+	}
+
+	requestLogger := manager.logger.WithGroup("request").With("offerUUID", remoteCandidates.OfferUUID.String())
+	session, ok := manager.getTrickleICESession(remoteCandidates.OfferUUID)
+	if !ok {
+		requestLogger.Debug("candidates received for unknown offer")
+		w.WriteHeader(http.StatusNotFound)
+		return
+	}
+
+	addRemoteICECandidates(session.pc, remoteCandidates.Candidates, requestLogger)
+	candidates, complete := session.localCandidates.take(trickleICEPollTimeout)
+	requestLogger.Debug(
+		"exchanging ICE candidates",
+		"numRemoteCandidates", len(remoteCandidates.Candidates),
+		"numLocalCandidates", len(candidates),
+	)
+	if complete && remoteCandidates.GatheringComplete {
+		manager.removeTrickleICESession(remoteCandidates.OfferUUID)
+	}
+
+	localCandidatesJSON, err := json.Marshal(signalling.SignallingCandidates{
+		OfferUUID:         remoteCandidates.OfferUUID,
+		Candidates:        candidates,
+		GatheringComplete: complete,
+	})
+	if err != nil {
+		requestLogger.Error("error while marshalling local candidates to JSON", "err", err)
+		w.WriteHeader(http.StatusInternalServerError)
+		return
+	}
+	w.Header().Set("Content-Type", "application/json")
+	w.WriteHeader(http.StatusOK)
+	w.Write(localCandidatesJSON)
+}
+
+// --------------------------------------------------------------------------------
+// Offering Peer
+
+// The exchange of ICE candidates of the offering peer with the answering peer of a single offer.
+type trickleICEExchange struct {
+	manager              *ConnectionManager
+	offerUUID            uuid.UUID
+	remotePeerIdentifier signalling.PeerIdentifier
+	pc                   *webrtc.PeerConnection
+	localCandidates      *iceCandidateQueue
+	logger               *slog.Logger
+
+	// Whether the answering peer has finished gathering
+	remoteComplete bool
+}
+
+// Send the candidates gathered locally since the last exchange, and add those gathered by the answering peer.
+// Returns whether both peers have finished gathering, i.e. the exchange is done.
+//
+// As the answering peer holds each request open until it has a candidate, no request is made in vain while both are gathering.
+func (exchange *trickleICEExchange) step(ctx context.Context) (bool, error) {
+	// Once the answering peer has finished, it no longer holds requests open, so wait for local candidates instead
+	var wait time.Duration
+	if exchange.remoteComplete {
+		wait = trickleICEPollTimeout
+	}
+	candidates, complete := exchange.localCandidates.take(wait)
+
+	remoteCandidates, err := exchange.manager.exchangeCandidates(ctx, signalling.SignallingCandidates{
+		AnsweringPeerID:   exchange.remotePeerIdentifier,
+		OfferUUID:         exchange.offerUUID,
+		Candidates:        candidates,
+		GatheringComplete: complete,
+	})
+	if err != nil {
+		return false, err
+	}
+	addRemoteICECandidates(exchange.pc, remoteCandidates.Candidates, exchange.logger)
+	exchange.remoteComplete = remoteCandidates.GatheringComplete
+
+	done := complete && exchange.remoteComplete
+	if done {
+		exchange.logger.Debug("ICE candidates exchanged")
+	}
+	return done, nil
+}
+
+// Exchange the remaining candidates, until both peers have finished gathering, the connection is closed, or trickleICETimeout passes.
+func (exchange *trickleICEExchange) run() {
+	ctx, cancel := context.WithTimeout(context.Background(), trickleICETimeout)
+	defer cancel()
+
+	for ctx.Err() == nil {
+		switch exchange.pc.ConnectionState() {
+		case webrtc.PeerConnectionStateClosed, webrtc.PeerConnectionStateFailed:
+			return
+		}
+
+		done, err := exchange.step(ctx)
+		if err != nil {
+			// Candidates were exchanged before, so the connection may still succeed with those
+			exchange.logger.Warn("error while exchanging ICE candidates", "err", err)
+			return
+		}
+		if done {
+			return
+		}
+	}
+}
+
+// Send the given candidates of the offering peer to the answering peer (via the signalling server), and return those of the answering peer.
+func (manager *ConnectionManager) exchangeCandidates(
+	ctx context.Context,
+	localCandidates signalling.SignallingCandidates,
+) (signalling.SignallingCandidates, error) {
+	var remoteCandidates signalling.SignallingCandidates
+
+	localCandidatesJSON, err := json.Marshal(localCandidates)
+	if err != nil {
+		return remoteCandidates, err
+	}
+	req, err := http.NewRequestWithContext(
+		ctx,
+		http.MethodPost,
+		manager.signallingCandidatesURL,
+		bytes.NewBuffer(localCandidatesJSON),
+	)
+	if err != nil {
+		return remoteCandidates, err
+	}
+	req.Header.Set("Content-Type", "application/json")
+
+	resp, err := http.DefaultClient.Do(req)
+	if err != nil {
+		return remoteCandidates, err
+	}
+	defer resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return remoteCandidates, fmt.Errorf("unexpected response to ICE candidates: %s", resp.Status)
+	}
+
+	err = json.NewDecoder(resp.Body).Decode(&remoteCandidates)
+	return remoteCandidates, err
+}
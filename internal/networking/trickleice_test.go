@@ -0,0 +1,108 @@
+package networking
+
+import (
+	"bytes"
+	"encoding/json"
+	"log/slog"
+	"net/http"
+	"net/http/httptest"
+	"testing"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
+	"github.com/google/uuid"
+	"github.com/pion/webrtc/v4"
+)
+
+// A ConnectionManager holding only what the answering side of trickle ICE uses.
+func newTrickleICETestManager() *ConnectionManager {
+	return &ConnectionManager{
+		logger:             slog.Default(),
+		trickleICESessions: make(map[uuid.UUID]*trickleICESession),
+	}
+}
+
+// Answer an offer with trickle ICE, as listenForSessionOffers does, returning the answering connection.
+func answerWithTrickleICE(t *testing.T, manager *ConnectionManager, offerUUID uuid.UUID) *webrtc.PeerConnection {
+	t.Helper()
+
+	offeringPC, err := webrtc.NewPeerConnection(webrtc.Configuration{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	t.Cleanup(func() { offeringPC.Close() })
+	if _, err := offeringPC.AddTransceiverFromKind(webrtc.RTPCodecTypeAudio); err != nil {
+		t.Fatal(err)
+	}
+	offer, err := offeringPC.CreateOffer(nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := offeringPC.SetLocalDescription(offer); err != nil {
+		t.Fatal(err)
+	}
+
+	pc, err := webrtc.NewPeerConnection(webrtc.Configuration{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	t.Cleanup(func() { pc.Close() })
+	localCandidates := newICECandidateQueue(pc)
+	if err := pc.SetRemoteDescription(offer); err != nil {
+		t.Fatal(err)
+	}
+	answer, err := pc.CreateAnswer(nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := pc.SetLocalDescription(answer); err != nil {
+		t.Fatal(err)
+	}
+
+	manager.addTrickleICESession(offerUUID, &trickleICESession{
+		pc:              pc,
+		localCandidates: localCandidates,
+	})
+	return pc
+}
+
+// The offering peer fell back to full gathering, so never sends the candidates of the offer answered with trickle ICE.
+// Once the session expires, its connection must be closed rather than left to leak with its peer.
+func TestTrickleICEFallbackClosesExpiredSession(t *testing.T) {
+	manager := newTrickleICETestManager()
+	offerUUID := uuid.New()
+	pc := answerWithTrickleICE(t, manager, offerUUID)
+
+	manager.expireTrickleICESession(offerUUID)
+
+	if state := pc.ConnectionState(); state != webrtc.PeerConnectionStateClosed {
+		t.Errorf("connection of expired session is %s, want %s", state, webrtc.PeerConnectionStateClosed)
+	}
+	if _, ok := manager.getTrickleICESession(offerUUID); ok {
+		t.Error("expired session is still held")
+	}
+
+	// Candidates arriving late for the expired offer are refused
+	requestBody, err := json.Marshal(signalling.SignallingCandidates{OfferUUID: offerUUID})
+	if err != nil {
+		t.Fatal(err)
+	}
+	recorder := httptest.NewRecorder()
+	manager.listenForCandidates(recorder, httptest.NewRequest(http.MethodPost, "/candidates", bytes.NewReader(requestBody)))
+	if recorder.Code != http.StatusNotFound {
+		t.Errorf("candidates for expired offer answered with %d, want %d", recorder.Code, http.StatusNotFound)
+	}
+}
+
+// A session whose candidates were all exchanged is removed then, and its connection is left to the peer when the timeout fires.
+func TestTrickleICEExchangedSessionIsNotClosed(t *testing.T) {
+	manager := newTrickleICETestManager()
+	offerUUID := uuid.New()
+	pc := answerWithTrickleICE(t, manager, offerUUID)
+
+	manager.removeTrickleICESession(offerUUID)
+	manager.expireTrickleICESession(offerUUID)
+
+	if state := pc.ConnectionState(); state == webrtc.PeerConnectionStateClosed {
+		t.Error("connection of exchanged session was closed")
+	}
+}
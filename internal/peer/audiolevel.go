@@ -0,0 +1,104 @@
+package peer
+
+import (
+	"math"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+	"github.com/pion/webrtc/v4"
+)
+
+const (
+	// The quietest audio level, i.e. -127dBov or quieter (including digital silence)
+	audioLevelSilence uint8 = 127
+	// Audio at or above -50dBov is voice, matching the quietest voice of the VoiceActivityDetector
+	// (see pkg/audiodevice/device), whose suppression of silence means most audio sent is voice.
+	audioLevelVoiceThreshold uint8 = 50
+)
+
+// The level of a packet of audio, as carried by the audio level RTP header extension (RFC 6464).
+//
+// Each packet sent to a remote peer carries the level of its audio, and the level of each packet received
+// is read before it is decoded, so peers can be ranked by loudness (e.g. to pick the active speakers) without
+// decoding their audio (see Peer.AudioLevel).
+type AudioLevel struct {
+	// The level of the audio in -dBov, from 0 (the loudest, i.e. full scale) to 127 (silence)
+	Level uint8
+	// Whether the audio holds voice
+	Voice bool
+}
+
+// The level of a packet without audio.
+var silentAudioLevel = AudioLevel{Level: audioLevelSilence}
+
+// Measure the audio level of the given samples, from their root mean square.
+func measureAudioLevel(samples frame.PCMFrame) AudioLevel {
+	if len(samples) == 0 {
+		return silentAudioLevel
+	}
+	var sumOfSquares float32
+	for _, sample := range samples {
+		sumOfSquares += sample * sample
+	}
+	meanSquare := float64(sumOfSquares / float32(len(samples)))
+	if meanSquare <= 0 {
+		return silentAudioLevel
+	}
+	// 10*log10 of the mean square is 20*log10 of the root mean square
+	level := uint8(min(max(math.Round(-10*math.Log10(meanSquare)), 0), float64(audioLevelSilence)))
+	return AudioLevel{
+		Level: level,
+		Voice: level <= audioLevelVoiceThreshold,
+	}
+}
+
+// The louder of the two levels.
+func (l AudioLevel) louder(other AudioLevel) AudioLevel {
+	if other.Level < l.Level {
+		return other
+	}
+	return l
+}
+
+// The level of the audio of both levels mixed together. The audio of different sources is uncorrelated,
+// so their mean squares add up.
+func (l AudioLevel) mix(other AudioLevel) AudioLevel {
+	if other.Level >= audioLevelSilence {
+		return l
+	}
+	if l.Level >= audioLevelSilence {
+		return other
+	}
+	meanSquare := math.Pow(10, -float64(l.Level)/10) + math.Pow(10, -float64(other.Level)/10)
+	level := uint8(min(max(math.Round(-10*math.Log10(meanSquare)), 0), float64(audioLevelSilence)))
+	return AudioLevel{
+		Level: level,
+		Voice: l.Voice || other.Voice,
+	}
+}
+
+// The byte of the audio level header extension holding this level (RFC 6464, section 3).
+func (l AudioLevel) marshal() byte {
+	b := min(l.Level, audioLevelSilence)
+	if l.Voice {
+		b |= 0x80
+	}
+	return b
+}
+
+// The level held by the byte of an audio level header extension.
+func unmarshalAudioLevel(b byte) AudioLevel {
+	return AudioLevel{
+		Level: b & 0x7F,
+		Voice: b&0x80 != 0,
+	}
+}
+
+// The ID negotiated for the header extension with the given URI, or 0 if it was not negotiated.
+func headerExtensionID(headerExtensions []webrtc.RTPHeaderExtensionParameter, uri string) uint8 {
+	for _, headerExtension := range headerExtensions {
+		if headerExtension.URI == uri {
+			return uint8(headerExtension.ID)
+		}
+	}
+	return 0
+}
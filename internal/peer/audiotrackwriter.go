@@ -0,0 +1,203 @@
+package peer
+
+import (
+	"encoding/binary"
+	"log/slog"
+	"math/rand/v2"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+	"github.com/pion/rtp"
+	"github.com/pion/webrtc/v4"
+)
+
+// A pause between packets longer than this (beyond the duration of the previous packet) is a pause
+// in the stream, e.g. silence dropped by voice activity detection or discontinuous transmission (DTX),
+// rather than jitter in sending.
+const audioTrackMinPause = 100 * time.Millisecond
+
+// The number of the latest packets whose send time is kept, far more than are sent between two TWCC feedback packets.
+const packetSendTimesLength = 1024
+
+// After the first failed write to a track is logged, only every this many failures are, so a broken track does not flood the log.
+const audioTrackWriteErrorLogInterval = 1000
+
+// Writes the encoded audio sent to a remote peer to its audio track, as RTP packets.
+//
+// The RTP timestamp of each packet advances by the duration of the packet before it, and across a pause in
+// the stream, by the length of the pause too. Without this, a pause would be invisible in the timestamps, and
+// the remote jitter buffer would see every packet after it as very late. The first packet after a pause is
+// marked as the start of a talkspurt (RFC 3551, section 4.1).
+//
+// If the remote peer negotiated the audio level header extension, each packet carries the level of its audio
+// (RFC 6464), so the remote peer can tell who is speaking without decoding. If it negotiated the transport-wide
+// congestion control (TWCC) header extension, each packet carries its transport-wide sequence number, and the time
+// it was sent is kept (see packetSendTimes), so the arrival times the remote peer reports can be compared to it.
+//
+// Writes are serialized, as a peer may briefly be written to by two sources at once
+// (e.g. while it moves between EncoderGroups, each writing outside of its own locks).
+type audioTrackWriter struct {
+	mutex sync.Mutex
+
+	logger    *slog.Logger
+	track     *webrtc.TrackLocalStaticRTP
+	clockRate int
+	// The negotiated IDs of the audio level and TWCC header extensions, or 0 if not negotiated
+	audioLevelExtensionID  uint8
+	transportCCExtensionID uint8
+
+	// Reused for every packet, as the track is done with it once written
+	packet            rtp.Packet
+	audioLevelBuffer  [1]byte
+	transportCCBuffer [2]byte
+
+	// Numbers the packets sent on the connection, and keeps their send times. Shared by every audio track of the connection,
+	// as the sequence is transport-wide. Only audio is sent, so packets are numbered here, rather than by an interceptor.
+	sendTimes *packetSendTimes
+
+	// The time the previous packet was sent, and the duration of audio it held
+	lastSend         time.Time
+	lastSendDuration time.Duration
+
+	// The number of writes that failed (see writeOrLog)
+	numWriteErrors atomic.Uint64
+}
+
+func newAudioTrackWriter(
+	logger *slog.Logger,
+	track *webrtc.TrackLocalStaticRTP,
+	clockRate int,
+	audioLevelExtensionID uint8,
+	transportCCExtensionID uint8,
+	sendTimes *packetSendTimes,
+) *audioTrackWriter {
+	writer := &audioTrackWriter{
+		logger:                 logger.With("track ID", track.ID()),
+		track:                  track,
+		clockRate:              clockRate,
+		audioLevelExtensionID:  audioLevelExtensionID,
+		transportCCExtensionID: transportCCExtensionID,
+		sendTimes:              sendTimes,
+	}
+	// The payload type and SSRC are set by the track, for each connection it is bound to
+	writer.packet.Header = rtp.Header{
+		Version:        2,
+		SequenceNumber: uint16(rand.Uint32()),
+		Timestamp:      rand.Uint32(),
+	}
+	return writer
+}
+
+// Write the given encoded payload, holding the given duration of audio with the given level, to the track now.
+func (w *audioTrackWriter) write(payload []byte, duration time.Duration, level AudioLevel, now time.Time) error {
+	w.mutex.Lock()
+	defer w.mutex.Unlock()
+
+	header := &w.packet.Header
+	if w.lastSend.IsZero() {
+		header.Marker = true
+	} else {
+		header.SequenceNumber++
+		header.Timestamp += w.timestampTicks(w.lastSendDuration)
+		pause := now.Sub(w.lastSend) - w.lastSendDuration
+		header.Marker = pause > audioTrackMinPause
+		if header.Marker {
+			header.Timestamp += w.timestampTicks(pause)
+		}
+	}
+	if w.audioLevelExtensionID != 0 {
+		w.audioLevelBuffer[0] = level.marshal()
+		if err := header.SetExtension(w.audioLevelExtensionID, w.audioLevelBuffer[:]); err != nil {
+			return err
+		}
+	}
+	if w.transportCCExtensionID != 0 {
+		binary.BigEndian.PutUint16(w.transportCCBuffer[:], w.sendTimes.send(now))
+		if err := header.SetExtension(w.transportCCExtensionID, w.transportCCBuffer[:]); err != nil {
+			return err
+		}
+	}
+	w.packet.Payload = payload
+
+	w.lastSend = now
+	w.lastSendDuration = duration
+	return w.track.WriteRTP(&w.packet)
+}
+
+// Write as write does, but log a failure rather than return it, for writers of many peers at once (e.g. an EncoderGroup),
+// which cannot act on the failure of one. The first failure is logged, then every audioTrackWriteErrorLogInterval-th.
+func (w *audioTrackWriter) writeOrLog(payload []byte, duration time.Duration, level AudioLevel, now time.Time) {
+	err := w.write(payload, duration, level, now)
+	if err == nil {
+		return
+	}
+	if numWriteErrors := w.numWriteErrors.Add(1); numWriteErrors%audioTrackWriteErrorLogInterval == 1 {
+		w.logger.Warn("error while writing audio to track", "numWriteErrors", numWriteErrors, "err", err)
+	}
+}
+
+// The number of RTP timestamp ticks (i.e. samples of a single channel) in the given duration.
+func (w *audioTrackWriter) timestampTicks(d time.Duration) uint32 {
+	return uint32(int64(d) * int64(w.clockRate) / int64(time.Second))
+}
+
+// Write each of the given packets, holding audio of the given level, to the audio track of every given peer
+// that is still open, then release them.
+//
+// Packets are collected while encoding, and written once encoding is done, so the network is never
+// written to on a codec worker, nor while the lock of the encoder is held.
+func writeEncodedPackets(packets []*encoderdecoder.EncodedPacket, level AudioLevel, peers ...*Peer) {
+	for _, packet := range packets {
+		now := time.Now()
+		for _, peer := range peers {
+			if peer.ctx.Err() != nil {
+				continue
+			}
+			peer.audioTrackWriter.writeOrLog(packet.Data(), packet.Duration(), level, now)
+		}
+		packet.Release()
+	}
+}
+
+// --------------------------------------------------------------------------------
+// Packet Send Times
+
+// The times the latest packets sent to a remote peer were sent, by transport-wide sequence number.
+// Written by the audioTrackWriter of each audio track of the peer, and read by the bitrateController, from its own goroutine.
+type packetSendTimes struct {
+	// Times are kept relative to this, so each fits alongside its sequence number
+	start time.Time
+	// The transport-wide sequence number of the next packet sent
+	nextSequenceNumber atomic.Uint32
+	// Each entry is the sequence number (the top 16 bits) and the send time in microseconds since start (the rest),
+	// so an entry overwritten by a later packet is never mistaken for the packet asked for
+	entries [packetSendTimesLength]atomic.Uint64
+}
+
+func newPacketSendTimes() *packetSendTimes {
+	return &packetSendTimes{start: time.Now()}
+}
+
+// Number the next packet sent on the connection, sent at the given time, returning its transport-wide sequence number.
+func (t *packetSendTimes) send(sentAt time.Time) uint16 {
+	sequenceNumber := uint16(t.nextSequenceNumber.Add(1) - 1)
+	t.store(sequenceNumber, sentAt)
+	return sequenceNumber
+}
+
+func (t *packetSendTimes) store(sequenceNumber uint16, sentAt time.Time) {
+	micros := uint64(sentAt.Sub(t.start).Microseconds()) & (1<<48 - 1)
+	t.entries[int(sequenceNumber)%packetSendTimesLength].Store(uint64(sequenceNumber)<<48 | micros)
+}
+
+// The time the packet with the given sequence number was sent (relative to an arbitrary, fixed, time),
+// or false if it is not among the latest packets sent.
+func (t *packetSendTimes) load(sequenceNumber uint16) (time.Duration, bool) {
+	entry := t.entries[int(sequenceNumber)%packetSendTimesLength].Load()
+	if entry == 0 || uint16(entry>>48) != sequenceNumber {
+		return 0, false
+	}
+	return time.Duration(entry&(1<<48-1)) * time.Microsecond, true
+}
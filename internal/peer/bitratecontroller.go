@@ -0,0 +1,335 @@
+package peer
+
+import (
+	"math"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+	"github.com/pion/rtcp"
+)
+
+const (
+	// The bitrate assumed per channel of an encoder with an automatic bitrate,
+	// from which the controller starts to lower the bitrate under congestion.
+	bitrateControllerNominalBitratePerChannel = 32000
+
+	// Above this loss, the bitrate is lowered. Below bitrateControllerLowLoss, the bitrate may rise again.
+	bitrateControllerHighLoss = 0.10
+	bitrateControllerLowLoss  = 0.02
+
+	// Once the estimated queueing delay on the path to the remote peer exceeds this, the bitrate is lowered.
+	bitrateControllerMaxQueueingDelay = 40 * time.Millisecond
+	// The factor the bitrate is lowered by when queueing is detected.
+	bitrateControllerQueueingDecrease = 0.85
+	// The factor the bitrate is raised by, when the network allows it.
+	bitrateControllerIncrease = 1.08
+
+	// The bitrate is lowered at most this often, so the effect of a decrease is seen before the next.
+	bitrateControllerDecreaseInterval = 500 * time.Millisecond
+	// The bitrate is raised at most this often, so the network is probed gently.
+	bitrateControllerIncreaseInterval = 1 * time.Second
+
+	// Below this bitrate, the encoder always runs at its highest complexity,
+	// which matters most for quality when there are few bits to spend.
+	bitrateControllerMaxComplexityBitrate = 24000
+	// The most packet loss the encoder is told to expect, bounding the bitrate spent on FEC.
+	bitrateControllerMaxPacketLossPercentage = 30
+
+	// On a short round trip with little loss, the shortest frames are used, for the lowest latency.
+	bitrateControllerLowLatencyRTT = 100 * time.Millisecond
+	// On a long round trip, a few more milliseconds of packetization add little to the latency,
+	// so longer frames are used to cut the number of packets (and their header overhead).
+	bitrateControllerHighRTT = 250 * time.Millisecond
+	// The frame duration is lengthened quickly once the network degrades, but only shortened
+	// again once the network has stayed good for a while, so it does not flap.
+	bitrateControllerFrameDurationIncreaseInterval = 1 * time.Second
+	bitrateControllerFrameDurationDecreaseInterval = 4 * time.Second
+)
+
+// Adapts the encoder settings of a single peer to the network between this client and the remote peer.
+//
+// The controller consumes the RTCP feedback the remote peer sends about the audio it receives:
+// receiver reports (RFC 3550) give the fraction of packets lost, and transport-wide congestion
+// control feedback (TWCC) gives both losses and the arrival times of each packet. The time each packet
+// was sent is kept as it is written (see packetSendTimes), so packets arriving further apart than
+// they were sent means a queue is building on the path, before any loss occurs.
+//
+// From these, the bitrate is lowered under loss or queueing and slowly raised again once the
+// network recovers (additive-increase, multiplicative-decrease), and the expected packet loss
+// (hence the FEC data carried) follows the measured loss.
+//
+// The frame duration (packetization) also follows the network, within the range allowed by the
+// OpusFactory: short frames on a clean, short path for latency, and longer frames under loss,
+// congestion, or a long round trip (estimated from the receiver reports), sending fewer packets.
+type bitrateController struct {
+	// The settings configured for the encoder, i.e. the settings on a perfect network
+	baseEncoderSettings encoderdecoder.OpusEncoderSettings
+	// The bitrate of baseEncoderSettings, or an estimate of it if automatic
+	nominalBitrate int
+	// The range the frame duration may adapt within
+	minFrameDuration time.Duration
+	maxFrameDuration time.Duration
+	// The send times of the packets sent to the remote peer, to compare with their arrival times
+	sendTimes *packetSendTimes
+
+	// The current target bitrate
+	bitrate int
+	// The smoothed fraction of packets lost, from 0 to 1
+	lossFraction float64
+	// The estimated queueing delay on the path to the remote peer
+	queueingDelay time.Duration
+	// The smoothed round trip time to the remote peer, or 0 if not yet measured
+	roundTripTime time.Duration
+	// The current target frame duration
+	frameDuration time.Duration
+
+	lastDecrease            time.Time
+	lastIncrease            time.Time
+	lastFrameDurationChange time.Time
+}
+
+func newBitrateController(
+	baseEncoderSettings encoderdecoder.OpusEncoderSettings,
+	numChannels int,
+	frameDuration time.Duration,
+	minFrameDuration time.Duration,
+	maxFrameDuration time.Duration,
+	sendTimes *packetSendTimes,
+) *bitrateController {
+	nominalBitrate := baseEncoderSettings.Bitrate
+	if nominalBitrate == 0 {
+		nominalBitrate = bitrateControllerNominalBitratePerChannel * numChannels
+	}
+	return &bitrateController{
+		baseEncoderSettings: baseEncoderSettings,
+		nominalBitrate:      nominalBitrate,
+		minFrameDuration:    minFrameDuration,
+		maxFrameDuration:    maxFrameDuration,
+		sendTimes:           sendTimes,
+		bitrate:             nominalBitrate,
+		frameDuration:       frameDuration,
+	}
+}
+
+// Update the controller with RTCP packets received from the remote peer.
+//
+// Returns the encoder settings to use, and whether they (or the frame duration) changed.
+func (c *bitrateController) handleRTCP(packets []rtcp.Packet, now time.Time) (encoderdecoder.OpusEncoderSettings, bool) {
+	updated := false
+	for _, packet := range packets {
+		switch p := packet.(type) {
+		case *rtcp.ReceiverReport:
+			for _, report := range p.Reports {
+				c.updateLoss(float64(report.FractionLost) / 256)
+				c.updateRoundTripTime(report, now)
+				updated = true
+			}
+		case *rtcp.TransportLayerCC:
+			c.handleTransportLayerCC(p)
+			updated = true
+		}
+	}
+	if !updated {
+		return c.encoderSettings(), false
+	}
+	bitrateChanged := c.adapt(now)
+	frameDurationChanged := c.adaptFrameDuration(now)
+	return c.encoderSettings(), bitrateChanged || frameDurationChanged
+}
+
+// The target frame duration, following the network.
+func (c *bitrateController) getFrameDuration() time.Duration {
+	return c.frameDuration
+}
+
+// Update the smoothed loss with a newly measured fraction of packets lost.
+func (c *bitrateController) updateLoss(lossFraction float64) {
+	c.lossFraction += (lossFraction - c.lossFraction) / 4
+}
+
+// Update the round trip time from a receiver report, which echoes the time of the last sender report
+// the remote peer received (LSR), and how long it held it before reporting (DLSR). Both are in the
+// middle 32 bits of an NTP timestamp, i.e. in units of 1/65536 seconds (RFC 3550, Section 6.4.1).
+func (c *bitrateController) updateRoundTripTime(report rtcp.ReceptionReport, now time.Time) {
+	if report.LastSenderReport == 0 {
+		// No sender report received yet
+		return
+	}
+	roundTrip := compactNTPTime(now) - report.LastSenderReport - report.Delay
+	if roundTrip > 1<<31 {
+		// Clocks disagree (or the report is stale), so the measurement is meaningless
+		return
+	}
+	roundTripTime := time.Duration(roundTrip) * time.Second / 65536
+	if c.roundTripTime == 0 {
+		c.roundTripTime = roundTripTime
+		return
+	}
+	c.roundTripTime += (roundTripTime - c.roundTripTime) / 8
+}
+
+// The middle 32 bits of the NTP timestamp of the given time.
+func compactNTPTime(t time.Time) uint32 {
+	// NTP time counts from 1900, rather than 1970
+	const ntpEpochOffset = 2208988800
+	seconds := uint64(t.Unix()) + ntpEpochOffset
+	fraction := uint64(t.Nanosecond()) << 32 / uint64(time.Second)
+	return uint32((seconds<<32 | fraction) >> 16)
+}
+
+// Estimate loss and queueing from a TWCC feedback packet.
+func (c *bitrateController) handleTransportLayerCC(feedback *rtcp.TransportLayerCC) {
+	if feedback.PacketStatusCount == 0 {
+		return
+	}
+	// Only received packets have an arrival time delta
+	received := len(feedback.RecvDeltas)
+	c.updateLoss(1 - float64(received)/float64(feedback.PacketStatusCount))
+	if received < 2 {
+		return
+	}
+
+	// The arrival and send times of the first and last received packets whose send time is known.
+	// The first delta is relative to the reference time, and each other to the previous arrival,
+	// so arrival times are only meaningful relative to each other, as are send times.
+	var arrival, firstArrival, lastArrival, firstSend, lastSend time.Duration
+	numMeasured := 0
+	deltaIndex := 0
+	forEachPacketStatus(feedback, func(sequenceNumber uint16, symbol uint16) {
+		if symbol != rtcp.TypeTCCPacketReceivedSmallDelta && symbol != rtcp.TypeTCCPacketReceivedLargeDelta {
+			return
+		}
+		if deltaIndex >= len(feedback.RecvDeltas) {
+			return
+		}
+		arrival += time.Duration(feedback.RecvDeltas[deltaIndex].Delta) * time.Microsecond
+		deltaIndex += 1
+
+		sent, ok := c.sendTimes.load(sequenceNumber)
+		if !ok {
+			return
+		}
+		if numMeasured == 0 {
+			firstArrival, firstSend = arrival, sent
+		}
+		lastArrival, lastSend = arrival, sent
+		numMeasured += 1
+	})
+	if numMeasured < 2 {
+		return
+	}
+
+	// Any time between the arrivals beyond the time between the sends was spent in a queue
+	arrivalSpan := lastArrival - firstArrival
+	sendSpan := lastSend - firstSend
+	c.queueingDelay = max(c.queueingDelay+arrivalSpan-sendSpan, 0)
+}
+
+// Call f with the transport-wide sequence number and status symbol of each packet a TWCC feedback packet reports on, in order.
+func forEachPacketStatus(feedback *rtcp.TransportLayerCC, f func(sequenceNumber uint16, symbol uint16)) {
+	sequenceNumber := feedback.BaseSequenceNumber
+	// The last chunk may be padded beyond the packets reported on
+	remaining := int(feedback.PacketStatusCount)
+	for _, chunk := range feedback.PacketChunks {
+		switch chunk := chunk.(type) {
+		case *rtcp.RunLengthChunk:
+			for range min(int(chunk.RunLength), remaining) {
+				f(sequenceNumber, chunk.PacketStatusSymbol)
+				sequenceNumber += 1
+				remaining -= 1
+			}
+		case *rtcp.StatusVectorChunk:
+			for _, symbol := range chunk.SymbolList[:min(len(chunk.SymbolList), remaining)] {
+				f(sequenceNumber, symbol)
+				sequenceNumber += 1
+				remaining -= 1
+			}
+		}
+	}
+}
+
+// Lower or raise the bitrate following the current loss and queueing estimates.
+// Returns whether the bitrate changed.
+func (c *bitrateController) adapt(now time.Time) bool {
+	previousBitrate := c.bitrate
+	previousPacketLossPercentage := c.packetLossPercentage()
+
+	switch {
+	case c.queueingDelay > bitrateControllerMaxQueueingDelay || c.lossFraction > bitrateControllerHighLoss:
+		if now.Sub(c.lastDecrease) < bitrateControllerDecreaseInterval {
+			break
+		}
+		decrease := bitrateControllerQueueingDecrease
+		if c.lossFraction > bitrateControllerHighLoss {
+			decrease = min(decrease, 1-c.lossFraction/2)
+		}
+		c.bitrate = max(int(float64(c.bitrate)*decrease), encoderdecoder.OPUS_MIN_BITRATE)
+		c.lastDecrease = now
+		// Queued packets are now draining, so start measuring the queue afresh
+		c.queueingDelay = 0
+
+	case c.lossFraction < bitrateControllerLowLoss:
+		if now.Sub(c.lastIncrease) < bitrateControllerIncreaseInterval || now.Sub(c.lastDecrease) < bitrateControllerIncreaseInterval {
+			break
+		}
+		c.bitrate = min(int(float64(c.bitrate)*bitrateControllerIncrease)+1000, c.nominalBitrate)
+		c.lastIncrease = now
+	}
+
+	return c.bitrate != previousBitrate || c.packetLossPercentage() != previousPacketLossPercentage
+}
+
+// Choose the frame duration for the current state of the network.
+// Returns whether the frame duration changed.
+func (c *bitrateController) adaptFrameDuration(now time.Time) bool {
+	var target time.Duration
+	switch {
+	case c.lossFraction > 2*bitrateControllerHighLoss:
+		target = time.Duration(encoderdecoder.OPUS_FRAME_DURATION_60_MS)
+	case c.lossFraction > bitrateControllerHighLoss || c.bitrate < c.nominalBitrate || c.roundTripTime > bitrateControllerHighRTT:
+		target = time.Duration(encoderdecoder.OPUS_FRAME_DURATION_40_MS)
+	case c.lossFraction < bitrateControllerLowLoss && c.roundTripTime < bitrateControllerLowLatencyRTT:
+		target = time.Duration(encoderdecoder.OPUS_FRAME_DURATION_10_MS)
+	default:
+		target = time.Duration(encoderdecoder.OPUS_FRAME_DURATION_20_MS)
+	}
+	target = min(max(target, c.minFrameDuration), c.maxFrameDuration)
+
+	switch {
+	case target > c.frameDuration && now.Sub(c.lastFrameDurationChange) >= bitrateControllerFrameDurationIncreaseInterval:
+	case target < c.frameDuration && now.Sub(c.lastFrameDurationChange) >= bitrateControllerFrameDurationDecreaseInterval:
+	default:
+		return false
+	}
+	c.frameDuration = target
+	c.lastFrameDurationChange = now
+	return true
+}
+
+// The packet loss the encoder should expect, in percent.
+func (c *bitrateController) packetLossPercentage() int {
+	return min(int(math.Ceil(c.lossFraction*100)), bitrateControllerMaxPacketLossPercentage)
+}
+
+// The encoder settings for the current state of the network.
+func (c *bitrateController) encoderSettings() encoderdecoder.OpusEncoderSettings {
+	settings := c.baseEncoderSettings
+
+	// Back at the nominal bitrate, so return to the configured (possibly automatic) bitrate
+	if c.bitrate < c.nominalBitrate {
+		settings.Bitrate = c.bitrate
+	}
+	if settings.Bitrate != 0 && settings.Bitrate < bitrateControllerMaxComplexityBitrate {
+		settings.Complexity = 10
+	}
+
+	// Carry FEC whenever loss is measured. If FEC is configured, keep it armed even without loss.
+	packetLossPercentage := c.packetLossPercentage()
+	settings.InBandFEC = settings.InBandFEC || packetLossPercentage >= int(bitrateControllerLowLoss*100)
+	if settings.InBandFEC {
+		settings.PacketLossPercentage = max(packetLossPercentage, 1)
+	} else {
+		settings.PacketLossPercentage = packetLossPercentage
+	}
+	return settings
+}
@@ -0,0 +1,346 @@
+package peer
+
+import (
+	"errors"
+	"log/slog"
+	"slices"
+	"sync"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+var (
+	errNoAudioInputTrack error = errors.New("peer has no audio input track to send audio on")
+)
+
+// Identifies peers whose outgoing audio would be encoded identically.
+//
+// Peers with the same negotiated codec properties (sample rate, channels) and the same
+// encoder settings (held by the OpusFactory, e.g. frame duration) can share one encoder.
+type EncoderGroupKey struct {
+	deviceProperties audiodevice.DeviceProperties
+	opusFactory      encoderdecoder.OpusFactory
+}
+
+// An EncoderGroup encodes audio once, and sends the same encoded payload to every Peer in the group.
+//
+// Without an EncoderGroup, every Peer converts and encodes the client's audio itself,
+// so the same audio is encoded once per peer. With an EncoderGroup, the cost of encoding
+// grows with the number of distinct codecs in use, rather than with the number of peers.
+//
+// An EncoderGroup is an AudioSinkDevice (and RingStreamSinkDevice) consuming PCMFrames in the
+// format given by GetDeviceProperties. Peers in a group should not also be given a stream
+// with SetStream, or their audio would be sent twice.
+//
+// EncoderGroups are created and joined through EncoderGroups.Join, and dropped once their last peer leaves (see Done).
+type EncoderGroup struct {
+	logger *slog.Logger
+
+	groups  *EncoderGroups
+	key     EncoderGroupKey
+	encoder *encoderdecoder.OpusEncoder
+	// Closed once the group is dropped, after which frames are released without being encoded
+	done chan struct{}
+	// The source stream may be swapped (e.g. when the input device changes) while the
+	// previous one is still being read, so encoding is serialized.
+	encodeMutex sync.Mutex
+	// The packets encoded from the current frame, and the peers the current batch is written to, reused for every batch.
+	// Guarded by encodeMutex.
+	packets    []*encoderdecoder.EncodedPacket
+	writePeers []*Peer
+
+	peersMutex sync.RWMutex
+	peers      []*Peer
+}
+
+// Get the properties of the PCMFrames consumed by this group, i.e. the negotiated codec of its peers.
+func (group *EncoderGroup) GetDeviceProperties() audiodevice.DeviceProperties {
+	return group.key.deviceProperties
+}
+
+// The settings of the encoder of this group.
+func (group *EncoderGroup) GetEncoderSettings() encoderdecoder.OpusEncoderSettings {
+	return group.encoder.GetEncoderSettings()
+}
+
+// Change the settings of the encoder of this group at runtime, for every peer in the group.
+func (group *EncoderGroup) SetEncoderSettings(encoderSettings encoderdecoder.OpusEncoderSettings) error {
+	return group.encoder.SetEncoderSettings(encoderSettings)
+}
+
+// Closed once the last peer of this group leaves, and the group is dropped from its EncoderGroups.
+// Its source (e.g. the device converting audio for it) should then be closed, as the audio is no longer encoded.
+// A later peer with the same codec joins a new group.
+func (group *EncoderGroup) Done() <-chan struct{} {
+	return group.done
+}
+
+// Set the source channel of this group. PCMFrames arriving on the channel are encoded once,
+// and sent to every peer in the group.
+//
+// Calling SetStream again adds another source, so the previous source should be closed.
+func (group *EncoderGroup) SetStream(sourceStream <-chan *frame.PooledPCMFrame) {
+	go func() {
+		var batch [1]*frame.PooledPCMFrame
+		for pcmFrame := range sourceStream {
+			batch[0] = pcmFrame
+			group.encode(batch[:])
+		}
+	}()
+}
+
+// Set the source ring stream of this group.
+// Identical to SetStream, but frames are read from the RingStream in batches.
+func (group *EncoderGroup) SetRingStream(sourceStream *audiodevice.RingStream) {
+	go func() {
+		batch := make([]*frame.PooledPCMFrame, audiodevice.DEFAULT_RING_STREAM_CAPACITY)
+		for {
+			n, ok := sourceStream.Read(batch)
+			if !ok {
+				return
+			}
+			group.encode(batch[:n])
+		}
+	}()
+}
+
+// Encode each frame, and write the encoded frames to the audio track of every peer in the group.
+// Takes ownership of the given frames.
+func (group *EncoderGroup) encode(pcmFrames []*frame.PooledPCMFrame) {
+	group.encodeMutex.Lock()
+	defer group.encodeMutex.Unlock()
+
+	select {
+	case <-group.done:
+		// No peer is left to send to, so the source is only yet to be closed
+		for _, pcmData := range pcmFrames {
+			pcmData.Release()
+		}
+		return
+	default:
+	}
+
+	// The level of the batch (its loudest frame) is measured once, and sent with every packet, to every peer
+	level := silentAudioLevel
+	for _, pcmFrame := range pcmFrames {
+		level = level.louder(measureAudioLevel(pcmFrame.Samples()))
+	}
+
+	// The peers are copied, so peers may join and leave while the packets are written
+	group.peersMutex.RLock()
+	group.writePeers = append(group.writePeers, group.peers...)
+	group.peersMutex.RUnlock()
+
+	// Each frame is encoded in a job of its own (on the worker of the encoder, if it has one), and its packets written
+	// to every peer (and their slots released) before the next frame is encoded. A burst of frames (e.g. after a stall)
+	// then holds no more packets at once than a single frame does, so it never exhausts the slots of the encoder.
+	var errs []error
+	for _, pcmFrame := range pcmFrames {
+		var err error
+		group.encoder.Run(func() {
+			err = group.encoder.Encode(pcmFrame.Samples(), group.collectPacket)
+		})
+		if err != nil {
+			errs = append(errs, err)
+		}
+		writeEncodedPackets(group.packets, level, group.writePeers...)
+		clear(group.packets)
+		group.packets = group.packets[:0]
+	}
+	err := errors.Join(errs...)
+	clear(group.writePeers)
+	group.writePeers = group.writePeers[:0]
+
+	// Encode copies the samples it needs, so the frames can be released immediately
+	for _, pcmData := range pcmFrames {
+		pcmData.Release()
+	}
+	if err != nil {
+		group.logger.Error(
+			"error while encoding pcm data",
+			"numFrames", len(pcmFrames),
+			"err", err,
+		)
+	}
+}
+
+// The emit callback of the encoder of the group. Only called while encodeMutex is held.
+func (group *EncoderGroup) collectPacket(packet *encoderdecoder.EncodedPacket) {
+	group.packets = append(group.packets, packet)
+}
+
+// Add the given peer to the group, unless it is already in it.
+func (group *EncoderGroup) addPeer(peer *Peer) {
+	group.peersMutex.Lock()
+	defer group.peersMutex.Unlock()
+	if slices.Contains(group.peers, peer) {
+		return
+	}
+	group.peers = append(group.peers, peer)
+}
+
+func (group *EncoderGroup) removePeer(peer *Peer) {
+	group.peersMutex.Lock()
+	for i, p := range group.peers {
+		if p == peer {
+			group.peers = append(group.peers[:i], group.peers[i+1:]...)
+			break
+		}
+	}
+	group.peersMutex.Unlock()
+
+	// The peer may have been holding back the encoder of the others
+	group.adaptEncoderSettings()
+}
+
+// Adapt the shared encoder of the group to the network of its peers.
+//
+// One encoding must serve every peer, so the most constrained target of any peer is used:
+// the lowest bitrate, the most FEC, and the longest frame duration. Peers without a target yet use the configured settings.
+func (group *EncoderGroup) adaptEncoderSettings() {
+	group.peersMutex.RLock()
+	baseEncoderSettings := group.key.opusFactory.GetEncoderSettings()
+	var encoderSettings *encoderdecoder.OpusEncoderSettings
+	// The longest frame duration any peer asks for, as it suits the most constrained network
+	var frameDuration time.Duration
+	for _, peer := range group.peers {
+		targetFrameDuration := time.Duration(peer.targetFrameDuration.Load())
+		if targetFrameDuration == 0 {
+			targetFrameDuration = group.key.opusFactory.GetFrameDuration()
+		}
+		frameDuration = max(frameDuration, targetFrameDuration)
+
+		target := peer.targetEncoderSettings.Load()
+		if target == nil {
+			target = &baseEncoderSettings
+		}
+		if encoderSettings == nil {
+			encoderSettings = new(encoderdecoder.OpusEncoderSettings)
+			*encoderSettings = *target
+			continue
+		}
+		// A bitrate of 0 is automatic, i.e. unconstrained
+		if target.Bitrate != 0 && (encoderSettings.Bitrate == 0 || target.Bitrate < encoderSettings.Bitrate) {
+			encoderSettings.Bitrate = target.Bitrate
+		}
+		encoderSettings.Complexity = max(encoderSettings.Complexity, target.Complexity)
+		encoderSettings.InBandFEC = encoderSettings.InBandFEC || target.InBandFEC
+		encoderSettings.PacketLossPercentage = max(encoderSettings.PacketLossPercentage, target.PacketLossPercentage)
+	}
+	group.peersMutex.RUnlock()
+
+	if frameDuration != 0 && frameDuration != group.encoder.GetFrameDuration() {
+		if err := group.encoder.SetFrameDuration(frameDuration); err != nil {
+			group.logger.Error("error while adapting encoder frame duration", "err", err)
+		}
+	}
+	if encoderSettings == nil || *encoderSettings == group.encoder.GetEncoderSettings() {
+		return
+	}
+	if err := group.encoder.SetEncoderSettings(*encoderSettings); err != nil {
+		group.logger.Error("error while adapting encoder settings", "err", err)
+	}
+}
+
+// The number of peers currently in this group.
+func (group *EncoderGroup) NumPeers() int {
+	group.peersMutex.RLock()
+	defer group.peersMutex.RUnlock()
+	return len(group.peers)
+}
+
+// --------------------------------------------------------------------------------
+// EncoderGroups
+
+// The set of EncoderGroups of a client, one for each distinct EncoderGroupKey of its peers.
+//
+// Groups are created as peers join, so a later peer with the same codec reuses the existing group and its source.
+// A group is dropped once its last peer leaves, so no audio is converted or encoded for a codec no peer uses.
+type EncoderGroups struct {
+	mutex  sync.Mutex
+	groups map[EncoderGroupKey]*EncoderGroup
+}
+
+func NewEncoderGroups() *EncoderGroups {
+	return &EncoderGroups{
+		groups: make(map[EncoderGroupKey]*EncoderGroup),
+	}
+}
+
+// Add the given peer to the EncoderGroup matching its negotiated codec and encoder settings,
+// creating the group if required. The peer leaves the group when it is closed.
+//
+// Returns the group, and whether it was newly created. A new group has no source,
+// so the caller must call SetStream (or SetRingStream) on it.
+func (groups *EncoderGroups) Join(peer *Peer) (*EncoderGroup, bool, error) {
+	if peer.connectionAudioInputTrack == nil {
+		return nil, false, errNoAudioInputTrack
+	}
+	key := EncoderGroupKey{
+		deviceProperties: peer.GetDeviceProperties(),
+		opusFactory:      peer.opusFactory,
+	}
+
+	groups.mutex.Lock()
+	group, ok := groups.groups[key]
+	isNew := !ok
+	if isNew {
+		encoder, err := key.opusFactory.NewOpusEncoder(
+			key.deviceProperties.SampleRate,
+			key.deviceProperties.NumChannels,
+		)
+		if err != nil {
+			groups.mutex.Unlock()
+			return nil, false, err
+		}
+		group = &EncoderGroup{
+			logger: slog.Default().With(
+				"encoder group", key.deviceProperties,
+			),
+			groups:  groups,
+			key:     key,
+			encoder: encoder,
+			done:    make(chan struct{}),
+			peers:   make([]*Peer, 0),
+		}
+		groups.groups[key] = group
+	}
+	// The peer is added under the lock, so the group cannot be dropped before the peer is in it
+	group.addPeer(peer)
+	groups.mutex.Unlock()
+
+	if oldGroup := peer.encoderGroup.Swap(group); oldGroup != nil && oldGroup != group {
+		oldGroup.groups.leave(oldGroup, peer)
+	}
+	return group, isNew, nil
+}
+
+// Remove the given peer from the given group, dropping the group if the peer was its last.
+func (groups *EncoderGroups) leave(group *EncoderGroup, peer *Peer) {
+	group.removePeer(peer)
+
+	groups.mutex.Lock()
+	defer groups.mutex.Unlock()
+	if groups.groups[group.key] != group || group.NumPeers() > 0 {
+		return
+	}
+	delete(groups.groups, group.key)
+	close(group.done)
+	// The group may still be encoding its current batch, which a closed encoder allows
+	group.encoder.Close()
+	group.logger.Debug("dropped empty encoder group")
+}
+
+// All the groups with at least one peer.
+func (groups *EncoderGroups) Groups() []*EncoderGroup {
+	groups.mutex.Lock()
+	defer groups.mutex.Unlock()
+	allGroups := make([]*EncoderGroup, 0, len(groups.groups))
+	for _, group := range groups.groups {
+		allGroups = append(allGroups, group)
+	}
+	return allGroups
+}
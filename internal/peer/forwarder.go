@@ -0,0 +1,259 @@
+package peer
+
+import (
+	"log/slog"
+	"slices"
+	"sync"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+)
+
+// The number of speakers a Forwarder forwards at once by default, i.e. the loudest few (see Forwarder.SetMaxActiveSpeakers).
+const DEFAULT_FORWARDER_MAX_ACTIVE_SPEAKERS int = 3
+
+const (
+	// A forwarded speaker keeps its place unless another participant is this many dB louder,
+	// so that two participants of similar loudness do not flap in and out of being forwarded.
+	forwarderHysteresis = 6
+
+	// How often the speakers forwarded are chosen again, at most.
+	forwarderSelectionInterval = 20 * time.Millisecond
+)
+
+// A Forwarder is the selective forwarding unit (SFU) of a room, run by a designated node that every participant connects to.
+//
+// In a full mesh, every client connects to every other, so it encodes and sends its audio once per peer, and receives
+// and decodes the audio of every peer: the upload and CPU of each client grow with the size of the room. With a Forwarder,
+// every participant holds a single connection (to the forwarding node), sending its audio once, and receiving the audio
+// of the few participants speaking at the time, however large the room.
+//
+// The Forwarder never decodes (nor encodes) audio. Participants are ranked by the audio level of the packets they send
+// (see AudioLevel), and the loudest few (the active speakers, see SetMaxActiveSpeakers) are forwarded to every other
+// participant, each on an audio track of its own, so each participant hears (and mixes) every active speaker but itself,
+// as with a Mixer. The encoded payload of each packet is written as-is to the track of each participant that hears it,
+// with the sequence numbers and timestamps of that track, so for participants a Forwarder looks like any other peer.
+//
+// A participant has as many tracks as it and the forwarding node both negotiated (see PeerFactory.SetNumAudioTracks),
+// and hears at most that many speakers. A speaker keeps the same track of each participant for as long as it is forwarded.
+//
+// Participants must send the audio level header extension (which every Peer does) to be heard.
+//
+// Peers join a Forwarder with Join. A peer in a Forwarder should not also be given a stream with SetStream,
+// nor join an EncoderGroup, as the Forwarder writes to its audio track.
+type Forwarder struct {
+	logger *slog.Logger
+
+	// Guards every field below, and serializes the writes to the audio tracks of each participant
+	mutex        sync.Mutex
+	participants []*forwarderParticipant
+
+	// The number of speakers forwarded at once, or 0 to forward every participant with voice
+	maxActiveSpeakers int
+	// The loudest participants, forwarded to every other participant, loudest first
+	speakers      []*Peer
+	lastSelection time.Time
+
+	// Scratch space to rank and select the speakers in, reused by every selection
+	rankedSpeakers []rankedForwarderSpeaker
+	nextSpeakers   []*Peer
+	heardSpeakers  []*Peer
+}
+
+// A participant with voice, and the loudness it is ranked by (in dB above silence).
+type rankedForwarderSpeaker struct {
+	peer     *Peer
+	loudness int
+}
+
+// A participant of a Forwarder, and the speaker forwarded on each of its tracks.
+type forwarderParticipant struct {
+	peer *Peer
+	// The writer of each audio track of the peer, the first being that of its connectionAudioInputTrack
+	trackWriters []*audioTrackWriter
+	// The speaker forwarded on each track, or nil if the track is free
+	trackSpeakers []*Peer
+}
+
+// Create a new, empty, Forwarder.
+func NewForwarder() *Forwarder {
+	return &Forwarder{
+		logger:            slog.Default(),
+		participants:      make([]*forwarderParticipant, 0),
+		maxActiveSpeakers: DEFAULT_FORWARDER_MAX_ACTIVE_SPEAKERS,
+		speakers:          make([]*Peer, 0),
+	}
+}
+
+// Forward the n loudest participants. If n is 0, every participant with voice is forwarded.
+//
+// Each participant hears at most as many speakers as it has audio tracks (see PeerFactory.SetNumAudioTracks),
+// so the participants and the forwarding node should set their number of tracks to n.
+func (f *Forwarder) SetMaxActiveSpeakers(n int) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	f.maxActiveSpeakers = max(n, 0)
+}
+
+// Add the given peer to the room. The audio the peer sends is forwarded to the other participants (and not decoded),
+// and the peer receives the audio of the active speakers. The peer leaves the room when it is closed.
+func (f *Forwarder) Join(peer *Peer) error {
+	if peer.connectionAudioInputTrack == nil {
+		return errNoAudioInputTrack
+	}
+	if oldForwarder := peer.forwarder.Swap(f); oldForwarder != nil {
+		oldForwarder.leave(peer)
+	}
+
+	trackWriters := append([]*audioTrackWriter{peer.audioTrackWriter}, peer.forwardingTrackWriters...)
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	f.participants = append(f.participants, &forwarderParticipant{
+		peer:          peer,
+		trackWriters:  trackWriters,
+		trackSpeakers: make([]*Peer, len(trackWriters)),
+	})
+	f.assignTracks()
+	peer.logger.Info("peer joined forwarder", "numParticipants", len(f.participants), "numTracks", len(trackWriters))
+	return nil
+}
+
+// Add every peer arriving on the given channel (e.g. ConnectionManager.ConnectedPeerChannel) to the room,
+// until the channel is closed. Peers that cannot join are closed.
+func (f *Forwarder) Serve(peers <-chan *Peer) {
+	for peer := range peers {
+		if err := f.Join(peer); err != nil {
+			peer.logger.Error("failed to join forwarder", "err", err)
+			peer.Close()
+		}
+	}
+}
+
+// The number of participants currently in the room.
+func (f *Forwarder) NumParticipants() int {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	return len(f.participants)
+}
+
+func (f *Forwarder) leave(peer *Peer) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	f.participants = slices.DeleteFunc(f.participants, func(participant *forwarderParticipant) bool {
+		return participant.peer == peer
+	})
+	if i := slices.Index(f.speakers, peer); i >= 0 {
+		f.speakers = slices.Delete(f.speakers, i, i+1)
+	}
+	f.selectSpeakers()
+}
+
+// Forward the given packet, received from source with the given audio level, to every participant that hears source.
+// Called by the goroutine receiving the audio of source, in place of decoding it.
+func (f *Forwarder) forward(source *Peer, payload []byte, level AudioLevel, now time.Time) {
+	// The duration is read from the payload itself, as the forwarded timestamps are those of each participant's track
+	duration, err := encoderdecoder.OpusPacketDuration(payload)
+	if err != nil {
+		source.logger.Debug("dropping packet that cannot be forwarded", "err", err)
+		return
+	}
+
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	if now.Sub(f.lastSelection) >= forwarderSelectionInterval {
+		f.lastSelection = now
+		f.selectSpeakers()
+	}
+	// The audio of every participant that is not a speaker is dropped here, without ever being decoded
+	if !slices.Contains(f.speakers, source) {
+		return
+	}
+
+	for _, participant := range f.participants {
+		if participant.peer.ctx.Err() != nil {
+			continue
+		}
+		if track := slices.Index(participant.trackSpeakers, source); track >= 0 {
+			participant.trackWriters[track].writeOrLog(payload, duration, level, now)
+		}
+	}
+}
+
+// Choose the speakers, from the latest audio level of each participant, and assign them to the tracks of each participant.
+// Must be called with the mutex held.
+//
+// Only participants with voice are ranked. Without enough voices (e.g. in a pause), the previous speakers keep their place.
+func (f *Forwarder) selectSpeakers() {
+	limit := f.maxActiveSpeakers
+	if limit == 0 {
+		limit = len(f.participants)
+	}
+
+	// Rank the participants with voice, loudest first. Current speakers are favoured,
+	// so they are only replaced by a clearly louder participant.
+	ranked := f.rankedSpeakers[:0]
+	for _, participant := range f.participants {
+		level := participant.peer.AudioLevel()
+		if !level.Voice {
+			continue
+		}
+		loudness := int(audioLevelSilence - level.Level)
+		if slices.Contains(f.speakers, participant.peer) {
+			loudness += forwarderHysteresis
+		}
+		ranked = append(ranked, rankedForwarderSpeaker{peer: participant.peer, loudness: loudness})
+	}
+	slices.SortStableFunc(ranked, func(a, b rankedForwarderSpeaker) int { return b.loudness - a.loudness })
+	f.rankedSpeakers = ranked
+
+	speakers := f.nextSpeakers[:0]
+	for _, r := range ranked[:min(len(ranked), limit)] {
+		speakers = append(speakers, r.peer)
+	}
+	// Fill the remaining places with the previous speakers
+	for _, speaker := range f.speakers {
+		if len(speakers) == limit {
+			break
+		}
+		if !slices.Contains(speakers, speaker) {
+			speakers = append(speakers, speaker)
+		}
+	}
+
+	if len(speakers) > 0 && (len(f.speakers) == 0 || speakers[0] != f.speakers[0]) {
+		f.logger.Debug("dominant speaker changed", "peer uuid", speakers[0].identifier.Uuid)
+	}
+	f.speakers, f.nextSpeakers = speakers, f.speakers
+	f.assignTracks()
+}
+
+// Assign the speakers each participant hears (every speaker but itself, the loudest first) to its tracks.
+// A speaker heard before keeps its track, and a new speaker takes a free track, so each track carries
+// a single speaker for as long as it is heard. Must be called with the mutex held.
+func (f *Forwarder) assignTracks() {
+	for _, participant := range f.participants {
+		heard := f.heardSpeakers[:0]
+		for _, speaker := range f.speakers {
+			if len(heard) == len(participant.trackSpeakers) {
+				break
+			}
+			if speaker != participant.peer {
+				heard = append(heard, speaker)
+			}
+		}
+
+		for track, speaker := range participant.trackSpeakers {
+			if !slices.Contains(heard, speaker) {
+				participant.trackSpeakers[track] = nil
+			}
+		}
+		for _, speaker := range heard {
+			if slices.Contains(participant.trackSpeakers, speaker) {
+				continue
+			}
+			participant.trackSpeakers[slices.Index(participant.trackSpeakers, nil)] = speaker
+		}
+		f.heardSpeakers = heard
+	}
+}
@@ -0,0 +1,155 @@
+package peer
+
+import (
+	"context"
+	"fmt"
+	"log/slog"
+	"testing"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
+	"github.com/google/uuid"
+	"github.com/pion/webrtc/v4"
+)
+
+// The TOC byte of an OPUS packet holding a single 20ms frame (SILK narrowband, RFC 6716 section 3.1).
+const forwarderTestTOC byte = 1 << 3
+
+// A participant of a Forwarder in the test: an in-process Peer with the given number of audio tracks,
+// whose remote peer sends audio at a level set by the test, each packet holding the given id.
+type forwarderTestPeer struct {
+	*Peer
+	id       byte
+	receiver *audioReceiver
+}
+
+func newForwarderTestPeer(t *testing.T, id byte, numTracks int) *forwarderTestPeer {
+	t.Helper()
+	ctx, cancel := context.WithCancel(context.Background())
+	t.Cleanup(cancel)
+
+	codec := webrtc.RTPCodecCapability{MimeType: webrtc.MimeTypeOpus, ClockRate: 48000, Channels: 1}
+	sendTimes := newPacketSendTimes()
+	trackWriters := make([]*audioTrackWriter, numTracks)
+	var inputTrack *webrtc.TrackLocalStaticRTP
+	for i := range trackWriters {
+		track, err := webrtc.NewTrackLocalStaticRTP(codec, fmt.Sprintf("peer %d audio %d", id, i), fmt.Sprintf("peer %d audio stream", id))
+		if err != nil {
+			t.Fatal(err)
+		}
+		if i == 0 {
+			inputTrack = track
+		}
+		trackWriters[i] = newAudioTrackWriter(slog.Default(), track, int(codec.ClockRate), 0, 0, sendTimes)
+	}
+
+	receiver := &audioReceiver{}
+	peer := &Peer{
+		peerCore: &peerCore{
+			logger:                    slog.Default(),
+			identifier:                signalling.PeerIdentifier{Uuid: uuid.New()},
+			ctx:                       ctx,
+			ctxCancelFunc:             cancel,
+			connectionAudioInputTrack: inputTrack,
+		},
+		audioTrackWriter:       trackWriters[0],
+		forwardingTrackWriters: trackWriters[1:],
+	}
+	peer.audioReceivers.Store(&[]*audioReceiver{receiver})
+	return &forwarderTestPeer{Peer: peer, id: id, receiver: receiver}
+}
+
+// Receive audio of the given level from the remote peer, as receiveAudioOutputHandler would.
+func (p *forwarderTestPeer) setAudioLevel(level AudioLevel) {
+	p.receiver.level.Store(uint32(level.marshal()))
+	p.receiver.levelTime.Store(time.Now().UnixNano())
+}
+
+// Send a packet from the remote peer through the Forwarder, as receiveAudioOutputHandler would.
+func (p *forwarderTestPeer) send(f *Forwarder, now time.Time) {
+	f.forward(p.Peer, []byte{forwarderTestTOC, p.id}, p.AudioLevel(), now)
+}
+
+// The id of the speaker whose packet was last written to each track of the peer, or 0 if none was,
+// after which the tracks are cleared.
+func (p *forwarderTestPeer) takeForwarded() []byte {
+	trackWriters := append([]*audioTrackWriter{p.audioTrackWriter}, p.forwardingTrackWriters...)
+	forwarded := make([]byte, len(trackWriters))
+	for i, writer := range trackWriters {
+		if payload := writer.packet.Payload; len(payload) == 2 {
+			forwarded[i] = payload[1]
+		}
+		writer.packet.Payload = nil
+	}
+	return forwarded
+}
+
+// Four participants with two tracks each, in a Forwarder forwarding two speakers:
+// the two loudest are forwarded, each to every other participant, and keep their track while the speakers change.
+func TestForwarderAssignsSpeakersToTracks(t *testing.T) {
+	const numTracks = 2
+	forwarder := NewForwarder()
+	forwarder.SetMaxActiveSpeakers(numTracks)
+
+	a := newForwarderTestPeer(t, 'a', numTracks)
+	b := newForwarderTestPeer(t, 'b', numTracks)
+	c := newForwarderTestPeer(t, 'c', numTracks)
+	d := newForwarderTestPeer(t, 'd', numTracks)
+	peers := []*forwarderTestPeer{a, b, c, d}
+	for _, p := range peers {
+		if err := forwarder.Join(p.Peer); err != nil {
+			t.Fatal(err)
+		}
+	}
+
+	expectForwarded := func(step string, expected map[*forwarderTestPeer]string) {
+		t.Helper()
+		for _, p := range peers {
+			if forwarded := string(p.takeForwarded()); forwarded != expected[p] {
+				t.Errorf("%s: peer %c received %q on its tracks, want %q", step, p.id, forwarded, expected[p])
+			}
+		}
+	}
+
+	// a is loudest, then b, then c, while d is silent
+	a.setAudioLevel(AudioLevel{Level: 10, Voice: true})
+	b.setAudioLevel(AudioLevel{Level: 20, Voice: true})
+	c.setAudioLevel(AudioLevel{Level: 30, Voice: true})
+	d.setAudioLevel(silentAudioLevel)
+	now := time.Now()
+	for _, p := range peers {
+		p.send(forwarder, now)
+	}
+	expectForwarded("a and b speaking", map[*forwarderTestPeer]string{
+		a: "b\x00",
+		b: "a\x00",
+		c: "ab",
+		d: "ab",
+	})
+
+	// c becomes the loudest, replacing b (the quieter speaker), on the track b was forwarded on
+	c.setAudioLevel(AudioLevel{Level: 0, Voice: true})
+	now = now.Add(forwarderSelectionInterval)
+	for _, p := range peers {
+		p.send(forwarder, now)
+	}
+	expectForwarded("c replaces b", map[*forwarderTestPeer]string{
+		a: "c\x00",
+		b: "ac",
+		c: "a\x00",
+		d: "ac",
+	})
+
+	// A speaker only slightly louder than a current one does not replace it
+	b.setAudioLevel(AudioLevel{Level: 8, Voice: true})
+	now = now.Add(forwarderSelectionInterval)
+	for _, p := range peers {
+		p.send(forwarder, now)
+	}
+	expectForwarded("b within hysteresis", map[*forwarderTestPeer]string{
+		a: "c\x00",
+		b: "ac",
+		c: "a\x00",
+		d: "ac",
+	})
+}
@@ -0,0 +1,281 @@
+package peer
+
+import (
+	"sync"
+	"time"
+)
+
+const (
+	// The number of packets the jitterBuffer can hold. Must be a power of two.
+	// At 20ms per packet, this is over a second of audio, well above jitterBufferMaxDelay.
+	jitterBufferCapacity = 64
+
+	// Bounds of the target playout delay of the jitterBuffer.
+	jitterBufferMinDelay = 20 * time.Millisecond
+	jitterBufferMaxDelay = 400 * time.Millisecond
+
+	// The target delay is this many times the measured jitter (on top of a single packet),
+	// enough to absorb nearly all of the variation in arrival times.
+	jitterBufferJitterMultiplier = 4
+
+	// After this many packets concealed in a row with an empty buffer, the stream has
+	// most likely paused (or stalled), so the buffer refills to the target delay before playing again.
+	jitterBufferMaxConsecutiveConcealments = 5
+
+	// The packet duration assumed until two consecutive packets have been received.
+	jitterBufferDefaultPacketDuration = 20 * time.Millisecond
+	// The longest duration of audio a single packet may hold (the longest OPUS frame)
+	jitterBufferMaxPacketDuration = 120 * time.Millisecond
+)
+
+// What the jitterBuffer decided should be played next. See jitterBuffer.pop.
+type playoutAction int
+
+const (
+	// Nothing is played, as the buffer is filling up to the target delay.
+	playoutWait playoutAction = iota
+	// The next packet arrived, and is decoded as normal.
+	playoutPacket
+	// The next packet was lost, but the packet after it arrived, so the lost packet
+	// is recovered from the forward error correction data of the packet after it.
+	playoutFEC
+	// The next packet was lost (or is late), and is concealed by the decoder (packet loss concealment).
+	playoutConceal
+)
+
+type jitterBufferSlot struct {
+	filled         bool
+	sequenceNumber uint16
+	timestamp      uint32
+	payload        []byte
+}
+
+// An adaptive jitter buffer for the RTP packets received from a remote peer.
+//
+// Packets are pushed as they arrive (in any order), and popped once per packet duration
+// in sequence number order. The buffer holds back enough packets to absorb the variation
+// in packet arrival times (the jitter, estimated as in RFC 3550), so that late and reordered
+// packets are still played in order. Lost packets are reported to the caller, to be recovered
+// with forward error correction or concealed.
+//
+// The playout delay follows the measured jitter: it grows by concealing (rather than giving up on)
+// a late packet while the buffer holds less than the target delay, and shrinks by skipping a packet
+// whenever the buffer holds more than the target delay.
+type jitterBuffer struct {
+	mutex sync.Mutex
+
+	// The RTP clock rate, i.e. the units of the RTP timestamp per second
+	clockRate int
+
+	// Packets indexed by sequenceNumber % jitterBufferCapacity
+	slots [jitterBufferCapacity]jitterBufferSlot
+
+	// Whether packets are being played. If not, the buffer is filling up to the target delay.
+	playing bool
+	// The sequence number of the next packet to play
+	nextSequenceNumber uint16
+	// The highest sequence number received since the buffer was last empty
+	highestSequenceNumber uint16
+	// The number of packets buffered
+	buffered int
+	// The number of packet durations concealed in a row while waiting for a late packet
+	consecutiveConcealments int
+
+	// The duration of audio in each packet, measured from the RTP timestamps
+	packetDuration time.Duration
+	// The interarrival jitter estimate (RFC 3550, Section 6.4.1), in seconds
+	jitter float64
+	// The relative transit time of the previous packet, in seconds
+	lastTransit    float64
+	hasLastTransit bool
+	// The arrival time of the first packet, which all transit times are measured relative to
+	epoch time.Time
+}
+
+func newJitterBuffer(clockRate int) *jitterBuffer {
+	return &jitterBuffer{
+		clockRate:      clockRate,
+		packetDuration: jitterBufferDefaultPacketDuration,
+	}
+}
+
+// The distance from sequence number b to sequence number a, accounting for wraparound.
+func sequenceNumberDistance(a uint16, b uint16) int {
+	return int(int16(a - b))
+}
+
+// Add a packet received at the given time to the buffer.
+// The payload is held by the buffer until popped, so must not be reused by the caller.
+//
+// Packets arriving after their turn to be played has passed are discarded.
+func (jb *jitterBuffer) push(sequenceNumber uint16, timestamp uint32, payload []byte, arrival time.Time) {
+	jb.mutex.Lock()
+	defer jb.mutex.Unlock()
+
+	jb.updateJitter(timestamp, arrival)
+
+	if jb.playing || jb.buffered > 0 {
+		distance := sequenceNumberDistance(sequenceNumber, jb.nextSequenceNumber)
+		if jb.playing && distance < 0 {
+			// Too late, this packet has already been recovered or concealed
+			return
+		}
+		if distance >= jitterBufferCapacity || distance <= -jitterBufferCapacity {
+			// So far from the expected sequence number that the remote has likely restarted its stream
+			jb.reset()
+		}
+	}
+	if !jb.playing && (jb.buffered == 0 || sequenceNumberDistance(sequenceNumber, jb.nextSequenceNumber) < 0) {
+		// While filling, playout starts from the earliest packet received
+		jb.nextSequenceNumber = sequenceNumber
+	}
+
+	slot := &jb.slots[sequenceNumber%jitterBufferCapacity]
+	if slot.filled && slot.sequenceNumber == sequenceNumber {
+		// Duplicate packet
+		return
+	}
+	if !slot.filled {
+		jb.buffered += 1
+	}
+
+	// Measure the packet duration from consecutive packets. Longer gaps than any single packet
+	// may hold are pauses in the stream (e.g. discontinuous transmission), and are not measured.
+	previous := &jb.slots[(sequenceNumber-1)%jitterBufferCapacity]
+	if previous.filled && previous.sequenceNumber == sequenceNumber-1 && timestamp != previous.timestamp {
+		packetDuration := time.Duration(timestamp-previous.timestamp) * time.Second / time.Duration(jb.clockRate)
+		if packetDuration <= jitterBufferMaxPacketDuration {
+			jb.packetDuration = packetDuration
+		}
+	}
+
+	*slot = jitterBufferSlot{
+		filled:         true,
+		sequenceNumber: sequenceNumber,
+		timestamp:      timestamp,
+		payload:        payload,
+	}
+	if jb.buffered == 1 || sequenceNumberDistance(sequenceNumber, jb.highestSequenceNumber) > 0 {
+		jb.highestSequenceNumber = sequenceNumber
+	}
+}
+
+// Update the interarrival jitter estimate with a packet of the given timestamp arriving now.
+func (jb *jitterBuffer) updateJitter(timestamp uint32, arrival time.Time) {
+	if jb.epoch.IsZero() {
+		jb.epoch = arrival
+	}
+	transit := arrival.Sub(jb.epoch).Seconds() - float64(timestamp)/float64(jb.clockRate)
+	if jb.hasLastTransit {
+		d := transit - jb.lastTransit
+		if d < 0 {
+			d = -d
+		}
+		jb.jitter += (d - jb.jitter) / 16
+	}
+	jb.lastTransit = transit
+	jb.hasLastTransit = true
+}
+
+// The delay the buffer aims to hold before playing, following the measured jitter.
+func (jb *jitterBuffer) targetDelay() time.Duration {
+	delay := jb.packetDuration + time.Duration(jitterBufferJitterMultiplier*jb.jitter*float64(time.Second))
+	return min(max(delay, jitterBufferMinDelay), jitterBufferMaxDelay)
+}
+
+// The duration of audio buffered, from the next packet to play up to the latest packet received.
+func (jb *jitterBuffer) bufferedDelay() time.Duration {
+	if jb.buffered == 0 {
+		return 0
+	}
+	packets := sequenceNumberDistance(jb.highestSequenceNumber, jb.nextSequenceNumber) + 1
+	return time.Duration(packets) * jb.packetDuration
+}
+
+// Discard every packet, and wait to fill up to the target delay again.
+func (jb *jitterBuffer) reset() {
+	for i := range jb.slots {
+		jb.slots[i] = jitterBufferSlot{}
+	}
+	jb.buffered = 0
+	jb.playing = false
+	jb.consecutiveConcealments = 0
+}
+
+// Take the packet with the given sequence number out of the buffer, if present.
+func (jb *jitterBuffer) take(sequenceNumber uint16) ([]byte, bool) {
+	slot := &jb.slots[sequenceNumber%jitterBufferCapacity]
+	if !slot.filled || slot.sequenceNumber != sequenceNumber {
+		return nil, false
+	}
+	payload := slot.payload
+	*slot = jitterBufferSlot{}
+	jb.buffered -= 1
+	return payload, true
+}
+
+// The payload of the packet with the given sequence number, if present, leaving it in the buffer.
+func (jb *jitterBuffer) peek(sequenceNumber uint16) ([]byte, bool) {
+	slot := &jb.slots[sequenceNumber%jitterBufferCapacity]
+	if !slot.filled || slot.sequenceNumber != sequenceNumber {
+		return nil, false
+	}
+	return slot.payload, true
+}
+
+// Decide what to play for the next packet duration. Should be called once per packetDuration.
+//
+// For playoutPacket, the returned payload is the packet to decode.
+// For playoutFEC, the returned payload is the packet *after* the lost packet, holding its FEC data.
+// That packet stays in the buffer, and is played normally on the next pop.
+func (jb *jitterBuffer) pop() (playoutAction, []byte) {
+	jb.mutex.Lock()
+	defer jb.mutex.Unlock()
+
+	if !jb.playing {
+		if jb.buffered == 0 || jb.bufferedDelay() < jb.targetDelay() {
+			return playoutWait, nil
+		}
+		jb.playing = true
+	}
+
+	// Too much audio is held back (e.g. the jitter has fallen), so skip a packet to reduce the delay
+	if jb.bufferedDelay() > jb.targetDelay()+2*jb.packetDuration {
+		jb.take(jb.nextSequenceNumber)
+		jb.nextSequenceNumber += 1
+	}
+
+	if payload, ok := jb.take(jb.nextSequenceNumber); ok {
+		jb.nextSequenceNumber += 1
+		jb.consecutiveConcealments = 0
+		return playoutPacket, payload
+	}
+
+	// The next packet is missing. While less than the target delay is buffered, it may just be late,
+	// so conceal this packet duration but keep waiting for it, growing the delay by one packet.
+	if jb.bufferedDelay() < jb.targetDelay() {
+		jb.consecutiveConcealments += 1
+		if jb.buffered == 0 && jb.consecutiveConcealments > jitterBufferMaxConsecutiveConcealments {
+			// Stop concealing, and refill the buffer (with a fresh target delay) before playing again
+			jb.reset()
+			return playoutWait, nil
+		}
+		return playoutConceal, nil
+	}
+
+	// Otherwise, the packet is lost. Recover it from the packet after it if possible, or conceal it.
+	lostSequenceNumber := jb.nextSequenceNumber
+	jb.nextSequenceNumber += 1
+	jb.consecutiveConcealments = 0
+	if payload, ok := jb.peek(lostSequenceNumber + 1); ok {
+		return playoutFEC, payload
+	}
+	return playoutConceal, nil
+}
+
+// The duration of audio in each packet.
+func (jb *jitterBuffer) getPacketDuration() time.Duration {
+	jb.mutex.Lock()
+	defer jb.mutex.Unlock()
+	return jb.packetDuration
+}
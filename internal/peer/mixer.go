@@ -0,0 +1,321 @@
+package peer
+
+import (
+	"log/slog"
+	"sync"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice/device"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+// The number of participants a Mixer mixes at once by default, i.e. the loudest few (see Mixer.SetMaxActiveSpeakers).
+const DEFAULT_MIXER_MAX_ACTIVE_SPEAKERS int = 3
+
+// A Mixer is the mixing unit (MCU) of a room, run by a designated node that every participant connects to.
+//
+// Like a Forwarder, every participant holds a single connection (to the mixing node), sending its audio once, and
+// hears every other participant (or the loudest few, see SetMaxActiveSpeakers). Unlike a Forwarder, which sends each
+// speaker on a track of its own, the Mixer decodes the audio of each participant, mixes it, and encodes the mix.
+// So a client downloads and decodes exactly one stream, however large the room, at the cost of the CPU of the mixing node.
+//
+// Each participant hears the mix of every participant but itself (its mix-minus). The participants are mixed once,
+// by a FanInDevice (see FanInDevice.RenderMixMinus), and each participant that was mixed (i.e. a speaker) has its own
+// contribution removed, and its mix-minus encoded by its own encoder. Every other participant (i.e. a listener) hears
+// the full mix, which is encoded once for every listener with the same codec and encoder settings (see EncoderGroupKey),
+// so the cost of encoding grows with the number of speakers, rather than with the size of the room.
+//
+// Peers join a Mixer with Join. A peer in a Mixer should not also be given a stream with SetStream,
+// nor join an EncoderGroup or a Forwarder, as the Mixer writes to its audio track, and reads its stream.
+type Mixer struct {
+	logger *slog.Logger
+
+	deviceProperties audiodevice.DeviceProperties
+	frameDuration    time.Duration
+	fanIn            *device.FanInDevice
+
+	// Guards participants and fullMixEncoders
+	mutex        sync.Mutex
+	participants []*mixerParticipant
+	// The encoder of the full mix, for each EncoderGroupKey of the current participants
+	fullMixEncoders map[EncoderGroupKey]*mixerEncoder
+
+	// Only used by the mixing goroutine, and reused for every frame:
+	// the participants as of the current frame (copied, so the mix is encoded and sent without holding mutex),
+	// the full-mix encoders with a listener in the current frame, and the packets encoded from the current frame.
+	mixParticipants  []*mixerParticipant
+	listenedEncoders []*mixerEncoder
+	packets          []*encoderdecoder.EncodedPacket
+}
+
+// A participant of a Mixer, and what it takes to send it its mix.
+type mixerParticipant struct {
+	peer     *Peer
+	key      EncoderGroupKey
+	mixMinus *device.MixMinus
+	// Encodes the mix-minus of the participant, whenever it is a speaker
+	encoder *encoderdecoder.OpusEncoder
+	// Encodes the full mix for the participant, whenever it is not a speaker
+	fullMixEncoder *mixerEncoder
+	// Converts the mix-minus of the participant from the format of the Mixer to the negotiated codec
+	outputPipeline *device.Pipeline
+}
+
+// Encodes the full mix, once, for every participant with the same EncoderGroupKey that did not contribute to it.
+type mixerEncoder struct {
+	encoder *encoderdecoder.OpusEncoder
+	// Converts the full mix from the format of the Mixer to the codec of the key
+	outputPipeline *device.Pipeline
+	// The number of participants with the key. The encoder is closed once the last leaves. Guarded by Mixer.mutex.
+	numParticipants int
+	// The participants hearing the full mix of the current frame. Only used by the mixing goroutine.
+	listeners []*Peer
+}
+
+// Create a new, empty, Mixer, mixing audio in the given format, one frame of the given duration at a time.
+//
+// Each participant is converted to the format of the Mixer before mixing, and the mix is converted
+// to the negotiated codec of each participant before encoding.
+func NewMixer(deviceProperties audiodevice.DeviceProperties, frameDuration time.Duration) *Mixer {
+	m := &Mixer{
+		logger:           slog.Default().With("mixer", deviceProperties),
+		deviceProperties: deviceProperties,
+		frameDuration:    frameDuration,
+		fanIn:            device.NewFanInDevice(deviceProperties, frameDuration),
+		participants:     make([]*mixerParticipant, 0),
+		fullMixEncoders:  make(map[EncoderGroupKey]*mixerEncoder),
+	}
+	m.fanIn.SetMaxActiveSources(DEFAULT_MIXER_MAX_ACTIVE_SPEAKERS)
+	go m.run()
+	return m
+}
+
+// Limit the mix to the n loudest participants. If n is 0, every participant is mixed.
+//
+// Every participant beyond the n loudest is still decoded (to measure its loudness), but is neither converted
+// nor mixed, and hears the full mix, so the number of encoders in use is at most n plus the number of codecs.
+func (m *Mixer) SetMaxActiveSpeakers(n int) {
+	m.fanIn.SetMaxActiveSources(n)
+}
+
+// Add the given peer to the room. The audio the peer sends is mixed for the other participants,
+// and the peer receives the mix of the other participants. The peer leaves the room when it is closed.
+func (m *Mixer) Join(peer *Peer) error {
+	if peer.connectionAudioInputTrack == nil {
+		return errNoAudioInputTrack
+	}
+	key := EncoderGroupKey{
+		deviceProperties: peer.GetDeviceProperties(),
+		opusFactory:      peer.opusFactory,
+	}
+
+	encoder, err := peer.getAudioEncoder()
+	if err != nil {
+		return err
+	}
+
+	// The full mix encoder is held before the peer leaves its old mixer, so a peer that cannot join stays where it was,
+	// and a peer joining the same mixer again does not close the encoder it keeps using.
+	fullMixEncoder, err := m.acquireFullMixEncoder(key)
+	if err != nil {
+		return err
+	}
+
+	if oldMixer := peer.mixer.Swap(m); oldMixer != nil {
+		oldMixer.leave(peer)
+	}
+
+	m.mutex.Lock()
+	defer m.mutex.Unlock()
+
+	// The loudness of the participant is measured before conversion, so a participant that is not mixed costs only its decoding.
+	// The source leaves the FanInDevice by itself once the peer is closed, as the stream of the peer is closed.
+	activity := device.NewSourceActivity()
+	inputPipelineDevice := device.NewPipelineDevice(
+		device.NewPipelineBuilder(key.deviceProperties).
+			MeasureActivity(activity).
+			ConvertFormat(m.deviceProperties).
+			Build(),
+	)
+	inputPipelineDevice.SetStream(peer.GetStream())
+
+	m.participants = append(m.participants, &mixerParticipant{
+		peer:           peer,
+		key:            key,
+		mixMinus:       m.fanIn.ConnectMixMinus(inputPipelineDevice, activity),
+		encoder:        encoder,
+		fullMixEncoder: fullMixEncoder,
+		outputPipeline: device.NewPipelineBuilder(m.deviceProperties).ConvertFormat(key.deviceProperties).Build(),
+	})
+	peer.logger.Info("peer joined mixer", "numParticipants", len(m.participants))
+	return nil
+}
+
+// Get the encoder of the full mix for the given key, creating it if no participant uses it yet,
+// and count one more participant using it.
+func (m *Mixer) acquireFullMixEncoder(key EncoderGroupKey) (*mixerEncoder, error) {
+	m.mutex.Lock()
+	defer m.mutex.Unlock()
+
+	fullMixEncoder, ok := m.fullMixEncoders[key]
+	if !ok {
+		encoder, err := key.opusFactory.NewOpusEncoder(
+			key.deviceProperties.SampleRate,
+			key.deviceProperties.NumChannels,
+		)
+		if err != nil {
+			return nil, err
+		}
+		fullMixEncoder = &mixerEncoder{
+			encoder:        encoder,
+			outputPipeline: device.NewPipelineBuilder(m.deviceProperties).ConvertFormat(key.deviceProperties).Build(),
+		}
+		m.fullMixEncoders[key] = fullMixEncoder
+	}
+	fullMixEncoder.numParticipants += 1
+	return fullMixEncoder, nil
+}
+
+// Add every peer arriving on the given channel (e.g. ConnectionManager.ConnectedPeerChannel) to the room,
+// until the channel is closed. Peers that cannot join are closed.
+func (m *Mixer) Serve(peers <-chan *Peer) {
+	for peer := range peers {
+		if err := m.Join(peer); err != nil {
+			peer.logger.Error("failed to join mixer", "err", err)
+			peer.Close()
+		}
+	}
+}
+
+// The number of participants currently in the room.
+func (m *Mixer) NumParticipants() int {
+	m.mutex.Lock()
+	defer m.mutex.Unlock()
+	return len(m.participants)
+}
+
+// Stop mixing. The participants are not closed, but no longer receive audio.
+//
+// This function is idempotent.
+func (m *Mixer) Close() {
+	m.fanIn.Close()
+}
+
+func (m *Mixer) leave(peer *Peer) {
+	m.mutex.Lock()
+	defer m.mutex.Unlock()
+	for i, participant := range m.participants {
+		if participant.peer != peer {
+			continue
+		}
+		m.participants = append(m.participants[:i], m.participants[i+1:]...)
+
+		participant.fullMixEncoder.numParticipants -= 1
+		if participant.fullMixEncoder.numParticipants == 0 {
+			// The mixing goroutine may still be encoding the current frame with it, which a closed encoder allows
+			delete(m.fullMixEncoders, participant.key)
+			participant.fullMixEncoder.encoder.Close()
+		}
+		return
+	}
+}
+
+// Mix one frame of every participant at a time, and send each participant its mix, until the Mixer is closed.
+func (m *Mixer) run() {
+	frameLength := m.deviceProperties.SampleRate * m.deviceProperties.NumChannels * int(m.frameDuration) / int(time.Second)
+	total := make(frame.PCMFrame, frameLength)
+
+	ticker := time.NewTicker(m.frameDuration)
+	defer ticker.Stop()
+	defer func() {
+		m.mutex.Lock()
+		defer m.mutex.Unlock()
+		for _, fullMixEncoder := range m.fullMixEncoders {
+			fullMixEncoder.encoder.Close()
+		}
+	}()
+	for range ticker.C {
+		if !m.fanIn.RenderMixMinus(total) {
+			return
+		}
+		m.mix(total)
+	}
+}
+
+// Send each participant its mix of the frame just rendered into total: speakers their own mix-minus,
+// and listeners the full mix, encoded once per EncoderGroupKey.
+func (m *Mixer) mix(total frame.PCMFrame) {
+	// Participants joining or leaving wait only for the copy, not for the mix to be encoded and sent
+	m.mutex.Lock()
+	m.mixParticipants = append(m.mixParticipants, m.participants...)
+	m.mutex.Unlock()
+
+	now := time.Now()
+	for _, participant := range m.mixParticipants {
+		if participant.peer.ctx.Err() != nil {
+			continue
+		}
+		if !participant.mixMinus.Contributed() {
+			fullMixEncoder := participant.fullMixEncoder
+			if len(fullMixEncoder.listeners) == 0 {
+				m.listenedEncoders = append(m.listenedEncoders, fullMixEncoder)
+			}
+			fullMixEncoder.listeners = append(fullMixEncoder.listeners, participant.peer)
+			continue
+		}
+
+		mixMinusFrame := frame.GetPooledPCMFrame(len(total))
+		participant.mixMinus.Render(total, mixMinusFrame.Samples())
+		m.send(participant.outputPipeline, participant.encoder, mixMinusFrame, now, participant.peer)
+	}
+
+	for _, fullMixEncoder := range m.listenedEncoders {
+		fullMixFrame := frame.GetPooledPCMFrame(len(total))
+		copy(fullMixFrame.Samples(), total)
+		frame.Clip(fullMixFrame.Samples())
+		m.send(fullMixEncoder.outputPipeline, fullMixEncoder.encoder, fullMixFrame, now, fullMixEncoder.listeners...)
+
+		clear(fullMixEncoder.listeners)
+		fullMixEncoder.listeners = fullMixEncoder.listeners[:0]
+	}
+
+	clear(m.listenedEncoders)
+	m.listenedEncoders = m.listenedEncoders[:0]
+	clear(m.mixParticipants)
+	m.mixParticipants = m.mixParticipants[:0]
+}
+
+// Convert the given frame with the given pipeline, encode it with the given encoder (on its worker, if it has one),
+// and write each packet to the audio track of every given peer once encoded. Takes ownership of the given frame.
+func (m *Mixer) send(
+	outputPipeline *device.Pipeline,
+	encoder *encoderdecoder.OpusEncoder,
+	pcmFrame *frame.PooledPCMFrame,
+	now time.Time,
+	peers ...*Peer,
+) {
+	var batch [1]*frame.PooledPCMFrame
+	batch[0] = pcmFrame
+	if outputPipeline.Process(batch[:], batch[:]) == 0 {
+		return
+	}
+	pcmFrame = batch[0]
+	defer pcmFrame.Release()
+
+	// The level of the mix is measured once, and sent with every packet, to every peer
+	level := measureAudioLevel(pcmFrame.Samples())
+	var err error
+	encoder.Run(func() {
+		err = encoder.Encode(pcmFrame.Samples(), func(packet *encoderdecoder.EncodedPacket) {
+			m.packets = append(m.packets, packet)
+		})
+	})
+	if err != nil {
+		m.logger.Error("error while encoding mix", "numPeers", len(peers), "err", err)
+	}
+	writeEncodedPackets(m.packets, level, peers...)
+	clear(m.packets)
+	m.packets = m.packets[:0]
+}
@@ -1,17 +1,27 @@
 package peer
 
 import (
+	"errors"
 	"io"
+	"slices"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice/device"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+	"github.com/pion/sdp/v3"
 	"github.com/pion/webrtc/v4"
-	"github.com/pion/webrtc/v4/pkg/media"
 )
 
+// The audio level of a remote peer is forgotten (i.e. it is silent) if no packet has arrived for this long,
+// e.g. as its silence is suppressed.
+const remoteAudioLevelTimeout = 500 * time.Millisecond
+
+var errPeerClosed error = errors.New("peer is closed")
+
 // The logical representation of a connected peer across the network.
 //
 // This struct is a wrapper peerCore (handling the actual connection) and
@@ -34,18 +44,64 @@ type Peer struct {
 	// Audio data from this client is passed in on this channel to be sent to remote peers.
 	// This field is the source into this peer. When working with this attribute, model the
 	// peer as an AudioSinkDevice, i.e. something that consumes data coming on the audioSourceChannel.
-	audioSourceChannel <-chan frame.PCMFrame
+	audioSourceChannel <-chan *frame.PooledPCMFrame
 
 	// Audio data from remote peers is passed along this channel to be played on the audio output device.
 	// This field is the sink out of this peer. When working with this attribute, model the
 	// peer as an AudioSourceDevice, i.e. something that produces data on the audioSinkChannel.
-	audioSinkChannel chan frame.PCMFrame
+	audioSinkChannel chan *frame.PooledPCMFrame
+
+	// If the peer receives audio on more than one track (see PeerFactory.SetNumAudioTracks), the tracks are mixed here,
+	// and the stream of the peer is that of the mix, rather than the audioSinkChannel. Nil otherwise.
+	audioOutputMix *device.FanInDevice
 
-	// audioSourceChannel waitgroup, to ensure the receiveAudioSourceHandler go routine finishes
+	// audioSinkChannel waitgroup, to ensure the receiveAudioOutputHandler go routines finish
 	audioSinkChannelWaitGroup sync.WaitGroup
 
-	// Audio encoder / decoder to be used for this connection only
-	audioEncoderDecoder *encoderdecoder.OpusEncoderDecoder
+	// Audio encoder to be used for this connection only, encoding audio from the audioSourceChannel
+	// (or the mix-minus of a Mixer). Nil until first used (see getAudioEncoder), so a peer in an
+	// EncoderGroup, which never encodes audio itself, holds no encoder, nor a place on a codec worker.
+	audioEncoder atomic.Pointer[encoderdecoder.OpusEncoder]
+	// Serializes creating and closing audioEncoder
+	audioEncoderMutex sync.Mutex
+	// Set once the peer is closed, after which no audioEncoder is created
+	audioEncoderClosed bool
+
+	// The audio received on each track of the remote peer, decoding it for the audioSinkChannel (or the audioOutputMix).
+	// Copy-on-write: a track arriving swaps in a new list (under audioOutputMutex), so the list is read without locking.
+	audioReceivers atomic.Pointer[[]*audioReceiver]
+
+	// The factory audioEncoder and the decoder of each audioReceiver were made with, i.e. the encoder settings of this peer
+	opusFactory encoderdecoder.OpusFactory
+
+	// Writes encoded audio to the connectionAudioInputTrack, whether encoded by this peer or its EncoderGroup
+	audioTrackWriter *audioTrackWriter
+	// Writes the speakers a Forwarder forwards to the connectionForwardingTracks the remote peer accepted, one speaker to each
+	forwardingTrackWriters []*audioTrackWriter
+
+	// The EncoderGroup encoding audio for this peer, if it joined one (see EncoderGroups.Join).
+	// If set, audio is sent by the group, rather than from the stream given to SetStream.
+	encoderGroup atomic.Pointer[EncoderGroup]
+
+	// The Forwarder this peer joined, if any (see Forwarder.Join).
+	// If set, audio received from the remote peer is forwarded to the other participants of the Forwarder, rather than decoded.
+	forwarder atomic.Pointer[Forwarder]
+
+	// The Mixer this peer joined, if any (see Mixer.Join).
+	// If set, the audio of this peer is mixed for the other participants of the Mixer, and the mix of the others is sent to it.
+	mixer atomic.Pointer[Mixer]
+
+	// Adapts the encoder settings to the network, from the RTCP feedback of the remote peer.
+	// Only used by the receiveRTCPHandler goroutine.
+	bitrateController *bitrateController
+	// The latest encoder settings chosen by the bitrateController, if any
+	targetEncoderSettings atomic.Pointer[encoderdecoder.OpusEncoderSettings]
+	// The latest frame duration chosen by the bitrateController, or 0 if none
+	targetFrameDuration atomic.Int64
+
+	// Whether the audio of the remote peer is inaudible to this client (see SetMuted),
+	// in which case packets are still received, but not decoded.
+	muted atomic.Bool
 }
 
 // --------------------------------------------------------------------------------
@@ -53,7 +109,10 @@ type Peer struct {
 
 // Set the audioSinkChannel of this peer. Data sent on the channel will be consumed by this device.
 // The given channel should produce raw PCM frames from this clients audio input device (e.g. microphone)
-func (peer *Peer) SetStream(sourceChannel <-chan frame.PCMFrame) {
+//
+// When sending the same audio to many peers, prefer joining an EncoderGroup (see EncoderGroups.Join)
+// which encodes the audio once for every peer with the same codec.
+func (peer *Peer) SetStream(sourceChannel <-chan *frame.PooledPCMFrame) {
 	peer.audioSourceChannel = sourceChannel
 	peer.sendAudioInputHandler()
 }
@@ -67,15 +126,135 @@ func (peer *Peer) SetStream(sourceChannel <-chan frame.PCMFrame) {
 func (peer *Peer) Close() {
 	peer.shutdownOnce.Do(func() {
 		peer.ctxCancelFunc()
+		if group := peer.encoderGroup.Swap(nil); group != nil {
+			group.groups.leave(group, peer)
+		}
+		if forwarder := peer.forwarder.Swap(nil); forwarder != nil {
+			forwarder.leave(peer)
+		}
+		if mixer := peer.mixer.Swap(nil); mixer != nil {
+			mixer.leave(peer)
+		}
 		peer.connection.Close()
+		// Once the context is canceled, no track starts being received, so the wait group is only waited on from here
+		peer.audioOutputMutex.Lock()
+		peer.audioOutputMutex.Unlock()
 		peer.audioSinkChannelWaitGroup.Wait()
+		peer.closeAudioEncoder()
 
-		if peer.audioSinkChannel != nil {
+		for _, receiver := range *peer.audioReceivers.Load() {
+			receiver.decoder.Close()
+			if peer.audioOutputMix != nil {
+				close(receiver.sink)
+			}
+		}
+		if peer.audioOutputMix != nil {
+			peer.audioOutputMix.Close()
+		} else if peer.audioSinkChannel != nil {
 			close(peer.audioSinkChannel)
 		}
 	})
 }
 
+// Set whether the audio of the remote peer is inaudible to this client (e.g. its volume is zero).
+//
+// While muted, packets are still received and pass through the jitter buffer, so the timing of the
+// stream is kept, but they are not decoded, and no audio is sent along the audioSinkChannel.
+// So everything downstream (conversion, mixing) also does no work for this peer.
+// On unmuting, decoding resumes from a fresh decoder state.
+func (peer *Peer) SetMuted(muted bool) {
+	peer.muted.Store(muted)
+}
+
+// Whether the audio of the remote peer is inaudible to this client. See SetMuted.
+func (peer *Peer) IsMuted() bool {
+	return peer.muted.Load()
+}
+
+// The audio level of the remote peer, i.e. of the latest packet received from it.
+//
+// The level is read from the header of each packet as it arrives, before it is decoded, so the remote peers can be
+// ranked by loudness (e.g. to pick the active speakers) without decoding their audio, even while muted.
+// The level is silent if the remote peer does not send its audio level, or has sent no audio recently.
+//
+// If the remote peer sends audio on several tracks (e.g. a Forwarder, sending each speaker on its own),
+// the level is that of the latest packet of every track mixed together.
+func (peer *Peer) AudioLevel() AudioLevel {
+	level := silentAudioLevel
+	now := time.Now()
+	for _, receiver := range *peer.audioReceivers.Load() {
+		level = level.mix(receiver.audioLevel(now))
+	}
+	return level
+}
+
+// The settings of the encoder of this peer, or those it starts with, if it has not encoded yet.
+func (peer *Peer) GetEncoderSettings() encoderdecoder.OpusEncoderSettings {
+	if encoder := peer.audioEncoder.Load(); encoder != nil {
+		return encoder.GetEncoderSettings()
+	}
+	if target := peer.targetEncoderSettings.Load(); target != nil {
+		return *target
+	}
+	return peer.opusFactory.GetEncoderSettings()
+}
+
+// Change the settings of the encoder of this peer (e.g. its bitrate, or FEC) at runtime.
+//
+// A peer in an EncoderGroup has its audio encoded by the group, shared with other peers,
+// so see EncoderGroup.SetEncoderSettings instead.
+func (peer *Peer) SetEncoderSettings(encoderSettings encoderdecoder.OpusEncoderSettings) error {
+	encoder, err := peer.getAudioEncoder()
+	if err != nil {
+		return err
+	}
+	return encoder.SetEncoderSettings(encoderSettings)
+}
+
+// The encoder of this peer, created on first use, starting from the latest target of the bitrateController.
+func (peer *Peer) getAudioEncoder() (*encoderdecoder.OpusEncoder, error) {
+	if encoder := peer.audioEncoder.Load(); encoder != nil {
+		return encoder, nil
+	}
+
+	peer.audioEncoderMutex.Lock()
+	defer peer.audioEncoderMutex.Unlock()
+	if encoder := peer.audioEncoder.Load(); encoder != nil {
+		return encoder, nil
+	}
+	if peer.audioEncoderClosed {
+		return nil, errPeerClosed
+	}
+
+	deviceProperties := peer.GetDeviceProperties()
+	encoder, err := peer.opusFactory.NewOpusEncoder(deviceProperties.SampleRate, deviceProperties.NumChannels)
+	if err != nil {
+		return nil, err
+	}
+	if target := peer.targetEncoderSettings.Load(); target != nil {
+		if err := encoder.SetEncoderSettings(*target); err != nil {
+			peer.logger.Error("error while adapting encoder settings", "err", err)
+		}
+	}
+	if frameDuration := time.Duration(peer.targetFrameDuration.Load()); frameDuration != 0 {
+		if err := encoder.SetFrameDuration(frameDuration); err != nil {
+			peer.logger.Error("error while adapting encoder frame duration", "err", err)
+		}
+	}
+	peer.audioEncoder.Store(encoder)
+	return encoder, nil
+}
+
+// Close the encoder of this peer, if it has one, and create none from now on.
+func (peer *Peer) closeAudioEncoder() {
+	peer.audioEncoderMutex.Lock()
+	defer peer.audioEncoderMutex.Unlock()
+	peer.audioEncoderClosed = true
+	if encoder := peer.audioEncoder.Load(); encoder != nil {
+		encoder.Close()
+	}
+}
+
 // The DeviceProperties of a Peer define both the source and sink properties.
 // That is, the audio properties being sent to the peer (to be forwarded across the network)
 // match the audio properties being received by the peer.
@@ -96,9 +275,13 @@ func (peer *Peer) GetDeviceProperties() audiodevice.DeviceProperties {
 
 // Get the audioSourceChannel of this peer.
 // The returned channel produces raw PCM Frames from the remote peer.
+// If the remote peer sends audio on several tracks, the frames are the mix of every track.
 //
 // When this peer is shutdown, the given channel is closed (hence, no data is to be sent on it anymore)
-func (peer *Peer) GetStream() <-chan frame.PCMFrame {
+func (peer *Peer) GetStream() <-chan *frame.PooledPCMFrame {
+	if peer.audioOutputMix != nil {
+		return peer.audioOutputMix.GetStream()
+	}
 	return peer.audioSinkChannel
 }
 
@@ -132,38 +315,126 @@ func (peer *Peer) onConnectionStateChangeHandler(pcs webrtc.PeerConnectionState)
 	}
 }
 
-// OnTrack handler
-// Handle initialization of a new track, offered by the remote peer.
-// Should start listening for packets from the remote peer, decoding them, and streaming them out.
-//
-// This handler shadows the peerCore handler, but includes the connectionAudioOutputTrack call
-// If, when a Peer is constructed by wrapping a peerCore, the connectionAudioOutputTrack is already set,
-// this function is not attached. Instead, connectionAudioOutputTrack is called directly (see PeerFactory.wrapPeerCore)
-func (peer *Peer) onTrackHandler(tr *webrtc.TrackRemote, r *webrtc.RTPReceiver) {
-	if peer.connectionAudioOutputTrack != nil {
-		peer.logger.Debug(
-			"received track but connectionAudioOutputTrack already exists",
-			"track ID", tr.ID(),
-			"track kind", tr.Kind().String(),
-		)
-		return
+// Receive audio on every track of the remote peer: those that arrived before the peer was wrapped, and those yet to arrive.
+func (peer *Peer) receiveAudioOutputTracks() {
+	peer.audioOutputMutex.Lock()
+	defer peer.audioOutputMutex.Unlock()
+	peer.onAudioOutputTrack = peer.receiveAudioOutputTrack
+	for _, audioOutputTrack := range peer.connectionAudioOutputTracks {
+		peer.receiveAudioOutputTrack(audioOutputTrack)
 	}
+}
 
-	peer.logger.Debug(
-		"received track",
-		"track ID", tr.ID(),
-		"track kind", tr.Kind().String(),
+// Start receiving audio on the given track of the remote peer, with a decoder of its own.
+// Only the first track is received, unless the tracks are mixed (see audioOutputMix).
+// Must be called with audioOutputMutex held.
+func (peer *Peer) receiveAudioOutputTrack(audioOutputTrack remoteAudioTrack) {
+	logger := peer.logger.With(
+		"track ID", audioOutputTrack.track.ID(),
+		"track kind", audioOutputTrack.track.Kind().String(),
 	)
+	if peer.ctx.Err() != nil {
+		return
+	}
+	receivers := *peer.audioReceivers.Load()
+	if peer.audioOutputMix == nil && len(receivers) > 0 {
+		logger.Debug("received track but an audio track is already received")
+		return
+	}
+
+	codec := audioOutputTrack.track.Codec()
+	decoder, err := peer.opusFactory.NewOpusDecoder(int(codec.ClockRate), int(codec.Channels))
+	if err != nil {
+		logger.Error("error during creation of audio decoder", "negotiatedCodec", codec, "err", err)
+		return
+	}
+	receiver := &audioReceiver{
+		remoteAudioTrack: audioOutputTrack,
+		decoder:          decoder,
+		sink:             peer.audioSinkChannel,
+	}
+	if peer.audioOutputMix != nil {
+		receiver.sink = make(chan *frame.PooledPCMFrame)
+		peer.audioOutputMix.SetStream(receiver.sink)
+	}
+	logger.Debug("receiving track", "numTracks", len(receivers)+1)
 
-	peer.connectionAudioOutputTrack = tr
-	peer.receiveAudioOutputHandler()
+	receivers = append(slices.Clone(receivers), receiver)
+	peer.audioReceivers.Store(&receivers)
+	peer.receiveAudioOutputHandler(receiver)
+}
+
+// Handle the RTCP feedback sent by the remote peer about the audio it receives from this client
+// (receiver reports and transport-wide congestion control feedback), adapting the encoder to it.
+//
+// The encoder of this peer is adapted directly. If the peer is in an EncoderGroup, the group's
+// shared encoder is adapted to the most constrained of its peers (see EncoderGroup.adaptEncoderSettings),
+// so that a peer on a poor network degrades the audio of its group rather than building a queue.
+//
+// This goroutine dies when the connection is closed, which occurs in the peer.Close method.
+func (peer *Peer) receiveRTCPHandler() {
+	if peer.connectionAudioInputSender == nil {
+		return
+	}
+	go func() {
+		for {
+			packets, _, err := peer.connectionAudioInputSender.ReadRTCP()
+			if err != nil {
+				return
+			}
+
+			encoderSettings, changed := peer.bitrateController.handleRTCP(packets, time.Now())
+			if !changed {
+				continue
+			}
+			frameDuration := peer.bitrateController.getFrameDuration()
+			peer.logger.Debug(
+				"adapting encoder to network",
+				"bitrate", encoderSettings.Bitrate,
+				"packetLossPercentage", encoderSettings.PacketLossPercentage,
+				"inBandFEC", encoderSettings.InBandFEC,
+				"frameDuration", frameDuration,
+			)
+			peer.targetEncoderSettings.Store(&encoderSettings)
+			peer.targetFrameDuration.Store(int64(frameDuration))
+
+			if group := peer.encoderGroup.Load(); group != nil {
+				group.adaptEncoderSettings()
+				continue
+			}
+			// An encoder not yet created starts from the targets. Loaded under the lock, so an encoder
+			// being created either sees the targets just stored, or is adapted here.
+			peer.audioEncoderMutex.Lock()
+			encoder := peer.audioEncoder.Load()
+			peer.audioEncoderMutex.Unlock()
+			if encoder == nil {
+				continue
+			}
+			if err := encoder.SetEncoderSettings(encoderSettings); err != nil {
+				peer.logger.Error("error while adapting encoder settings", "err", err)
+			}
+			if frameDuration != encoder.GetFrameDuration() {
+				if err := encoder.SetFrameDuration(frameDuration); err != nil {
+					peer.logger.Error("error while adapting encoder frame duration", "err", err)
+				}
+			}
+		}
+	}()
 }
 
 // audioSinkTrack onOpen handler
 // Handle audio along the audioSinkChannel (e.g. from a microphone) by forwarding through the PeerConnection audio track.
 func (peer *Peer) sendAudioInputHandler() {
 	go func() {
+		audioEncoder, err := peer.getAudioEncoder()
+		if err != nil {
+			peer.logger.Error("error while creating audio encoder", "err", err)
+			return
+		}
+
 		frameIndex := 0
+		// The packets encoded from the current frame, reused for every frame
+		packets := make([]*encoderdecoder.EncodedPacket, 0)
 		for {
 			select {
 			case <-peer.ctx.Done():
@@ -173,46 +444,82 @@ func (peer *Peer) sendAudioInputHandler() {
 					return
 				}
 
-				// peer.logger.Debug(
-				// 	"new frame ready",
-				// 	"frameIndex", frameIndex,
-				// 	"pcmDataLen", len(pcmData),
-				// 	"duration", duration,
-				// )
-
-				encodedFrames, err := peer.audioEncoderDecoder.Encode(pcmData)
+				// Encoding runs on the worker of the encoder (if it has one), and the packets are written once it is done,
+				// so the worker never waits on the network. The level of the frame is measured once, and sent with each packet encoded from it.
+				level := measureAudioLevel(pcmData.Samples())
+				var err error
+				audioEncoder.Run(func() {
+					err = audioEncoder.Encode(pcmData.Samples(), func(packet *encoderdecoder.EncodedPacket) {
+						packets = append(packets, packet)
+					})
+				})
+				pcmDataLen := pcmData.Len()
+				// Encode copies the samples it needs, so the frame can be released immediately
+				pcmData.Release()
 				if err != nil {
 					peer.logger.Error(
 						"error while encoding pcm data",
 						"frameIndex", frameIndex,
-						"pcmDataLen", len(pcmData),
+						"pcmDataLen", pcmDataLen,
 						"err", err,
 					)
-					continue
 				}
 
-				for _, frame := range encodedFrames {
-					mediaSample := media.Sample{
-						Data:      frame,
-						Duration:  peer.audioEncoderDecoder.GetFrameDuration(),
-						Timestamp: time.Now(),
-					}
-
-					peer.connectionAudioInputTrack.WriteSample(mediaSample)
-					frameIndex += 1
-				}
+				frameIndex += len(packets)
+				writeEncodedPackets(packets, level, peer)
+				clear(packets)
+				packets = packets[:0]
 			}
 		}
 		// Once the audioInputChannel is closed or the context is canceled, this go routine will die
 	}()
 }
 
-// Handle audio being received by the peer and forward along audioOutputChannel.
+// The audio received on a single track of the remote peer, and what it takes to decode it.
+type audioReceiver struct {
+	remoteAudioTrack
+
+	decoder *encoderdecoder.OpusDecoder
+	// Where decoded frames are sent: the audioSinkChannel of the peer, or a source of its audioOutputMix
+	sink chan *frame.PooledPCMFrame
+
+	// The audio level of the latest packet received on the track (as AudioLevel.marshal),
+	// and when it arrived (as Unix nanoseconds), or 0 if none has arrived
+	level     atomic.Uint32
+	levelTime atomic.Int64
+}
+
+// The audio level of the latest packet received on the track, or silence if none has arrived recently.
+func (receiver *audioReceiver) audioLevel(now time.Time) AudioLevel {
+	receivedAt := receiver.levelTime.Load()
+	if receivedAt == 0 || now.Sub(time.Unix(0, receivedAt)) > remoteAudioLevelTimeout {
+		return silentAudioLevel
+	}
+	return unmarshalAudioLevel(byte(receiver.level.Load()))
+}
+
+// Handle audio being received by the peer on the track of the given receiver, and forward along its sink.
+//
+// Packets are received into a jitterBuffer as they arrive, and played out of it (decoded and sent on)
+// by a second goroutine, one packet duration at a time. Lost packets are recovered from the
+// forward error correction data of the following packet where possible, and concealed otherwise.
+//
+// The audio level of each packet (if the remote peer sends it) is read as it arrives, before decoding (see AudioLevel).
+// If the peer is in a Forwarder, packets are handed to the Forwarder as they arrive instead, and never decoded.
 //
 // When the context is canceled, this method returns gracefully as soon as the next packet arrives.
-func (peer *Peer) receiveAudioOutputHandler() {
+func (peer *Peer) receiveAudioOutputHandler(receiver *audioReceiver) {
+	jitterBuffer := newJitterBuffer(int(receiver.track.Codec().ClockRate))
+	var audioLevelExtensionID uint8
+	if receiver.receiver != nil {
+		audioLevelExtensionID = headerExtensionID(
+			receiver.receiver.GetParameters().HeaderExtensions,
+			sdp.AudioLevelURI,
+		)
+	}
+
 	peer.audioSinkChannelWaitGroup.Go(func() {
-		frameIndex := 0
+		packetIndex := 0
 		for {
 			select {
 			case <-peer.ctx.Done():
@@ -220,7 +527,7 @@ func (peer *Peer) receiveAudioOutputHandler() {
 			default:
 			}
 
-			pkt, _, err := peer.connectionAudioOutputTrack.ReadRTP()
+			pkt, _, err := receiver.track.ReadRTP()
 			if err != nil {
 				if err == io.EOF {
 					peer.logger.Debug("connection audio data track closed")
@@ -228,34 +535,113 @@ func (peer *Peer) receiveAudioOutputHandler() {
 				}
 				peer.logger.Error(
 					"error while receiving audio data from remote peer",
-					"frameIndex", frameIndex,
+					"packetIndex", packetIndex,
 					"err", err,
 				)
 				continue
 			}
 
-			decodedPayload, err := peer.audioEncoderDecoder.Decode(pkt.Payload)
+			receivedAt := time.Now()
+			level := silentAudioLevel
+			if audioLevelExtensionID != 0 {
+				if payload := pkt.GetExtension(audioLevelExtensionID); len(payload) > 0 {
+					level = unmarshalAudioLevel(payload[0])
+					receiver.level.Store(uint32(payload[0]))
+					receiver.levelTime.Store(receivedAt.UnixNano())
+				}
+			}
+
+			if forwarder := peer.forwarder.Load(); forwarder != nil {
+				forwarder.forward(peer, pkt.Payload, level, receivedAt)
+				packetIndex += 1
+				continue
+			}
+
+			// Each packet is read into a new buffer, so the payload can be held by the jitter buffer
+			jitterBuffer.push(pkt.SequenceNumber, pkt.Timestamp, pkt.Payload, receivedAt)
+			packetIndex += 1
+		}
+
+		// This goroutine dies when the given context is canceled, which occurs in the peer.Close method
+	})
+
+	peer.audioSinkChannelWaitGroup.Go(func() {
+		frameIndex := 0
+
+		// Decoding runs on the worker of the decoder (if it has one), decoding whatever the jitter buffer chose
+		var action playoutAction
+		var payload []byte
+		var packetDuration time.Duration
+		var decodedPayload *frame.PooledPCMFrame
+		var err error
+		decode := func() {
+			switch action {
+			case playoutPacket:
+				decodedPayload, err = receiver.decoder.Decode(payload)
+			case playoutFEC:
+				decodedPayload, err = receiver.decoder.DecodeFEC(payload, packetDuration)
+			case playoutConceal:
+				decodedPayload, err = receiver.decoder.DecodePLC(packetDuration)
+			}
+		}
+		// Whether packets were skipped (while muted) since the last decode
+		skippedDecoding := false
+		resetDecoder := func() {
+			if err := receiver.decoder.Reset(); err != nil {
+				peer.logger.Error("error while resetting decoder", "err", err)
+			}
+		}
+
+		// Playout is scheduled against a fixed deadline, so time spent decoding does not accumulate as drift
+		nextPlayout := time.Now().Add(jitterBuffer.getPacketDuration())
+		playoutTimer := time.NewTimer(time.Until(nextPlayout))
+		defer playoutTimer.Stop()
+		for {
+			select {
+			case <-peer.ctx.Done():
+				return
+			case <-playoutTimer.C:
+			}
+			packetDuration = jitterBuffer.getPacketDuration()
+			nextPlayout = nextPlayout.Add(packetDuration)
+			if time.Until(nextPlayout) < -jitterBufferMaxDelay {
+				// Playout fell far behind (e.g. the sink blocked), so start afresh rather than catching up
+				nextPlayout = time.Now().Add(packetDuration)
+			}
+			playoutTimer.Reset(time.Until(nextPlayout))
+
+			action, payload = jitterBuffer.pop()
+			if action == playoutWait {
+				continue
+			}
+			if peer.muted.Load() {
+				// The packet is consumed, but not decoded
+				skippedDecoding = true
+				continue
+			}
+			if skippedDecoding {
+				skippedDecoding = false
+				receiver.decoder.Run(resetDecoder)
+			}
+			receiver.decoder.Run(decode)
 			if err != nil {
 				peer.logger.Error(
 					"error while decoding packet from remote client",
 					"frameIndex", frameIndex,
+					"playoutAction", action,
 					"err", err,
 				)
 				continue
 			}
-			// TODO: Handle dropped and out-of-order packets?
 
-			// If peer.audioOutputChannel is nil, i.e. not yet set, then this just blocks not panics
-			// If source channel cannot receive data, do we want to wait or drop the packet?
+			// If the sink is not yet read from, this blocks until it is (or the peer is closed),
+			// in which case the jitter buffer fills, and skips packets once read from again.
 			select {
-			case peer.audioSinkChannel <- decodedPayload:
-				// default:
+			case receiver.sink <- decodedPayload:
+			case <-peer.ctx.Done():
+				decodedPayload.Release()
+				return
 			}
-			// slog.Debug(
-			// 	"frame sent",
-			// 	"frameIndex", frameIndex,
-			// 	"pcmDataLen", len(decodedPayload),
-			// )
 
 			frameIndex += 1
 		}
@@ -47,17 +47,42 @@ type peerCore struct {
 
 	// WebRTC track for sending audio from this client to the remote client.
 	// This parameter is undefined until the connection has been negotiated
-	connectionAudioInputTrack *webrtc.TrackLocalStaticSample
-
-	// WebRTC track for receiving audio from remote client.
+	connectionAudioInputTrack *webrtc.TrackLocalStaticRTP
+	// The sender of connectionAudioInputTrack, on which the remote client's RTCP feedback
+	// about the audio it receives (e.g. receiver reports) arrives.
 	// This parameter is undefined until the connection has been negotiated
-	connectionAudioOutputTrack *webrtc.TrackRemote
+	connectionAudioInputSender *webrtc.RTPSender
+
+	// Further WebRTC tracks for sending audio to the remote client (see PeerFactory.SetNumAudioTracks).
+	// This client sends its own audio on connectionAudioInputTrack only, while these carry the speakers forwarded by a Forwarder.
+	connectionForwardingTracks []localAudioTrack
+
+	// WebRTC tracks for receiving audio from the remote client, in the order they arrived. There is usually one,
+	// but a Forwarder sends each speaker it forwards on a track of its own (see PeerFactory.SetNumAudioTracks).
+	// Tracks arrive once the connection has been negotiated, so this is empty until then.
+	connectionAudioOutputTracks []remoteAudioTrack
+	// Called with each track that arrives once the peerCore is wrapped into a Peer, which starts receiving audio on it
+	onAudioOutputTrack func(remoteAudioTrack)
+	// Guards connectionAudioOutputTracks and onAudioOutputTrack, as tracks arrive on goroutines of the connection
+	audioOutputMutex sync.Mutex
 
 	// Data Channel to send / receive heartbeat messages on.
 	// This parameter is undefined until the connection has been negotiated
 	connectionHeartbeatDataChannel *webrtc.DataChannel
 }
 
+// A WebRTC track for sending audio to the remote client, and its sender.
+type localAudioTrack struct {
+	track  *webrtc.TrackLocalStaticRTP
+	sender *webrtc.RTPSender
+}
+
+// A WebRTC track for receiving audio from the remote client, and its receiver, holding the negotiated parameters of the audio received.
+type remoteAudioTrack struct {
+	track    *webrtc.TrackRemote
+	receiver *webrtc.RTPReceiver
+}
+
 func newPeerCore(
 	identifier signalling.PeerIdentifier,
 	connection *webrtc.PeerConnection,
@@ -117,8 +142,35 @@ func (core *peerCore) setConnectionHeartbeatDataChannel(dc *webrtc.DataChannel)
 	dc.OnMessage(core.heartbeatOnMessageHandler)
 }
 
-func (core *peerCore) setConnectionAudioInputTrack(tr *webrtc.TrackLocalStaticSample) {
+func (core *peerCore) setConnectionAudioInputTrack(tr *webrtc.TrackLocalStaticRTP, sender *webrtc.RTPSender) {
 	core.connectionAudioInputTrack = tr
+	core.connectionAudioInputSender = sender
+}
+
+// Read the RTCP packets arriving on the receiver of the remote client's audio track, until it is closed.
+// RTCP packets are processed by the connection's interceptors as they are read (e.g. the remote client's
+// sender reports, which this client's receiver reports refer to), so must be read even though unused here.
+func (core *peerCore) readReceiverRTCP(receiver *webrtc.RTPReceiver) {
+	go func() {
+		for {
+			if _, _, err := receiver.ReadRTCP(); err != nil {
+				return
+			}
+		}
+	}()
+}
+
+// Read the RTCP packets arriving on the sender of one of connectionForwardingTracks, until it is closed.
+// Feedback on the audio sent is handled on connectionAudioInputSender alone (see Peer.receiveRTCPHandler),
+// but every sender must be read, for the connection's interceptors to process its packets.
+func (core *peerCore) readSenderRTCP(sender *webrtc.RTPSender) {
+	go func() {
+		for {
+			if _, _, err := sender.ReadRTCP(); err != nil {
+				return
+			}
+		}
+	}()
 }
 
 // --------------------------------------------------------------------------------
@@ -127,7 +179,8 @@ func (core *peerCore) setConnectionAudioInputTrack(tr *webrtc.TrackLocalStaticSa
 
 // OnTrack handler
 // Handle initialization of a new track, offered by the remote peer.
-// Should start listening for packets from the remote peer, decoding them, and streaming them out
+// The track is kept until the peerCore is wrapped into a Peer, which then listens for packets on it,
+// decodes them, and streams them out (see Peer.receiveAudioOutputTracks).
 func (core *peerCore) onTrackHandler(tr *webrtc.TrackRemote, r *webrtc.RTPReceiver) {
 	core.logger.Debug(
 		"received track",
@@ -135,7 +188,15 @@ func (core *peerCore) onTrackHandler(tr *webrtc.TrackRemote, r *webrtc.RTPReceiv
 		"track kind", tr.Kind().String(),
 	)
 
-	core.connectionAudioOutputTrack = tr
+	core.readReceiverRTCP(r)
+
+	core.audioOutputMutex.Lock()
+	defer core.audioOutputMutex.Unlock()
+	audioOutputTrack := remoteAudioTrack{track: tr, receiver: r}
+	core.connectionAudioOutputTracks = append(core.connectionAudioOutputTracks, audioOutputTrack)
+	if core.onAudioOutputTrack != nil {
+		core.onAudioOutputTrack(audioOutputTrack)
+	}
 }
 
 // heartbeat onOpen handler
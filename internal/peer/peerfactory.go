@@ -5,8 +5,10 @@ import (
 	"log/slog"
 
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/internal/encoderdecoder"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice/device"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/signalling"
+	"github.com/pion/sdp/v3"
 	"github.com/pion/webrtc/v4"
 )
 
@@ -15,6 +17,9 @@ type PeerFactory struct {
 
 	audioTrackRTPCodecCapability webrtc.RTPCodecCapability
 	opusFactory                  encoderdecoder.OpusFactory
+
+	// The number of audio tracks of each connection, in each direction (see SetNumAudioTracks)
+	numAudioTracks int
 }
 
 // Create a new PeerFactory.
@@ -44,20 +49,35 @@ func NewPeerFactory(
 		logger:                       logger,
 		audioTrackRTPCodecCapability: audioTrackRTPCodecCapability,
 		opusFactory:                  opusFactory,
+		numAudioTracks:               1,
 	}
 
 	return factory
 }
 
+// Set the number of audio tracks of each connection made from now on, in each direction. The default is 1.
+//
+// A client sends its own audio on the first track only. The others carry the speakers a Forwarder forwards, each on a
+// track of its own, so a participant of a Forwarder hears up to n speakers at once (see Forwarder.SetMaxActiveSpeakers).
+// With more than one track, the audio received on every track is mixed into the stream of the Peer.
+//
+// Only as many tracks as both sides of a connection add are negotiated, so every participant of a Forwarder
+// and its forwarding node should set the same n. Connections outside a Forwarder (e.g. a full mesh) should keep the default,
+// as every further track is an idle m-line, and the audio received is mixed only if the remote peer accepted more than one.
+func (factory *PeerFactory) SetNumAudioTracks(n int) {
+	factory.numAudioTracks = max(n, 1)
+}
+
 // --------------------------------------------------------------------------------
 // SETUP METHODS
 // Methods to initialize important peer properties, including connection handlers
 
 // Create an audio track and start streaming audio packets along it.streaming audio along it.
 // This function:
-// - Creates a new TrackLocalStaticSample, using the factory's CodecCapability
+// - Creates a new TrackLocalStaticRTP, using the factory's CodecCapability
 // - Attaches that sample to the peer's connection
 // - Sets connectionAudioInputTrack on the Peer struct
+// - Likewise creates and attaches the connectionForwardingTracks, if the factory has more than one audio track
 //
 // Once the connection has been fully established, the track's data should be checked
 // for the negotiated codec and properties (e.g. sample rate, channels) and
@@ -65,7 +85,7 @@ func NewPeerFactory(
 func (factory *PeerFactory) connectionAudioInputTrackSetup(core *peerCore) error {
 	trackID := fmt.Sprintf("%s audio", core.Identifier().Uuid.String())
 	streamID := fmt.Sprintf("%s audio stream", core.Identifier().Uuid.String())
-	track, err := webrtc.NewTrackLocalStaticSample(
+	track, err := webrtc.NewTrackLocalStaticRTP(
 		factory.audioTrackRTPCodecCapability,
 		trackID,
 		streamID,
@@ -74,12 +94,28 @@ func (factory *PeerFactory) connectionAudioInputTrackSetup(core *peerCore) error
 		return err
 	}
 
-	_, err = core.connection.AddTrack(track)
+	sender, err := core.connection.AddTrack(track)
 	if err != nil {
 		return err
 	}
 
-	core.setConnectionAudioInputTrack(track)
+	core.setConnectionAudioInputTrack(track, sender)
+
+	for i := 1; i < factory.numAudioTracks; i++ {
+		track, err := webrtc.NewTrackLocalStaticRTP(
+			factory.audioTrackRTPCodecCapability,
+			fmt.Sprintf("%s %d", trackID, i),
+			streamID,
+		)
+		if err != nil {
+			return err
+		}
+		sender, err := core.connection.AddTrack(track)
+		if err != nil {
+			return err
+		}
+		core.connectionForwardingTracks = append(core.connectionForwardingTracks, localAudioTrack{track: track, sender: sender})
+	}
 
 	return nil
 }
@@ -122,6 +158,17 @@ func (factory *PeerFactory) peerCoreConnectionStateChangeHandler(
 	}
 }
 
+// Whether the transceiver of the given sender was negotiated, i.e. the remote peer accepted its track.
+// A track added by one side only (e.g. as the other added fewer tracks, see SetNumAudioTracks) never is.
+func isNegotiated(connection *webrtc.PeerConnection, sender *webrtc.RTPSender) bool {
+	for _, transceiver := range connection.GetTransceivers() {
+		if transceiver.Sender() == sender {
+			return transceiver.Mid() != ""
+		}
+	}
+	return false
+}
+
 // --------------------------------------------------------------------------------
 // PEER CREATION
 // Methods to create new peers
@@ -206,39 +253,68 @@ func (factory *PeerFactory) NewAnsweringPeer(
 // Returns a Peer that wraps the newly connected peerCore. Returns an error if something goes wrong
 func (factory *PeerFactory) wrapPeerCore(core *peerCore) (*Peer, error) {
 	codec := core.connectionAudioInputTrack.Codec()
-	audioEncoderDecoder, err := factory.opusFactory.NewOpusEncoderDecoder(
+	// The encoder is only created once the peer encodes its own audio (see Peer.getAudioEncoder),
+	// as a peer in an EncoderGroup never does, and a decoder is created for each track received (see Peer.receiveAudioOutputTrack)
+
+	// The connection is negotiated, so the header extensions the remote peer accepts are known.
+	// Every track has the same codec and header extensions, and their packets share the transport-wide sequence.
+	headerExtensions := core.connectionAudioInputSender.GetParameters().HeaderExtensions
+	audioLevelExtensionID := headerExtensionID(headerExtensions, sdp.AudioLevelURI)
+	transportCCExtensionID := headerExtensionID(headerExtensions, sdp.TransportCCURI)
+	sendTimes := newPacketSendTimes()
+	forwardingTrackWriters := make([]*audioTrackWriter, 0, len(core.connectionForwardingTracks))
+	for _, forwardingTrack := range core.connectionForwardingTracks {
+		if !isNegotiated(core.connection, forwardingTrack.sender) {
+			continue
+		}
+		core.readSenderRTCP(forwardingTrack.sender)
+		forwardingTrackWriters = append(forwardingTrackWriters, newAudioTrackWriter(
+			core.logger,
+			forwardingTrack.track,
+			int(codec.ClockRate),
+			audioLevelExtensionID,
+			transportCCExtensionID,
+			sendTimes,
+		))
+	}
+	audioTrackWriter := newAudioTrackWriter(
+		core.logger,
+		core.connectionAudioInputTrack,
 		int(codec.ClockRate),
-		int(codec.Channels),
+		audioLevelExtensionID,
+		transportCCExtensionID,
+		sendTimes,
 	)
-	if err != nil {
-		core.logger.Error(
-			"error during creation of audio encoder/decoder",
-			"negotiatedCodec", codec,
-			"err", err,
-		)
-		core.Close()
-		return nil, err
-	}
 
+	minFrameDuration, maxFrameDuration := factory.opusFactory.GetFrameDurationRange()
 	wrappedPeer := &Peer{
-		peerCore:            core,
-		audioSinkChannel:    make(chan frame.PCMFrame),
-		audioEncoderDecoder: audioEncoderDecoder,
+		peerCore:               core,
+		audioSinkChannel:       make(chan *frame.PooledPCMFrame),
+		opusFactory:            factory.opusFactory,
+		audioTrackWriter:       audioTrackWriter,
+		forwardingTrackWriters: forwardingTrackWriters,
+		bitrateController: newBitrateController(
+			factory.opusFactory.GetEncoderSettings(),
+			int(codec.Channels),
+			factory.opusFactory.GetFrameDuration(),
+			minFrameDuration,
+			maxFrameDuration,
+			sendTimes,
+		),
+	}
+	wrappedPeer.audioReceivers.Store(&[]*audioReceiver{})
+	// Only mix if the remote peer accepted more than one track, so a connection with a single track carries no mixing device
+	if len(forwardingTrackWriters) > 0 {
+		wrappedPeer.audioOutputMix = device.NewFanInDevice(wrappedPeer.GetDeviceProperties(), factory.opusFactory.GetFrameDuration())
 	}
 
 	// Shadow the connection state change handler to prevent wrapping the core more than once
 	wrappedPeer.connection.OnConnectionStateChange(wrappedPeer.onConnectionStateChangeHandler)
 
-	// Keep listening for the connection's track, but use the shadowed
-	// method to call wrappedPeer.receiveAudioOutputHandler() when ready.
-	//
-	// If peerCore already received a track, this method will reject all future tracks.
-	// (see internals, where a conditional early-returns if connectionAudioOutputTrack is set)
-	wrappedPeer.connection.OnTrack(wrappedPeer.onTrackHandler)
+	// Listen for audio on the tracks the peerCore already received (see peerCore.onTrackHandler), and those yet to arrive
+	wrappedPeer.receiveAudioOutputTracks()
 
-	// If the peerCore already received a track (peerCore.onTrackHandler) then just listening for audio
-	if wrappedPeer.connectionAudioOutputTrack != nil {
-		wrappedPeer.receiveAudioOutputHandler()
-	}
+	// Adapt the encoder to the remote peer's feedback on the audio it receives
+	wrappedPeer.receiveRTCPHandler()
 	return wrappedPeer, nil
 }
@@ -14,8 +14,10 @@ type DeviceProperties struct {
 type AudioSourceDevice interface {
 	// Get the stream of this audio device.
 	//
-	// Raw audio data (as PCMFrames) will arrive on the returned channel.
-	GetStream() <-chan frame.PCMFrame
+	// Raw audio data (as PooledPCMFrames) will arrive on the returned channel.
+	// Each frame received carries one reference, owned by the receiver, which
+	// must be forwarded or released (see frame.PooledPCMFrame).
+	GetStream() <-chan *frame.PooledPCMFrame
 
 	// Meaningfully close the AudioSourceDevice, including any cleanup of
 	// memory and closing of channels.
@@ -33,11 +35,13 @@ type AudioSourceDevice interface {
 type AudioSinkDevice interface {
 	// Set the source stream of this audio device.
 	//
-	// Raw audio data (as PCMFrames) will arrive on the given channel.
+	// Raw audio data (as PooledPCMFrames) will arrive on the given channel.
+	// The device owns one reference to each frame it receives, and must
+	// release each frame once it is done with it.
 	//
 	// When this stream is closed, it is assumed the device will be cleaned up
 	// (memory will be freed, other channels will be closed, etc)
-	SetStream(sourceStream <-chan frame.PCMFrame)
+	SetStream(sourceStream <-chan *frame.PooledPCMFrame)
 
 	GetDeviceProperties() DeviceProperties
 
@@ -52,3 +56,83 @@ type AudioSinkDevice interface {
 	//
 	// Close()
 }
+
+// Optional extension of AudioSourceDevice, for devices that can produce frames
+// on a RingStream instead of a channel.
+type RingStreamSourceDevice interface {
+	AudioSourceDevice
+
+	// Get the ring stream of this audio device.
+	//
+	// Once called, raw audio data will arrive on the returned RingStream
+	// instead of the channel returned by GetStream.
+	//
+	// A RingStream allows only one consumer, so calling GetRingStream again
+	// closes the previously returned RingStream.
+	GetRingStream() *RingStream
+}
+
+// Optional extension of AudioSinkDevice, for devices that can consume frames
+// from a RingStream instead of a channel.
+type RingStreamSinkDevice interface {
+	AudioSinkDevice
+
+	// Set the source ring stream of this audio device.
+	//
+	// When this stream is closed, it is assumed the device will be cleaned up,
+	// exactly as if the channel given to SetStream were closed.
+	SetRingStream(sourceStream *RingStream)
+}
+
+// Optional extension of AudioSourceDevice, for devices that can produce audio on demand
+// (e.g. a mixer), rather than only at their own pace on a stream.
+type AudioRendererSourceDevice interface {
+	AudioSourceDevice
+
+	// Render exactly len(out) samples of audio into out, in the format given by
+	// GetDeviceProperties (i.e. interleaved if there are multiple channels).
+	//
+	// Once Render has been called, the device is driven by its caller, and no longer
+	// produces frames on the stream returned by GetStream.
+	// Returns false once the device is closed, in which case out is left untouched.
+	Render(out frame.PCMFrame) bool
+}
+
+// Optional extension of AudioSinkDevice, for devices driven by their own clock
+// (e.g. a speaker) that can pull audio from a source exactly when it is needed.
+//
+// Pulling audio removes the streams (and their goroutines and clocks) between the
+// source and the device, so the output latency is a single period of the device.
+type AudioPullSinkDevice interface {
+	AudioSinkDevice
+
+	// Set the source this device pulls audio from, and start consuming audio.
+	// This is used in place of SetStream.
+	//
+	// When the source is closed, it is assumed the device will be cleaned up,
+	// exactly as if the channel given to SetStream were closed.
+	SetRenderSource(source AudioRendererSourceDevice)
+}
+
+// Connect the output of source to the input of sink.
+//
+// If the sink can pull audio from the source, it is given the source to render from,
+// so no stream is used at all. Otherwise, if both devices support RingStreams, they are
+// connected with a RingStream, avoiding a goroutine handoff per frame. Otherwise, they
+// are connected with the channel returned by source.GetStream.
+func Connect(source AudioSourceDevice, sink AudioSinkDevice) {
+	renderSource, sourceOk := source.(AudioRendererSourceDevice)
+	pullSink, sinkOk := sink.(AudioPullSinkDevice)
+	if sourceOk && sinkOk {
+		pullSink.SetRenderSource(renderSource)
+		return
+	}
+
+	ringSource, sourceOk := source.(RingStreamSourceDevice)
+	ringSink, sinkOk := sink.(RingStreamSinkDevice)
+	if sourceOk && sinkOk {
+		ringSink.SetRingStream(ringSource.GetRingStream())
+		return
+	}
+	sink.SetStream(source.GetStream())
+}
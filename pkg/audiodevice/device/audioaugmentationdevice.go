@@ -1,35 +1,30 @@
 package device
 
 import (
-	"sync"
-
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
 )
 
 // Middle-man processing device to handle audio augmentations,
-// such as volume controls
+// such as volume controls, optionally followed by voice activity detection
+//
+// This device is a PipelineDevice running only the stages of an AudioAugmentation
+// (and of a VoiceActivityDetector, if any).
+// If the augmented audio is also format converted, prefer building a single
+// Pipeline with all the stages instead.
+//
 // This device is both a sink and a source!
 type AudioAugmentationDevice struct {
-	deviceProperties audiodevice.DeviceProperties
-
-	// The stream that data *arrives on*
-	// i.e. the stream that acts like a source, as it produces frames
-	sourceStream <-chan frame.PCMFrame
-
-	// The stream that data *leaves on*
-	// i.e. the stream that acts like a sink, as it consumes frames
-	sinkStream chan frame.PCMFrame
-
-	augmentationFunctions []audioAugmentationFunction
-	volumeAdjustMagnitude float32
+	*PipelineDevice
+	*AudioAugmentation
 
-	shutdownOnce sync.Once
+	// nil unless the device was created with NewAudioAugmentationDeviceWithVoiceActivityDetection
+	voiceActivityDetector *VoiceActivityDetector
 }
 
-// Create a new AudioFormatConversionDevice, automatically adding
+// Create a new AudioAugmentationDevice, automatically adding
 // audioAugmentationFunctions:
-//   - volumeAdjust (controlled with AudioAugmentationDevice.SetVolume)
+//   - volumeAdjust (controlled with AudioAugmentationDevice.SetVolumeAdjustMagnitude)
 //     (0.0 for mute, no cap on volume, but beware of clipping)
 //
 // Note one must still call SetStream, passing in the source channel,
@@ -38,84 +33,75 @@ type AudioAugmentationDevice struct {
 //
 // This device will only start converting once SetStream is called.
 func NewAudioAugmentationDevice(deviceProperties audiodevice.DeviceProperties) *AudioAugmentationDevice {
-	device := &AudioAugmentationDevice{
-		deviceProperties:      deviceProperties,
-		volumeAdjustMagnitude: 1.0,
-		sinkStream:            make(chan frame.PCMFrame),
+	augmentation := NewAudioAugmentation()
+	pipeline := NewPipelineBuilder(deviceProperties).
+		Augment(augmentation).
+		Build()
+	return &AudioAugmentationDevice{
+		PipelineDevice:    NewPipelineDevice(pipeline),
+		AudioAugmentation: augmentation,
 	}
+}
 
-	formatConversionFunctions := []audioAugmentationFunction{
-		device.volumeAdjust,
+// Create a new AudioAugmentationDevice as NewAudioAugmentationDevice does, followed by voice activity detection,
+// which drops silent frames (see VoiceActivityDetector, as returned by AudioAugmentationDevice.VoiceActivityDetector).
+func NewAudioAugmentationDeviceWithVoiceActivityDetection(deviceProperties audiodevice.DeviceProperties) *AudioAugmentationDevice {
+	augmentation := NewAudioAugmentation()
+	voiceActivityDetector := NewVoiceActivityDetector(deviceProperties)
+	pipeline := NewPipelineBuilder(deviceProperties).
+		Augment(augmentation).
+		DetectVoiceActivity(voiceActivityDetector).
+		Build()
+	return &AudioAugmentationDevice{
+		PipelineDevice:        NewPipelineDevice(pipeline),
+		AudioAugmentation:     augmentation,
+		voiceActivityDetector: voiceActivityDetector,
 	}
-	device.augmentationFunctions = formatConversionFunctions
+}
 
-	return device
+// The VoiceActivityDetector of this device, or nil if it does not detect voice activity.
+func (d *AudioAugmentationDevice) VoiceActivityDetector() *VoiceActivityDetector {
+	return d.voiceActivityDetector
 }
 
 // --------------------------------------------------------------------------------
-// AudioSourceDevice Interface
-
-// Get the source stream of this audio device.
-// Raw audio data (as PCMFrames) will arrive on the returned channel.
-func (d *AudioAugmentationDevice) GetStream() <-chan frame.PCMFrame {
-	return d.sinkStream
-}
+// AudioAugmentation
 
-// Meaningfully close the AudioSourceDevice, including any cleanup of
-// memory and closing of channels.
+// The parameters of the audio augmentations (e.g. volume) applied to a single stream.
 //
-// It is assumed that once closed, this device will transmit no more information,
-// and will consume no more information.
-func (d *AudioAugmentationDevice) Close() {
-	d.shutdownOnce.Do(func() {
-		close(d.sinkStream)
-	})
+// An AudioAugmentation is added to a Pipeline with PipelineBuilder.Augment,
+// and may be adjusted while that pipeline is running.
+type AudioAugmentation struct {
+	volumeAdjustMagnitude float32
 }
 
-// The device properties of the incoming and outgoing PCMFrames should be identical,
-// so this serves as both Source and Sink Device Properties
-func (d *AudioAugmentationDevice) GetDeviceProperties() audiodevice.DeviceProperties {
-	return d.deviceProperties
+// Create a new AudioAugmentation with natural volume scaling.
+func NewAudioAugmentation() *AudioAugmentation {
+	return &AudioAugmentation{
+		volumeAdjustMagnitude: 1.0,
+	}
 }
 
-// --------------------------------------------------------------------------------
-// AudioSinkDevice Interface
-
-// Set the source channel of this audio device, i.e. where data comes from.
-// Raw audio data (as PCMFrames) will arrive on the given channel.
-//
-// When this stream is closed, it is assumed the device will be cleaned up
-// (memory will be freed, other channels will be closed, etc)
-func (d *AudioAugmentationDevice) SetStream(sourceStream <-chan frame.PCMFrame) {
-	d.sourceStream = sourceStream
-	go func() {
-		for pcmFrame := range d.sourceStream {
-			for _, f := range d.augmentationFunctions {
-				pcmFrame = f(pcmFrame)
-			}
-			d.sinkStream <- pcmFrame
-		}
-		// This goroutine dies when incomingAudioStream is closed.
-		d.Close()
-	}()
+// The functions applying this augmentation, in order.
+func (a *AudioAugmentation) augmentationFunctions() []audioAugmentationFunction {
+	return []audioAugmentationFunction{
+		a.volumeAdjust,
+	}
 }
 
-// --------------------------------------------------------------------------------
-// Methods relating to changing the augmentation functions
-
 // Set the volumeAdjustMagnitude to a new value. Must be non-negative.
 // 0.0 means muted, 1.0 is natural scaling, technically uncapped but
 // audio encoded as PCMFrames clip if values are made too large.
-func (d *AudioAugmentationDevice) SetVolumeAdjustMagnitude(volumeAdjustMagnitude float32) {
+func (a *AudioAugmentation) SetVolumeAdjustMagnitude(volumeAdjustMagnitude float32) {
 	if volumeAdjustMagnitude < 0.0 {
 		volumeAdjustMagnitude = 0.0
 	}
-	d.volumeAdjustMagnitude = volumeAdjustMagnitude
+	a.volumeAdjustMagnitude = volumeAdjustMagnitude
 }
 
 // Get the current volumeAdjustMagnitude.
-func (d *AudioAugmentationDevice) GetVolumeAdjustMagnitude() float32 {
-	return d.volumeAdjustMagnitude
+func (a *AudioAugmentation) GetVolumeAdjustMagnitude() float32 {
+	return a.volumeAdjustMagnitude
 }
 
 // --------------------------------------------------------------------------------
@@ -123,13 +109,26 @@ func (d *AudioAugmentationDevice) GetVolumeAdjustMagnitude() float32 {
 // There is an expectation that an audioAugmentationFunction will produce
 // PCMFrames with the same device properties as what is given in sourceFrame
 //
-// In fact, for many audioAugmentationFunctions, the returned PCMFrame
-// is the exact same underlying memory in an effort to avoid reallocations.
-type audioAugmentationFunction func(sourceFrame frame.PCMFrame) frame.PCMFrame
+// In fact, for many audioAugmentationFunctions, the returned PooledPCMFrame
+// is the exact same frame in an effort to avoid reallocations.
+// The function takes ownership of the reference to sourceFrame, and the caller
+// takes ownership of the reference to the returned frame.
+//
+// sourceFrame may be shared with other devices (e.g. when sourced from a FanOutDevice),
+// so a function that modifies samples must do so on sourceFrame.Writable().
+type audioAugmentationFunction func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame
+
+func (a *AudioAugmentation) volumeAdjust(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame {
+	volumeAdjustMagnitude := a.volumeAdjustMagnitude
+	// Natural scaling changes nothing, so avoid a potential copy of a shared frame
+	if volumeAdjustMagnitude == 1.0 {
+		return sourceFrame
+	}
 
-func (d *AudioAugmentationDevice) volumeAdjust(sourceFrame frame.PCMFrame) frame.PCMFrame {
-	for i := range sourceFrame {
-		sourceFrame[i] *= d.volumeAdjustMagnitude
+	sourceFrame = sourceFrame.Writable()
+	samples := sourceFrame.Samples()
+	for i := range samples {
+		samples[i] *= volumeAdjustMagnitude
 		// TODO: Should we handle clipping here?
 		// If audio does slip outside [-1.0, 1.0], the program seems to handle it (clips at speaker)
 	}
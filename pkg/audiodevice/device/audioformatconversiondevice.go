@@ -2,7 +2,6 @@ package device
 
 import (
 	"log/slog"
-	"sync"
 
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
@@ -10,11 +9,12 @@ import (
 )
 
 const (
-	// To avoid reallocating for every source frame, reuse a buffer with "enough size".
+	// To avoid reallocating for every source frame, reuse scratch buffers with "enough size".
 	// Since we don't know the frame duration (number of samples) beforehand, we must estimate.
 	//
 	// As a rough estimate, 48000Hz stereo audio with a latency of 120ms is 11520 samples
 	// So a buffer of 2**14 = 16384 should be enough for anything.
+	// If a larger frame ever arrives, the scratch buffers are grown to fit.
 	bufferSize int = 16384
 )
 
@@ -24,22 +24,13 @@ const (
 // e.g. if the source format is mono, but the sink format specifies stereo,
 // this device will handle the conversion.
 //
+// This device is a PipelineDevice running only format conversion stages.
+// If the converted audio is further processed (e.g. by an AudioAugmentationDevice),
+// prefer building a single Pipeline with all the stages instead.
+//
 // This device is both a sink and a source!
 type AudioFormatConversionDevice struct {
-	// The stream that data *arrives on*
-	// i.e. the stream that acts like a source, as it produces frames
-	sourceStream     <-chan frame.PCMFrame
-	sourceProperties audiodevice.DeviceProperties
-
-	// The stream that data *leaves on*
-	// i.e. the stream that acts like a sink, as it consumes frames
-	sinkStream     chan frame.PCMFrame
-	sinkProperties audiodevice.DeviceProperties
-
-	// The functions to apply when processing the source data to sink format
-	formatConversionFunctions []audioFormatConversionFunction
-
-	shutdownOnce sync.Once
+	*PipelineDevice
 }
 
 // Create a new AudioFormatConversionDevice by defining:
@@ -55,6 +46,19 @@ func NewAudioFormatConversionDevice(
 	sourceProperties audiodevice.DeviceProperties,
 	sinkProperties audiodevice.DeviceProperties,
 ) AudioFormatConversionDevice {
+	pipeline := NewPipelineBuilder(sourceProperties).
+		ConvertFormat(sinkProperties).
+		Build()
+	return AudioFormatConversionDevice{
+		PipelineDevice: NewPipelineDevice(pipeline),
+	}
+}
+
+// Return the functions converting audio from sourceProperties to sinkProperties, in order.
+func newFormatConversionFunctions(
+	sourceProperties audiodevice.DeviceProperties,
+	sinkProperties audiodevice.DeviceProperties,
+) []audioFormatConversionFunction {
 	formatConversionFunctions := make([]audioFormatConversionFunction, 0)
 
 	if sourceProperties.NumChannels == 1 && sinkProperties.NumChannels == 2 {
@@ -70,107 +74,70 @@ func NewAudioFormatConversionDevice(
 		formatConversionFunctions = append(formatConversionFunctions, newResampleFunction(sourceProperties, sinkProperties))
 	}
 
-	return AudioFormatConversionDevice{
-		sourceProperties:          sourceProperties,
-		sinkProperties:            sinkProperties,
-		sinkStream:                make(chan frame.PCMFrame),
-		formatConversionFunctions: formatConversionFunctions,
-	}
-}
-
-// --------------------------------------------------------------------------------
-// AudioSourceDevice Interface
-
-// Get the source stream of this audio device.
-// Raw audio data (as PCMFrames) will arrive on the returned channel.
-func (d *AudioFormatConversionDevice) GetStream() <-chan frame.PCMFrame {
-	return d.sinkStream
-}
-
-// Meaningfully close the AudioSourceDevice, including any cleanup of
-// memory and closing of channels.
-//
-// It is assumed that once closed, this device will transmit no more information.
-func (d *AudioFormatConversionDevice) Close() {
-	d.shutdownOnce.Do(func() {
-		close(d.sinkStream)
-	})
-}
-
-// WARNING:
-// GetDeviceProperties of the AudioFormatConversionDevice returns the
-// device properties of the LEAVING data. i.e. the data that exits this device!
-//
-// If you need the properties of the data entering this device, call GetSourceDeviceProperties()
-func (d *AudioFormatConversionDevice) GetDeviceProperties() audiodevice.DeviceProperties {
-	return d.sinkProperties
-}
-
-// --------------------------------------------------------------------------------
-// AudioSinkDevice Interface
-
-// Set the source channel of this audio device, i.e. where data comes from.
-// Raw audio data (as PCMFrames) will arrive on the given channel.
-//
-// When this stream is closed, it is assumed the device will be cleaned up
-// (memory will be freed, other channels will be closed, etc)
-func (d *AudioFormatConversionDevice) SetStream(sourceStream <-chan frame.PCMFrame) {
-	d.sourceStream = sourceStream
-	go func() {
-		for pcmFrame := range d.sourceStream {
-			for _, f := range d.formatConversionFunctions {
-				pcmFrame = f(pcmFrame)
-			}
-			d.sinkStream <- pcmFrame
-		}
-		// This goroutine dies when incomingAudioStream is closed.
-		d.Close()
-	}()
-}
-
-func (d *AudioFormatConversionDevice) GetSourceDeviceProperties() audiodevice.DeviceProperties {
-	return d.sourceProperties
+	return formatConversionFunctions
 }
 
 // --------------------------------------------------------------------------------
 
 // There is an expectation that an audioFormatConversionFunction will produce
 // PCMFrames with different device properties than what are given in sourceFrame
-type audioFormatConversionFunction func(sourceFrame frame.PCMFrame) frame.PCMFrame
+//
+// The function takes ownership of the reference to sourceFrame (releasing it once
+// converted), and the caller takes ownership of the reference to the returned frame,
+// which is drawn from the frame pool.
+type audioFormatConversionFunction func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame
 
 func monoToStereo() audioFormatConversionFunction {
-	buf := make(frame.PCMFrame, bufferSize)
-	return func(sourceFrame frame.PCMFrame) frame.PCMFrame {
-		for i, v := range sourceFrame {
-			buf[2*i] = v
-			buf[2*i+1] = v
+	return func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame {
+		source := sourceFrame.Samples()
+		sinkFrame := frame.GetPooledPCMFrame(2 * len(source))
+		sink := sinkFrame.Samples()
+		for i, v := range source {
+			sink[2*i] = v
+			sink[2*i+1] = v
 		}
-		return buf[:2*len(sourceFrame)]
+		sourceFrame.Release()
+		return sinkFrame
 	}
 }
 
 func stereoToMono() audioFormatConversionFunction {
-	buf := make(frame.PCMFrame, bufferSize)
-	return func(sourceFrame frame.PCMFrame) frame.PCMFrame {
-		if len(sourceFrame)%2 == 1 {
-			sourceFrame = sourceFrame[:len(sourceFrame)-1]
+	return func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame {
+		source := sourceFrame.Samples()
+		sinkFrame := frame.GetPooledPCMFrame(len(source) / 2)
+		sink := sinkFrame.Samples()
+		for i := range sink {
+			sink[i] = (source[2*i] + source[2*i+1]) / 2
 		}
-
-		for i := range len(sourceFrame) / 2 {
-			buf[i] = (sourceFrame[2*i] + sourceFrame[2*i+1]) / 2
-		}
-		return buf[:len(sourceFrame)/2]
+		sourceFrame.Release()
+		return sinkFrame
 	}
 
 }
 
+// Return a buffer of at least the given length, reusing buf where possible
+func growBuffer(buf frame.PCMFrame, length int) frame.PCMFrame {
+	if len(buf) >= length {
+		return buf
+	}
+	return make(frame.PCMFrame, length)
+}
+
 func newResampleFunction(sourceProperties audiodevice.DeviceProperties, sinkProperties audiodevice.DeviceProperties) audioFormatConversionFunction {
+	// The most samples (per channel) the resampler may produce from the given number of samples (per channel).
+	// The resampler may hold some samples back between calls, so leave a little room for those, too.
+	maxResampledLength := func(sourceLength int) int {
+		return sourceLength*sinkProperties.SampleRate/sourceProperties.SampleRate + 64
+	}
+
 	if sinkProperties.NumChannels == 1 {
 		r := resampler.New(1, sourceProperties.SampleRate, sinkProperties.SampleRate, 10)
-		buf := make(frame.PCMFrame, bufferSize)
-		return func(sourceFrame frame.PCMFrame) frame.PCMFrame {
-			_, written := r.ProcessFloat32(0, sourceFrame, buf)
-			return buf[:written]
+		return func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame {
+			sinkFrame := frame.GetPooledPCMFrame(maxResampledLength(sourceFrame.Len()))
+			_, written := r.ProcessFloat32(0, sourceFrame.Samples(), sinkFrame.Samples())
+			sinkFrame.Truncate(written)
+			sourceFrame.Release()
+			return sinkFrame
 		}
 	} else {
 		r := resampler.New(2, sourceProperties.SampleRate, sinkProperties.SampleRate, 10)
@@ -178,28 +145,34 @@ func newResampleFunction(sourceProperties audiodevice.DeviceProperties, sinkProp
 		rightSourceBuf := make(frame.PCMFrame, bufferSize/2)
 		leftSinkBuf := make(frame.PCMFrame, bufferSize/2)
 		rightSinkBuf := make(frame.PCMFrame, bufferSize/2)
-		buf := make(frame.PCMFrame, bufferSize)
-		return func(sourceFrame frame.PCMFrame) frame.PCMFrame {
-			if len(sourceFrame)%2 == 1 {
-				sourceFrame = sourceFrame[:len(sourceFrame)-1]
-			}
+		return func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame {
+			source := sourceFrame.Samples()
+			sourceLength := len(source) / 2
+			sinkLength := maxResampledLength(sourceLength)
+			leftSourceBuf = growBuffer(leftSourceBuf, sourceLength)
+			rightSourceBuf = growBuffer(rightSourceBuf, sourceLength)
+			leftSinkBuf = growBuffer(leftSinkBuf, sinkLength)
+			rightSinkBuf = growBuffer(rightSinkBuf, sinkLength)
 
 			// Decode to planar, sourceFrame is interleaved
-			for i := range len(sourceFrame) / 2 {
-				leftSourceBuf[i] = sourceFrame[2*i]
-				rightSourceBuf[i] = sourceFrame[2*i+1]
+			for i := range sourceLength {
+				leftSourceBuf[i] = source[2*i]
+				rightSourceBuf[i] = source[2*i+1]
 			}
+			sourceFrame.Release()
 
 			// Process both channels
-			_, written := r.ProcessFloat32(0, leftSourceBuf[:len(sourceFrame)/2], leftSinkBuf)
-			r.ProcessFloat32(1, rightSourceBuf[:len(sourceFrame)/2], rightSinkBuf)
+			_, written := r.ProcessFloat32(0, leftSourceBuf[:sourceLength], leftSinkBuf[:sinkLength])
+			r.ProcessFloat32(1, rightSourceBuf[:sourceLength], rightSinkBuf[:sinkLength])
 
 			// Interleave again
+			sinkFrame := frame.GetPooledPCMFrame(2 * written)
+			sink := sinkFrame.Samples()
 			for i := range written {
-				buf[2*i] = leftSinkBuf[i]
-				buf[2*i+1] = rightSinkBuf[i]
+				sink[2*i] = leftSinkBuf[i]
+				sink[2*i+1] = rightSinkBuf[i]
 			}
-			return buf[:2*written]
+			return sinkFrame
 		}
 
 	}
@@ -13,13 +13,13 @@ import (
 type DummyAudioSourceDevice struct {
 	properties   audiodevice.DeviceProperties
 	shutdownOnce sync.Once
-	sinkStream   chan frame.PCMFrame
+	sinkStream   chan *frame.PooledPCMFrame
 }
 
 func NewDummyAudioSourceDevice(properties audiodevice.DeviceProperties) *DummyAudioSourceDevice {
 	return &DummyAudioSourceDevice{
 		properties: properties,
-		sinkStream: make(chan frame.PCMFrame),
+		sinkStream: make(chan *frame.PooledPCMFrame),
 	}
 }
 
@@ -29,7 +29,7 @@ func (d *DummyAudioSourceDevice) Close() {
 	})
 }
 
-func (d *DummyAudioSourceDevice) GetStream() <-chan frame.PCMFrame {
+func (d *DummyAudioSourceDevice) GetStream() <-chan *frame.PooledPCMFrame {
 	return d.sinkStream
 }
 
@@ -42,7 +42,7 @@ func (d *DummyAudioSourceDevice) GetDeviceProperties() audiodevice.DevicePropert
 // A minimal example of the architecture of an AudioSinkDevice, useful in testing.
 type DummyAudioSinkDevice struct {
 	properties   audiodevice.DeviceProperties
-	sourceStream <-chan frame.PCMFrame
+	sourceStream <-chan *frame.PooledPCMFrame
 }
 
 func NewDummyAudioSinkDevice(properties audiodevice.DeviceProperties) *DummyAudioSinkDevice {
@@ -51,10 +51,11 @@ func NewDummyAudioSinkDevice(properties audiodevice.DeviceProperties) *DummyAudi
 	}
 }
 
-func (d *DummyAudioSinkDevice) SetStream(sourceStream <-chan frame.PCMFrame) {
+func (d *DummyAudioSinkDevice) SetStream(sourceStream <-chan *frame.PooledPCMFrame) {
 	d.sourceStream = sourceStream
 	go func() {
-		for range sourceStream {
+		for pcmFrame := range sourceStream {
+			pcmFrame.Release()
 		}
 	}()
 }
@@ -2,7 +2,10 @@ package device
 
 import (
 	"context"
+	"log/slog"
+	"math/bits"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
@@ -12,6 +15,19 @@ import (
 // --------------------------------------------------------------------------------
 // Fan Out Device (One to Many)
 
+const (
+	// A sink which has not accepted a frame for this long is removed from a FanOutDevice
+	fanOutSinkTimeout = 5 * time.Second
+
+	// How often a FanOutDevice checks for sinks which have timed out.
+	// This only affects how promptly dead sinks are removed, not the audio path.
+	fanOutSweepInterval = time.Second
+
+	// The number of frames queued for each sink of a FanOutDevice.
+	// When a sink falls this far behind, its oldest frame is dropped to make room for the newest.
+	fanOutSinkQueueLength = 4
+)
+
 // A FanOutDevice is both an AudioSourceDevice and an AudioSinkDevice.
 //
 // Unlike other AudioSourceDevices, a call to GetStream does *not* return the
@@ -19,8 +35,16 @@ import (
 // Once added, there is no manual way to remove a sinkStream.
 // A sinkStream is automatically removed if it does not accept a frame for a certain duration.
 //
-// The input stream (the sourceStream) is listened to and data forwarded (copied) to
-// all sinkStreams. This may be an expensive process.
+// The input stream (the sourceStream) is listened to and data forwarded to
+// all sinkStreams. Frames are not copied: every sink receives the same PooledPCMFrame,
+// holding its own reference to it. Since the frame is shared, sinks must not modify it
+// in place, but call Writable first (copy-on-write), so fanning out to many sinks
+// costs no additional memory bandwidth.
+//
+// Each sinkStream is a bounded queue. Forwarding a frame never blocks: if a sink's queue
+// is full, its oldest frame is dropped (and counted) to make room, so one slow sink never
+// stalls the others. A sink is alive as long as it keeps draining its queue; a single
+// low-frequency sweeper removes sinks which have not accepted a frame within the timeout.
 //
 // Be sure to call SetStream before calls to GetStream to prevent the channels returned
 // by GetStream from timing out before any data is ready to be received.
@@ -28,29 +52,31 @@ import (
 // Adding and removing sinkStreams is concurrency safe thanks to a mutex.
 type FanOutDevice struct {
 	deviceProperties audiodevice.DeviceProperties
-	// A master context to cancel ALL sinks at once
-	// sink channel contexts will be spawned as sub-contexts of this one.
+	// A master context to stop the sweeper, and so all sinks, at once
 	masterContext           context.Context
 	masterContextCancelFunc context.CancelFunc
 
-	sourceStream <-chan frame.PCMFrame
+	sourceStream <-chan *frame.PooledPCMFrame
 
 	sinksMutex sync.RWMutex
 	sinks      []*fanOutSink
+
+	// The time (in UnixNano) the latest frame was fanned out.
+	// Sinks are only timed out relative to this, so a quiet source never times out its sinks.
+	lastFrame atomic.Int64
+
+	// Total frames dropped across all sinks, including removed sinks
+	droppedFrames atomic.Uint64
 }
 
 type fanOutSink struct {
-	ctx       context.Context
-	ctxCancel context.CancelFunc
-	stream    chan frame.PCMFrame
-}
+	stream chan *frame.PooledPCMFrame
 
-// Return a new sink context related to the fanOutDevice.masterContext
-// such that the returned context has a fresh timeout, but is still canceled
-// if the masterContext is canceled
-func (d *FanOutDevice) newSinkContext() (context.Context, context.CancelFunc) {
-	const SINK_TIMEOUT = 5 * time.Second
-	return context.WithTimeout(d.masterContext, SINK_TIMEOUT)
+	// The time (in UnixNano) this sink last accepted a frame without its queue being full
+	lastAccepted atomic.Int64
+
+	// The number of frames dropped because this sink's queue was full
+	droppedFrames atomic.Uint64
 }
 
 // Create a new FanOutDevice.
@@ -73,75 +99,129 @@ func (d *FanOutDevice) GetDeviceProperties() audiodevice.DeviceProperties {
 // Set the stream of this device to copy data from.
 // This method should be called only once, and once the sourceStream is closed
 // then all sinkChannels are closed.
-func (d *FanOutDevice) SetStream(sourceStream <-chan frame.PCMFrame) {
+func (d *FanOutDevice) SetStream(sourceStream <-chan *frame.PooledPCMFrame) {
 	d.sourceStream = sourceStream
 
+	go d.sweep()
 	go func() {
 		for data := range d.sourceStream {
-			d.sinksMutex.Lock()
-			// TODO: One channel blocking here will cause all channels to block.
-			// Current select approach drops data to listeners who can't accept it... is that fine?
+			// One clock read per frame, shared by every sink
+			now := time.Now().UnixNano()
+			d.lastFrame.Store(now)
+
+			d.sinksMutex.RLock()
 			for _, sink := range d.sinks {
-				select {
-				case sink.stream <- data:
-					// We sent some data, let's refresh the sink context
-					// First, cancel the old context
-					sink.ctxCancel()
-					// Then make a new one
-					sink.ctx, sink.ctxCancel = d.newSinkContext()
-				case <-sink.ctx.Done():
-					// The sink didn't respond and has timed out, remove it
-					close(sink.stream)
-					numSinks := len(d.sinks)
-					for i, s := range d.sinks {
-						if s.stream == sink.stream {
-							d.sinks[i] = d.sinks[numSinks-1]
-							d.sinks = d.sinks[:numSinks-1]
-							continue
-						}
-					}
-				default:
-					// We couldn't send data, but the sink hasn't timed out, just move on
-				}
+				sink.send(data, now, &d.droppedFrames)
 			}
-			d.sinksMutex.Unlock()
+			d.sinksMutex.RUnlock()
+			// All sinks hold their own reference, so release the one we received
+			data.Release()
 		}
 		// When sourceStream closes, close this device
 		d.Close()
 	}()
 }
 
+// Queue the given frame on this sink without blocking, dropping the oldest queued frame if
+// the queue is full. The sink takes its own reference to the frame; the caller keeps theirs.
+func (sink *fanOutSink) send(data *frame.PooledPCMFrame, now int64, droppedFrames *atomic.Uint64) {
+	data.Retain()
+	select {
+	case sink.stream <- data:
+		// There was room, so the sink is keeping up
+		sink.lastAccepted.Store(now)
+		return
+	default:
+	}
+
+	// The queue is full: drop the oldest frame to make room for the newest.
+	// The sink may have drained the queue in the meantime, so never block.
+	select {
+	case oldest := <-sink.stream:
+		oldest.Release()
+	default:
+	}
+	sink.droppedFrames.Add(1)
+	droppedFrames.Add(1)
+	select {
+	case sink.stream <- data:
+	default:
+		data.Release()
+	}
+}
+
+// Periodically remove sinks which have not accepted a frame within fanOutSinkTimeout
+// of the latest frame. Returns when this device is closed.
+func (d *FanOutDevice) sweep() {
+	ticker := time.NewTicker(fanOutSweepInterval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ticker.C:
+		case <-d.masterContext.Done():
+			return
+		}
+
+		deadline := d.lastFrame.Load() - int64(fanOutSinkTimeout)
+		d.sinksMutex.Lock()
+		liveSinks := d.sinks[:0]
+		for _, sink := range d.sinks {
+			if sink.lastAccepted.Load() >= deadline {
+				liveSinks = append(liveSinks, sink)
+				continue
+			}
+			// The sink didn't respond and has timed out, remove it
+			slog.Debug("removing timed out fan out sink", "droppedFrames", sink.droppedFrames.Load())
+			sink.close()
+		}
+		clear(d.sinks[len(liveSinks):])
+		d.sinks = liveSinks
+		d.sinksMutex.Unlock()
+	}
+}
+
+// Close the stream of this sink, releasing any frames still queued.
+func (sink *fanOutSink) close() {
+	close(sink.stream)
+	for data := range sink.stream {
+		data.Release()
+	}
+}
+
 // Get a new stream from this fan out device.
 //
 // This method returns a new stream that data from the sourceChannel is copied to.
 // The returned channel must consume data as it arrives and is fanned out.
-// If enough frames are rejected by the channel (e.g. because it is blocking)
+// The channel queues a few frames, but if it falls further behind the oldest frames are dropped.
+// If the channel accepts no frames for a while (e.g. because it is never read)
 // then the channel is closed. The close occurs with a timeout, set to 5 seconds.
 //
 // Be sure to call this method AFTER setStream, otherwise you risk
 // the returned channel closing from a timeout before any data can be written to it!
-func (d *FanOutDevice) GetStream() <-chan frame.PCMFrame {
+func (d *FanOutDevice) GetStream() <-chan *frame.PooledPCMFrame {
 	d.sinksMutex.Lock()
 	defer d.sinksMutex.Unlock()
 
-	sinkCtx, sinkCtxCancel := d.newSinkContext()
 	newSink := &fanOutSink{
-		ctx:       sinkCtx,
-		ctxCancel: sinkCtxCancel,
-		stream:    make(chan frame.PCMFrame),
+		stream: make(chan *frame.PooledPCMFrame, fanOutSinkQueueLength),
 	}
+	newSink.lastAccepted.Store(time.Now().UnixNano())
 	d.sinks = append(d.sinks, newSink)
 
 	return newSink.stream
 }
 
+// The total number of frames dropped because a sink's queue was full.
+func (d *FanOutDevice) DroppedFrames() uint64 {
+	return d.droppedFrames.Load()
+}
+
 func (d *FanOutDevice) Close() {
 	d.sinksMutex.Lock()
 	defer d.sinksMutex.Unlock()
 	d.masterContextCancelFunc()
 	for _, sink := range d.sinks {
-		sink.ctxCancel()
-		close(sink.stream)
+		sink.close()
 	}
 	d.sinks = d.sinks[:0]
 }
@@ -164,6 +244,16 @@ func (d *FanOutDevice) Close() {
 // sending a new frame of audio. This therefore also defines how many samples
 // will exist in the produced frame (SampleRate*NumChannels*frameDuration/1Second).
 // That is, a FanInDevice will always produce frames of a definite size!
+//
+// Alternatively, a FanInDevice may be pulled from by an AudioPullSinkDevice (see Render),
+// in which case the sink decides when, and how many samples, are mixed.
+//
+// In large rooms, only a few sources are ever heard at once. SetMaxActiveSources limits the mix
+// to the loudest sources connected with ConnectWithActivity, and the processing of the other
+// sources is skipped upstream (see PipelineBuilder.MeasureActivity).
+//
+// A FanInDevice may also mix for many listeners at once, each hearing every source but its own
+// (a mix-minus, see ConnectMixMinus and RenderMixMinus), so that the sources are mixed only once.
 type FanInDevice struct {
 	deviceProperties audiodevice.DeviceProperties
 	frameDuration    time.Duration
@@ -173,56 +263,151 @@ type FanInDevice struct {
 
 	shutdownOnce sync.Once
 
-	sourcesMutex sync.RWMutex
-	sources      []*fanInSource
+	// The list of sources is copy-on-write: the mixer loads the current list without locking,
+	// while adding or removing a source copies the list and swaps it in. Hence, sources come
+	// and go without ever blocking a mix. sourcesMutex serializes writers only.
+	sourcesMutex sync.Mutex
+	sources      atomic.Pointer[[]*fanInSource]
 
-	sinkStream chan frame.PCMFrame
-	sinkBuffer frame.PCMFrame
+	// Only one mix may consume from the sources at once. This is uncontended, except
+	// for the moment the device switches from the ticker to being pulled (see Render).
+	mixMutex sync.Mutex
+
+	// The number of sources with a SourceActivity mixed at once, or 0 to mix every source
+	maxActiveSources atomic.Int32
+	// Scratch space to rank sources in, reused by every mix. Guarded by mixMutex.
+	rankedSources []rankedFanInSource
+
+	sinkStream chan *frame.PooledPCMFrame
+
+	// Set once Render is called, after which frames are no longer sent on the sinkStream
+	pulled atomic.Bool
 }
 
+// A single source of a FanInDevice.
+//
+// Samples are held in a lock-free, single-producer single-consumer ring:
+// the listening goroutine is the only writer, and the mixer is the only reader.
 type fanInSource struct {
-	stream     <-chan frame.PCMFrame
-	buffer     frame.PCMFrame
-	mutex      sync.Mutex
-	bufferHead int
-	bufferTail int
+	// Frames arrive on exactly one of stream or ringStream
+	stream     <-chan *frame.PooledPCMFrame
+	ringStream *audiodevice.RingStream
+
+	// If set, the source is only mixed while selected (see FanInDevice.SetMaxActiveSources)
+	activity *SourceActivity
+	// Whether the current mix selected this source. Only used by the mixer.
+	selectedThisMix bool
+
+	// If set, the samples of the source in the latest mix are kept in contribution,
+	// so they can be removed from the mix again (see MixMinus). Only used by the mixer.
+	keepContribution bool
+	contribution     frame.PCMFrame
+	// Whether the source was mixed into the latest mix. Only used by the mixer.
+	contributed bool
+
+	// The ring of samples. Its length is a power of two, so indices wrap with mask.
+	buffer frame.PCMFrame
+	mask   uint64
+
+	// The index of the next sample to be mixed. Only ever advanced by the mixer.
+	head atomic.Uint64
+	_    [56]byte // Keep head and tail on separate cache lines
+	// The index of the next sample to be written. Only ever advanced by the listener.
+	tail atomic.Uint64
 }
 
-func (source *fanInSource) listen() {
-	go func() {
-		for frame := range source.stream {
-			source.mutex.Lock()
+// A source with a SourceActivity, and the energy it was ranked by in the current mix.
+type rankedFanInSource struct {
+	source *fanInSource
+	energy float32
+}
 
-			// If new frame is big enough to handle the entire buffer by itself,
-			// just overwrite all existing data
-			if len(frame) > len(source.buffer) {
-				copy(source.buffer, frame[len(frame)-len(source.buffer):])
-				source.bufferHead = 0
-				source.bufferTail = len(source.buffer)
+// Create a new fanInSource, holding at least bufferLength samples.
+func newFanInSource(bufferLength int) *fanInSource {
+	bufferLength = 1 << bits.Len(uint(bufferLength-1))
+	return &fanInSource{
+		buffer: make(frame.PCMFrame, bufferLength),
+		mask:   uint64(bufferLength - 1),
+	}
+}
 
-				source.mutex.Unlock()
-				continue
-			}
+// Listen for frames on the source's stream, until that stream is closed,
+// then call onClose.
+func (source *fanInSource) listen(onClose func()) {
+	go func() {
+		defer onClose()
+		if source.ringStream != nil {
+			readRingStream(source.ringStream, func(frames []*frame.PooledPCMFrame) {
+				for _, pooledFrame := range frames {
+					source.write(pooledFrame)
+				}
+			})
+			return
+		}
+		for pooledFrame := range source.stream {
+			source.write(pooledFrame)
+		}
+	}()
+}
 
-			// If we are about to overwrite the end of the buffer, loop back to start
-			//
-			// TODO: May cause jitter if head of buffer is overwritten, but...
-			// very unlikely since audio should be consumed faster than this.
-			if len(frame)+source.bufferTail > len(source.buffer) {
-				copy(source.buffer, source.buffer[source.bufferHead:source.bufferTail])
-				source.bufferTail = source.bufferTail - source.bufferHead
-				source.bufferHead = 0
-			}
+// Copy the samples of the given frame into the source ring, then release the frame.
+//
+// If the mixer has fallen so far behind that the ring is full, the samples that do not fit are dropped.
+func (source *fanInSource) write(pooledFrame *frame.PooledPCMFrame) {
+	samples := pooledFrame.Samples()
+	defer pooledFrame.Release()
+
+	tail := source.tail.Load()
+	free := uint64(len(source.buffer)) - (tail - source.head.Load())
+	n := min(uint64(len(samples)), free)
+
+	// Copy in at most two parts, as the free space may wrap around the end of the ring
+	start := tail & source.mask
+	copied := copy(source.buffer[start:], samples[:n])
+	copy(source.buffer, samples[copied:n])
+
+	// Publish the new samples to the mixer
+	source.tail.Store(tail + n)
+}
 
-			// Copy new data in --- we know there must be enough room after tail by above checks
-			copy(source.buffer[source.bufferHead:], frame)
-			source.bufferTail += len(frame)
+// Mix the next len(sinkSamples) samples of this source into sinkSamples, straight from the ring
+// (or through the contribution, if it is kept). Returns whether the source was mixed.
+//
+// If there is not enough data to fill sinkSamples, nothing is taken.
+// If the backlog has grown past half the ring (e.g. the mixer stalled), the oldest samples
+// are skipped first, in whole frames, so that latency cannot build up.
+func (source *fanInSource) mixInto(sinkSamples frame.PCMFrame) bool {
+	need := uint64(len(sinkSamples))
+	head := source.head.Load()
+	available := source.tail.Load() - head
+	if need == 0 || available < need {
+		return false
+	}
+	if available > uint64(len(source.buffer))/2 {
+		head += (available - need) / need * need
+	}
 
-			// data is consumed by fan in device, so that's all she wrote here
+	// Read in at most two parts, as the samples may wrap around the end of the ring
+	start := head & source.mask
+	first := min(need, uint64(len(source.buffer))-start)
+	if source.keepContribution {
+		source.contribution = growBuffer(source.contribution, int(need))
+		copy(source.contribution, source.buffer[start:start+first])
+		copy(source.contribution[first:], source.buffer[:need-first])
+		frame.Accumulate(sinkSamples, source.contribution)
+	} else {
+		frame.Accumulate(sinkSamples[:first], source.buffer[start:start+first])
+		frame.Accumulate(sinkSamples[first:], source.buffer[:need-first])
+	}
 
-			source.mutex.Unlock()
-		}
-	}()
+	// Only now may the listener reuse the space
+	source.head.Store(head + need)
+	return true
+}
+
+// Discard every buffered sample, e.g. while the source is not selected to be mixed.
+func (source *fanInSource) discard() {
+	source.head.Store(source.tail.Load())
 }
 
 // Create a new FanInDevice.
@@ -242,13 +427,9 @@ func NewFanInDevice(properties audiodevice.DeviceProperties, frameDuration time.
 		frameDuration:           frameDuration,
 		masterContext:           masterContext,
 		masterContextCancelFunc: masterContextCancelFunction,
-		sources:                 make([]*fanInSource, 0),
-		sinkStream:              make(chan frame.PCMFrame),
-		// The sink buffer should be large enough to hold PCM frames from any device.
-		// It's incredibly unlikely that one full second of audio will ever arrive,
-		// so leave enough room for this many samples.
-		sinkBuffer: make(frame.PCMFrame, properties.SampleRate*properties.NumChannels),
+		sinkStream:              make(chan *frame.PooledPCMFrame),
 	}
+	d.sources.Store(&[]*fanInSource{})
 	d.startListening()
 
 	return d
@@ -260,9 +441,6 @@ func (d *FanInDevice) startListening() {
 		// We know how large a frame we expected based on the ticker
 		expectedFrameLength := d.deviceProperties.NumChannels * d.deviceProperties.SampleRate * int(d.frameDuration) / int(time.Second)
 
-		// Define the start index of the current output frame
-		sinkBufferHead := 0
-
 		listenTicker := time.NewTicker(d.frameDuration)
 		defer listenTicker.Stop()
 		for {
@@ -272,70 +450,158 @@ func (d *FanInDevice) startListening() {
 				return
 			}
 
-			// The index into the sink buffer at which the frame to be sent ends
-			// The counterpart ot sinkBufferHead
-			sinkBufferTail := sinkBufferHead + expectedFrameLength
-
-			// Check if the largest possible buffer (something of expectedFrameSize)
-			// would overrun the sinkBuffer
-			if sinkBufferTail > len(d.sinkBuffer) {
-				copy(d.sinkBuffer, d.sinkBuffer[sinkBufferHead:])
-				sinkBufferHead = 0
-				sinkBufferTail = expectedFrameLength
-			}
-
-			// Zero out the current frame to be sent
-			clear(d.sinkBuffer[sinkBufferHead:sinkBufferTail])
-
-			// Read frames in from each source (or at least as much as we can)
-			d.sourcesMutex.Lock()
-			for _, source := range d.sources {
-
-				source.mutex.Lock()
-
-				// If there is not enough data to fill the frame, don't take anything.
-				if source.bufferTail-source.bufferHead < expectedFrameLength {
-					source.mutex.Unlock()
-					continue
-				}
-
-				// It is weird, but okay to unlock immediately after this,
-				// since all we *really* care about in concurrency terms is the position of Tail
-				// The underlying data may change, but that's just going to cause glitchy audio,
-				// not differing frame lengths
-
-				frame := source.buffer[source.bufferHead : source.bufferHead+expectedFrameLength]
-				source.bufferHead += expectedFrameLength
-				source.mutex.Unlock()
-
-				for frameIndex := 0; frameIndex < expectedFrameLength; frameIndex += 1 {
-					d.sinkBuffer[sinkBufferHead+frameIndex] += frame[frameIndex]
-				}
+			// The sink pulls audio itself, so there is nothing left to do here
+			if d.pulled.Load() {
+				return
 			}
-			d.sourcesMutex.Unlock()
 
-			// We have read from every source, and have something to send.
-			// Now the existing frame lives at d.sinkBuffer[sinkBufferHead:sinkBufferTail]
-			// So perform a single clipping loop, then send, and update the tail
+			// Mix directly into a pooled frame, which is handed to the sinkStream
+			sinkFrame := frame.GetPooledPCMFrame(expectedFrameLength)
+			d.mix(sinkFrame.Samples())
 
-			for i := sinkBufferHead; i < sinkBufferTail; i += 1 {
-				d.sinkBuffer[i] = max(-1.0, min(1.0, d.sinkBuffer[i]))
-			}
 			select {
 			case <-d.masterContext.Done():
+				sinkFrame.Release()
 				return
-			case d.sinkStream <- d.sinkBuffer[sinkBufferHead:sinkBufferTail]:
+			case d.sinkStream <- sinkFrame:
 			default:
+				sinkFrame.Release()
 			}
-
-			// Update the head to the tail, since we have sent the frame
-			sinkBufferHead = sinkBufferTail
 		}
 		// This goroutine closes when the master context is cancelled,
 		// which occurs when the Close function of this device is called.
 	}()
 }
 
+// Mix the next len(sinkSamples) samples of every source into sinkSamples.
+//
+// Sources without enough buffered data to fill sinkSamples are skipped (and keep their data).
+// The mix is the simple addition of all sources, clipped to values of +/- 1.0.
+//
+// No lock is shared with the sources, so mixing never waits on a source being written to,
+// added, or removed.
+func (d *FanInDevice) mix(sinkSamples frame.PCMFrame) {
+	d.mixMutex.Lock()
+	defer d.mixMutex.Unlock()
+
+	d.mixUnclipped(sinkSamples)
+	// We have read from every source, so perform a single clipping pass.
+	frame.Clip(sinkSamples)
+}
+
+// Mix the next len(sinkSamples) samples of every source into sinkSamples, without clipping.
+// Must be called with mixMutex held.
+func (d *FanInDevice) mixUnclipped(sinkSamples frame.PCMFrame) {
+	// Zero out the frame first, as it may hold stale data
+	clear(sinkSamples)
+
+	sources := *d.sources.Load()
+	d.selectActiveSources(sources)
+	for _, source := range sources {
+		source.contributed = false
+		if source.activity != nil && !source.selectedThisMix {
+			// Any samples still buffered were sent before the source was deselected
+			source.discard()
+			continue
+		}
+		source.contributed = source.mixInto(sinkSamples)
+	}
+}
+
+// Select the sources to be mixed: every source without a SourceActivity, and up to
+// maxActiveSources of the loudest sources with one (or all of them, if maxActiveSources is 0).
+//
+// Selected sources are favoured in the ranking (see SourceActivity.rankingEnergy),
+// so the selection only changes when a source becomes clearly louder than a selected one.
+// Sources that stopped producing frames (e.g. as their silence is suppressed) rank as silent.
+// Must be called with mixMutex held.
+func (d *FanInDevice) selectActiveSources(sources []*fanInSource) {
+	limit := int(d.maxActiveSources.Load())
+	now := time.Now()
+
+	// Keep the loudest `limit` sources in rankedSources, loudest first.
+	// Only a few sources are ever kept, so an insertion sort is cheapest.
+	ranked := d.rankedSources[:0]
+	for _, source := range sources {
+		if source.activity == nil {
+			continue
+		}
+		source.selectedThisMix = limit <= 0
+		if limit <= 0 {
+			continue
+		}
+
+		candidate := rankedFanInSource{source: source, energy: source.activity.rankingEnergy(now)}
+		i := len(ranked)
+		for i > 0 && ranked[i-1].energy < candidate.energy {
+			i -= 1
+		}
+		if i >= limit {
+			continue
+		}
+		if len(ranked) < limit {
+			ranked = append(ranked, rankedFanInSource{})
+		}
+		copy(ranked[i+1:], ranked[i:len(ranked)-1])
+		ranked[i] = candidate
+	}
+	for _, r := range ranked {
+		r.source.selectedThisMix = true
+	}
+	d.rankedSources = ranked
+
+	// Publish the selection, so that deselected sources skip their processing upstream
+	for _, source := range sources {
+		if source.activity != nil {
+			source.activity.selected.Store(source.selectedThisMix)
+		}
+	}
+}
+
+// Limit the mix to the n loudest sources connected with ConnectWithActivity.
+// Sources connected with SetStream or SetRingStream are always mixed, and do not count towards n.
+//
+// If n is 0 (the default), every source is mixed.
+func (d *FanInDevice) SetMaxActiveSources(n int) {
+	d.maxActiveSources.Store(int32(max(n, 0)))
+}
+
+// Render exactly len(out) samples of the mixed sources into out.
+//
+// This is the pull model of the FanInDevice: an AudioPullSinkDevice (e.g. a speaker)
+// calls Render from its own callback, exactly when it needs audio, so the mix is written
+// straight into the device buffer. Once Render is called, the frameDuration ticker is
+// stopped and frames are no longer sent on the stream returned by GetStream.
+//
+// Returns false once this device is closed.
+func (d *FanInDevice) Render(out frame.PCMFrame) bool {
+	if d.masterContext.Err() != nil {
+		return false
+	}
+	d.pulled.Store(true)
+	d.mix(out)
+	return true
+}
+
+// Render the next len(total) samples of the mixed sources into total, as Render does, but without clipping,
+// keeping the contribution of every source connected with ConnectMixMinus to render its mix-minus from.
+//
+// This is the pull model of a FanInDevice mixing for many listeners: every source is mixed once into total,
+// then each listener hears either the full mix (frame.Clip of a copy of total), or, if it contributed to the mix
+// itself, its mix-minus (see MixMinus.Render). Each mix-minus must be rendered before the next call.
+//
+// Returns false once this device is closed.
+func (d *FanInDevice) RenderMixMinus(total frame.PCMFrame) bool {
+	if d.masterContext.Err() != nil {
+		return false
+	}
+	d.pulled.Store(true)
+	d.mixMutex.Lock()
+	defer d.mixMutex.Unlock()
+	d.mixUnclipped(total)
+	return true
+}
+
 func (d *FanInDevice) GetDeviceProperties() audiodevice.DeviceProperties {
 	return d.deviceProperties
 }
@@ -344,25 +610,97 @@ func (d *FanInDevice) GetDeviceProperties() audiodevice.DeviceProperties {
 //
 // The given stream is read from and combined with all other streams set this way.
 // When the given sourceStream is closed, it is removed from this device.
-func (d *FanInDevice) SetStream(sourceStream <-chan frame.PCMFrame) {
+func (d *FanInDevice) SetStream(sourceStream <-chan *frame.PooledPCMFrame) {
+	source := d.newSource()
+	source.stream = sourceStream
+	d.addSource(source)
+}
+
+// Set a new ring stream of this device to receive data from.
+//
+// Identical to SetStream, but frames are read from the RingStream in batches.
+// When the given sourceStream is closed, it is removed from this device.
+func (d *FanInDevice) SetRingStream(sourceStream *audiodevice.RingStream) {
+	source := d.newSource()
+	source.ringStream = sourceStream
+	d.addSource(source)
+}
+
+// Connect the output of source to this device, as audiodevice.Connect would,
+// with the given SourceActivity used to rank the source when limiting the
+// number of sources mixed (see SetMaxActiveSources).
+//
+// The activity should be measured by the source itself (see PipelineBuilder.MeasureActivity),
+// so that the source skips its processing while it is not selected.
+func (d *FanInDevice) ConnectWithActivity(source audiodevice.AudioSourceDevice, activity *SourceActivity) {
+	d.connect(source, activity)
+}
+
+// Connect the output of source to this device, as ConnectWithActivity would (activity may be nil),
+// keeping the contribution of the source to each mix, so that the mix can be rendered without it.
+//
+// Returns the MixMinus of the source, to render the mix heard by the source itself (e.g. a remote peer
+// of a mixing node, which must not hear its own voice back).
+func (d *FanInDevice) ConnectMixMinus(source audiodevice.AudioSourceDevice, activity *SourceActivity) *MixMinus {
+	return &MixMinus{source: d.connect(source, activity, func(newFanInSource *fanInSource) {
+		newFanInSource.keepContribution = true
+	})}
+}
+
+func (d *FanInDevice) connect(source audiodevice.AudioSourceDevice, activity *SourceActivity, options ...func(*fanInSource)) *fanInSource {
+	newFanInSource := d.newSource()
+	newFanInSource.activity = activity
+	if ringSource, ok := source.(audiodevice.RingStreamSourceDevice); ok {
+		newFanInSource.ringStream = ringSource.GetRingStream()
+	} else {
+		newFanInSource.stream = source.GetStream()
+	}
+	for _, option := range options {
+		option(newFanInSource)
+	}
+	d.addSource(newFanInSource)
+	return newFanInSource
+}
+
+// Create a new source, buffering up to one second of audio.
+func (d *FanInDevice) newSource() *fanInSource {
+	return newFanInSource(d.deviceProperties.SampleRate * d.deviceProperties.NumChannels)
+}
+
+// Start listening to the given source, and publish a new list of sources including it.
+func (d *FanInDevice) addSource(newFanInSource *fanInSource) {
 	d.sourcesMutex.Lock()
 	defer d.sourcesMutex.Unlock()
-	newFanInSource := &fanInSource{
-		stream:     sourceStream,
-		buffer:     make(frame.PCMFrame, d.deviceProperties.SampleRate*d.deviceProperties.NumChannels),
-		bufferHead: 0,
-		bufferTail: 0,
-	}
-	newFanInSource.listen()
 
-	d.sources = append(d.sources, newFanInSource)
+	oldSources := *d.sources.Load()
+	newSources := make([]*fanInSource, len(oldSources), len(oldSources)+1)
+	copy(newSources, oldSources)
+	newSources = append(newSources, newFanInSource)
+	d.sources.Store(&newSources)
+
+	newFanInSource.listen(func() { d.removeSource(newFanInSource) })
+}
+
+// Publish a new list of sources excluding the given source.
+func (d *FanInDevice) removeSource(oldFanInSource *fanInSource) {
+	d.sourcesMutex.Lock()
+	defer d.sourcesMutex.Unlock()
+
+	oldSources := *d.sources.Load()
+	newSources := make([]*fanInSource, 0, len(oldSources))
+	for _, source := range oldSources {
+		if source != oldFanInSource {
+			newSources = append(newSources, source)
+		}
+	}
+	d.sources.Store(&newSources)
 }
 
 // Get the output of this FanInDevice.
 //
 // The returned stream combines data from all source streams
 // simply adding these streams together and clipping as required.
-func (d *FanInDevice) GetStream() <-chan frame.PCMFrame {
+func (d *FanInDevice) GetStream() <-chan *frame.PooledPCMFrame {
 	return d.sinkStream
 }
 
@@ -374,6 +712,33 @@ func (d *FanInDevice) Close() {
 		defer d.sourcesMutex.Unlock()
 		d.masterContextCancelFunc()
 		close(d.sinkStream)
-		d.sources = d.sources[:0]
+		d.sources.Store(&[]*fanInSource{})
 	})
 }
+
+// --------------------------------------------------------------------------------
+// Mix Minus
+
+// The mix heard by a single source of a FanInDevice: every source but itself.
+// Created by FanInDevice.ConnectMixMinus, and rendered after each FanInDevice.RenderMixMinus.
+type MixMinus struct {
+	source *fanInSource
+}
+
+// Whether the source contributed to the latest mix, i.e. it was selected (if it has a SourceActivity)
+// and had audio. If not, its mix-minus is the full mix, which may be shared with every other such source.
+func (m *MixMinus) Contributed() bool {
+	return m.source.contributed
+}
+
+// Render the mix-minus of the source into out, from the unclipped total of the latest mix (see FanInDevice.RenderMixMinus):
+// the total, less the contribution of the source, clipped. Only the first min(len(total), len(out)) samples are rendered.
+//
+// Must be called by the goroutine calling RenderMixMinus, before its next call.
+func (m *MixMinus) Render(total frame.PCMFrame, out frame.PCMFrame) {
+	n := copy(out, total)
+	if m.source.contributed {
+		frame.Subtract(out[:n], m.source.contribution)
+	}
+	frame.Clip(out[:n])
+}
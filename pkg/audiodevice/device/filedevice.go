@@ -39,7 +39,7 @@ type FileAudioInputDevice struct {
 	// Closing is a Write mutex, there can be only one,
 	// and it must be exclusive to all Read mutexes
 	sinkStreamMutex sync.RWMutex
-	sinkStream      chan frame.PCMFrame
+	sinkStream      chan *frame.PooledPCMFrame
 }
 
 // Make a new FileAudioInputDevice from a .WAV file (on the audioFilePath).
@@ -101,7 +101,7 @@ func NewFileAudioInputDevice(
 		"samplesPerFrame", samplesPerFrame,
 	)
 
-	dataChannel := make(chan frame.PCMFrame)
+	dataChannel := make(chan *frame.PooledPCMFrame)
 	return FileAudioInputDevice{
 		logger:          logger,
 		uuid:            uuid,
@@ -129,20 +129,22 @@ func (d *FileAudioInputDevice) Play(ctx context.Context) {
 			)
 			return
 		}
-		frame := make(frame.PCMFrame, d.samplesPerFrame)
 
 		ticker := time.NewTicker(d.frameDuration)
 		defer ticker.Stop()
 		for frameStart := 0; frameStart < len(buf.Data); frameStart += d.samplesPerFrame {
 			frameEnd := min(frameStart+d.samplesPerFrame, len(buf.Data))
-			for i := 0; i < frameEnd-frameStart; i += 1 {
-				frame[i] = float32(buf.Data[frameStart+i]) / maxInt16
+			pcmFrame := frame.GetPooledPCMFrame(frameEnd - frameStart)
+			samples := pcmFrame.Samples()
+			for i := range samples {
+				samples[i] = float32(buf.Data[frameStart+i]) / maxInt16
 			}
 
 			select {
 			case <-ticker.C:
-				d.sinkStream <- frame[:frameEnd-frameStart]
+				d.sinkStream <- pcmFrame
 			case <-ctx.Done():
+				pcmFrame.Release()
 				return
 			}
 		}
@@ -164,7 +166,7 @@ func (d *FileAudioInputDevice) Close() {
 	})
 }
 
-func (d *FileAudioInputDevice) GetStream() <-chan frame.PCMFrame {
+func (d *FileAudioInputDevice) GetStream() <-chan *frame.PooledPCMFrame {
 	return d.sinkStream
 }
 
@@ -187,7 +189,7 @@ type FileAudioOutputDevice struct {
 	uuid          uuid.UUID
 	encoder       *wav.Encoder
 	fileHandle    *os.File
-	sourceStream  <-chan frame.PCMFrame
+	sourceStream  <-chan *frame.PooledPCMFrame
 }
 
 // Create a new FileAudioOutputDevice that writes incoming PCM frames to a .WAV file at the specified path.
@@ -221,7 +223,7 @@ func NewFileAudioOutputDevice(
 		"channels", encoder.NumChans,
 	)
 
-	dataChannel := make(chan frame.PCMFrame)
+	dataChannel := make(chan *frame.PooledPCMFrame)
 	ctx, ctxCancelFunc := context.WithCancel(context.Background())
 	return FileAudioOutputDevice{
 		ctx:           ctx,
@@ -248,11 +250,11 @@ func (d FileAudioOutputDevice) close() {
 }
 
 // Set the source channel of this audio device, i.e. where data comes from.
-// Raw audio data (as PCMFrames) will arrive on the given channel.
+// Raw audio data (as PooledPCMFrames) will arrive on the given channel.
 //
 // When this stream is closed, it is assumed the device will be cleaned up
 // (memory will be freed, other channels will be closed, etc)
-func (d FileAudioOutputDevice) SetStream(sourceStream <-chan frame.PCMFrame) {
+func (d FileAudioOutputDevice) SetStream(sourceStream <-chan *frame.PooledPCMFrame) {
 	d.sourceStream = sourceStream
 	const maxInt16 = float32(math.MaxInt16)
 	go func() {
@@ -260,15 +262,22 @@ func (d FileAudioOutputDevice) SetStream(sourceStream <-chan frame.PCMFrame) {
 			SampleRate:  d.encoder.SampleRate,
 			NumChannels: d.encoder.NumChans,
 		}
+		// Reuse the same IntBuffer for every frame, growing it only if a larger frame arrives
+		buf := &goaudio.IntBuffer{
+			Format:         bufFormat,
+			Data:           make([]int, 0),
+			SourceBitDepth: 16,
+		}
 		for pcmFrame := range sourceStream {
-			buf := &goaudio.IntBuffer{
-				Format:         bufFormat,
-				Data:           make([]int, len(pcmFrame)),
-				SourceBitDepth: 16,
+			samples := pcmFrame.Samples()
+			if cap(buf.Data) < len(samples) {
+				buf.Data = make([]int, len(samples))
 			}
-			for i, sample := range pcmFrame {
+			buf.Data = buf.Data[:len(samples)]
+			for i, sample := range samples {
 				buf.Data[i] = int(sample * maxInt16)
 			}
+			pcmFrame.Release()
 
 			err := d.encoder.Write(buf)
 			if err != nil {
@@ -0,0 +1,270 @@
+package device
+
+import (
+	"sync"
+	"sync/atomic"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+// --------------------------------------------------------------------------------
+// Pipeline
+
+// A single stage of a Pipeline.
+// Both audioFormatConversionFunctions and audioAugmentationFunctions are pipelineStages,
+// and follow the same ownership rules: the stage takes ownership of the reference to
+// sourceFrame, and the caller takes ownership of the reference to the returned frame.
+//
+// A stage may drop a frame by releasing it and returning nil, in which case no later stage runs.
+type pipelineStage func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame
+
+// A Pipeline is a fused chain of processing stages (format conversions, augmentations)
+// applied to each frame synchronously, on the calling goroutine.
+//
+// Chaining middle-man devices (e.g. AudioFormatConversionDevice -> AudioAugmentationDevice)
+// costs a goroutine and a handoff per device, per frame. A Pipeline applies the same
+// processing with none of those costs. Construct a Pipeline with a PipelineBuilder, and run
+// it as a device with a PipelineDevice.
+type Pipeline struct {
+	sourceProperties audiodevice.DeviceProperties
+	sinkProperties   audiodevice.DeviceProperties
+
+	stages []pipelineStage
+}
+
+// Process each frame in `in` through every stage of the pipeline, writing the results to
+// the front of `out`. `in` and `out` may be the same slice.
+//
+// Ownership of each frame in `in` is taken by the pipeline, and the caller owns each frame
+// written to `out`. At most min(len(in), len(out)) frames are processed, and frames dropped by
+// a stage are not written, so the number of frames written to `out` is returned.
+func (p *Pipeline) Process(in []*frame.PooledPCMFrame, out []*frame.PooledPCMFrame) int {
+	n := min(len(in), len(out))
+	written := 0
+	for i := 0; i < n; i += 1 {
+		pcmFrame := in[i]
+		for _, stage := range p.stages {
+			pcmFrame = stage(pcmFrame)
+			if pcmFrame == nil {
+				break
+			}
+		}
+		if pcmFrame != nil {
+			out[written] = pcmFrame
+			written += 1
+		}
+	}
+	return written
+}
+
+// The properties of the frames entering this pipeline.
+func (p *Pipeline) GetSourceDeviceProperties() audiodevice.DeviceProperties {
+	return p.sourceProperties
+}
+
+// The properties of the frames leaving this pipeline.
+func (p *Pipeline) GetSinkDeviceProperties() audiodevice.DeviceProperties {
+	return p.sinkProperties
+}
+
+// Builder of Pipelines. Stages are applied in the order they are added.
+//
+// For example, the receiving path of a peer may be built as:
+//
+//	pipeline := NewPipelineBuilder(peerProperties).
+//		ConvertFormat(speakerProperties).
+//		Augment(peerAugmentation).
+//		Build()
+type PipelineBuilder struct {
+	pipeline Pipeline
+}
+
+// Create a new PipelineBuilder for frames with the given properties.
+func NewPipelineBuilder(sourceProperties audiodevice.DeviceProperties) *PipelineBuilder {
+	return &PipelineBuilder{
+		pipeline: Pipeline{
+			sourceProperties: sourceProperties,
+			sinkProperties:   sourceProperties,
+			stages:           make([]pipelineStage, 0),
+		},
+	}
+}
+
+// Add the stages required to convert frames from the current properties of the pipeline
+// to the given sinkProperties. If the properties already match, no stage is added.
+func (b *PipelineBuilder) ConvertFormat(sinkProperties audiodevice.DeviceProperties) *PipelineBuilder {
+	for _, f := range newFormatConversionFunctions(b.pipeline.sinkProperties, sinkProperties) {
+		b.pipeline.stages = append(b.pipeline.stages, pipelineStage(f))
+	}
+	b.pipeline.sinkProperties = sinkProperties
+	return b
+}
+
+// Add the stages of the given AudioAugmentation (e.g. volume control).
+// The AudioAugmentation may still be adjusted after the pipeline is built.
+func (b *PipelineBuilder) Augment(augmentation *AudioAugmentation) *PipelineBuilder {
+	for _, f := range augmentation.augmentationFunctions() {
+		b.pipeline.stages = append(b.pipeline.stages, pipelineStage(f))
+	}
+	return b
+}
+
+// Add a stage measuring the energy of each frame into the given SourceActivity.
+//
+// While the FanInDevice mixing this pipeline's output has not selected the source
+// (see FanInDevice.SetMaxActiveSources), frames are dropped here, so add this stage
+// first to skip the cost of every later stage for sources that would not be heard.
+func (b *PipelineBuilder) MeasureActivity(activity *SourceActivity) *PipelineBuilder {
+	b.pipeline.stages = append(b.pipeline.stages, activity.measureFunction())
+	return b
+}
+
+// Add a stage detecting voice activity into the given VoiceActivityDetector.
+//
+// While the detector suppresses silence, silent frames are dropped here, so add this stage
+// after any stage that changes loudness (e.g. Augment, for a muted microphone) and before the rest.
+func (b *PipelineBuilder) DetectVoiceActivity(detector *VoiceActivityDetector) *PipelineBuilder {
+	b.pipeline.stages = append(b.pipeline.stages, detector.detectFunction())
+	return b
+}
+
+// Build the Pipeline. The builder should not be used after this call.
+func (b *PipelineBuilder) Build() *Pipeline {
+	pipeline := b.pipeline
+	return &pipeline
+}
+
+// --------------------------------------------------------------------------------
+// PipelineDevice
+
+// Middle-man processing device which runs a Pipeline on a single goroutine.
+//
+// The AudioFormatConversionDevice and AudioAugmentationDevice are each a PipelineDevice
+// with a single kind of stage. Where several of these devices would be chained, build
+// one Pipeline with all the stages instead, and run it with one PipelineDevice.
+//
+// This device is both a sink and a source, and supports RingStreams on both sides.
+type PipelineDevice struct {
+	pipeline *Pipeline
+
+	// The stream that data *arrives on*
+	// i.e. the stream that acts like a source, as it produces frames
+	sourceStream <-chan *frame.PooledPCMFrame
+
+	// The stream that data *leaves on*
+	// i.e. the stream that acts like a sink, as it consumes frames
+	// Frames leave on a channel, or a RingStream if GetRingStream was called.
+	sink frameEmitter
+
+	// Set once closed, so that processing stops even if the source is never closed
+	closed       atomic.Bool
+	shutdownOnce sync.Once
+}
+
+// Create a new PipelineDevice, running the given pipeline.
+//
+// Note one must still call SetStream (or SetRingStream), passing in the source,
+// and GetStream (or GetRingStream), to receive the sink, to use this device, in an
+// effort to remain consistent with the device interfaces.
+//
+// This device will only start processing once SetStream is called.
+func NewPipelineDevice(pipeline *Pipeline) *PipelineDevice {
+	return &PipelineDevice{
+		pipeline: pipeline,
+		sink:     newFrameEmitter(),
+	}
+}
+
+// --------------------------------------------------------------------------------
+// AudioSourceDevice Interface
+
+// Get the source stream of this audio device.
+// Raw audio data (as PooledPCMFrames) will arrive on the returned channel.
+func (d *PipelineDevice) GetStream() <-chan *frame.PooledPCMFrame {
+	return d.sink.sinkStream
+}
+
+// Get the source ring stream of this audio device.
+// Once called, raw audio data will arrive on the returned RingStream
+// instead of the channel returned by GetStream.
+// Calling again closes the previously returned RingStream.
+func (d *PipelineDevice) GetRingStream() *audiodevice.RingStream {
+	return d.sink.newRingStream()
+}
+
+// Meaningfully close the AudioSourceDevice, including any cleanup of
+// memory and closing of channels.
+//
+// It is assumed that once closed, this device will transmit no more information,
+// and will consume no more information.
+func (d *PipelineDevice) Close() {
+	d.shutdownOnce.Do(func() {
+		d.closed.Store(true)
+		d.sink.close()
+	})
+}
+
+// WARNING:
+// GetDeviceProperties of the PipelineDevice returns the
+// device properties of the LEAVING data. i.e. the data that exits this device!
+//
+// If you need the properties of the data entering this device, call GetSourceDeviceProperties()
+func (d *PipelineDevice) GetDeviceProperties() audiodevice.DeviceProperties {
+	return d.pipeline.GetSinkDeviceProperties()
+}
+
+func (d *PipelineDevice) GetSourceDeviceProperties() audiodevice.DeviceProperties {
+	return d.pipeline.GetSourceDeviceProperties()
+}
+
+// --------------------------------------------------------------------------------
+// AudioSinkDevice Interface
+
+// Set the source channel of this audio device, i.e. where data comes from.
+// Raw audio data (as PooledPCMFrames) will arrive on the given channel.
+//
+// When this stream is closed, it is assumed the device will be cleaned up
+// (memory will be freed, other channels will be closed, etc)
+func (d *PipelineDevice) SetStream(sourceStream <-chan *frame.PooledPCMFrame) {
+	d.sourceStream = sourceStream
+	go func() {
+		var batch [1]*frame.PooledPCMFrame
+		for pcmFrame := range sourceStream {
+			batch[0] = pcmFrame
+			if !d.process(batch[:]) {
+				return
+			}
+		}
+		// This goroutine dies when incomingAudioStream is closed.
+		d.Close()
+	}()
+}
+
+// Set the source ring stream of this audio device, i.e. where data comes from.
+// Frames are read and processed in batches, and leave on the sink in batches, too.
+//
+// When this stream is closed, it is assumed the device will be cleaned up
+// (memory will be freed, other channels will be closed, etc)
+func (d *PipelineDevice) SetRingStream(sourceStream *audiodevice.RingStream) {
+	go func() {
+		readRingStream(sourceStream, func(frames []*frame.PooledPCMFrame) {
+			d.process(frames)
+		})
+		// This goroutine dies when sourceStream is closed.
+		d.Close()
+	}()
+}
+
+// Run the pipeline over the batch (in place), then send the batch on.
+//
+// Returns false if this device has been closed, in which case the batch is released instead.
+func (d *PipelineDevice) process(frames []*frame.PooledPCMFrame) bool {
+	if d.closed.Load() {
+		releaseFrames(frames)
+		return false
+	}
+	n := d.pipeline.Process(frames, frames)
+	d.sink.emit(frames[:n])
+	return true
+}
@@ -0,0 +1,115 @@
+package device
+
+import (
+	"sync"
+	"sync/atomic"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+// The number of frames read from a RingStream at once by a device.
+const ringStreamBatchSize int = audiodevice.DEFAULT_RING_STREAM_CAPACITY
+
+// The output half of a middle-man device (e.g. AudioFormatConversionDevice).
+//
+// Frames leave on the sinkStream channel, unless a RingStream has been requested
+// with newRingStream (i.e. the device's GetRingStream), in which case they leave on
+// that RingStream instead.
+type frameEmitter struct {
+	sinkStream     chan *frame.PooledPCMFrame
+	sinkRingStream atomic.Pointer[audiodevice.RingStream]
+
+	// A RingStream allows only a single producer, but a device may briefly have two
+	// goroutines emitting while its source is being swapped (see SetStream).
+	// Emitting is serialized so the RingStream only ever sees one writer at a time.
+	// Closing also holds emitMutex, so the sinkStream is never closed while a frame is being sent on it.
+	emitMutex sync.Mutex
+
+	// Closed first by close, to release an emit blocked on a sinkStream that is no longer read
+	done      chan struct{}
+	closeOnce sync.Once
+}
+
+func newFrameEmitter() frameEmitter {
+	return frameEmitter{
+		sinkStream: make(chan *frame.PooledPCMFrame),
+		done:       make(chan struct{}),
+	}
+}
+
+// Create a new RingStream for frames to leave on.
+//
+// A RingStream has a single consumer, so any RingStream previously returned is closed
+// and replaced, allowing its consumer to finish. This lets a device be reconnected to a
+// new downstream device (e.g. when the output device changes).
+func (e *frameEmitter) newRingStream() *audiodevice.RingStream {
+	ring := audiodevice.NewRingStream(audiodevice.DEFAULT_RING_STREAM_CAPACITY)
+	if oldRing := e.sinkRingStream.Swap(ring); oldRing != nil {
+		oldRing.Close()
+	}
+	return ring
+}
+
+// Send the given frames downstream, blocking until they are all accepted.
+// If the downstream RingStream, or the emitter itself, is closed, any frames not accepted are released.
+func (e *frameEmitter) emit(frames []*frame.PooledPCMFrame) {
+	e.emitMutex.Lock()
+	defer e.emitMutex.Unlock()
+	select {
+	case <-e.done:
+		releaseFrames(frames)
+		return
+	default:
+	}
+	if ring := e.sinkRingStream.Load(); ring != nil {
+		written := ring.Write(frames)
+		releaseFrames(frames[written:])
+		return
+	}
+	for i, f := range frames {
+		select {
+		case e.sinkStream <- f:
+		case <-e.done:
+			releaseFrames(frames[i:])
+			return
+		}
+	}
+}
+
+// Close both the channel and the RingStream (if any) frames leave on.
+//
+// This function is idempotent.
+func (e *frameEmitter) close() {
+	e.closeOnce.Do(func() {
+		// Release any emit blocked on either sink first, then wait for it to return before closing the channel
+		close(e.done)
+		if ring := e.sinkRingStream.Load(); ring != nil {
+			ring.Close()
+		}
+		e.emitMutex.Lock()
+		defer e.emitMutex.Unlock()
+		close(e.sinkStream)
+	})
+}
+
+func releaseFrames(frames []*frame.PooledPCMFrame) {
+	for _, f := range frames {
+		f.Release()
+	}
+}
+
+// Read frames from a RingStream in batches of up to ringStreamBatchSize,
+// calling handle on each batch, until the RingStream is closed and drained.
+//
+// handle takes ownership of every frame in the batch, and must not retain the batch slice.
+func readRingStream(sourceStream *audiodevice.RingStream, handle func(frames []*frame.PooledPCMFrame)) {
+	batch := make([]*frame.PooledPCMFrame, ringStreamBatchSize)
+	for {
+		n, ok := sourceStream.Read(batch)
+		if !ok {
+			return
+		}
+		handle(batch[:n])
+	}
+}
@@ -0,0 +1,139 @@
+package device
+
+import (
+	"math"
+	"sync/atomic"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+const (
+	// Smoothing of the energy estimate, as the weight given to each new frame.
+	// Rising energy is tracked quickly, so a new speaker is picked up within a frame or two,
+	// while falling energy is tracked slowly, so short pauses between words do not drop a speaker.
+	sourceActivityAttack  float32 = 0.5
+	sourceActivityRelease float32 = 0.05
+
+	// A selected source keeps its place unless another source is this many times louder,
+	// so that two sources of similar loudness do not flap in and out of the mix.
+	sourceActivityHysteresis float32 = 2
+
+	// A source that has produced no frame for this long is silent. With voice activity detection or discontinuous
+	// transmission (DTX), a source stops sending when it goes quiet, so its energy is no longer updated, and would
+	// otherwise hold the last (loud) estimate forever.
+	sourceActivityTimeout = 500 * time.Millisecond
+)
+
+// SourceActivity tracks how loud a single source of a FanInDevice is, and whether
+// the FanInDevice has selected that source to be mixed.
+//
+// A SourceActivity is shared between the processing of a source (see PipelineBuilder.MeasureActivity),
+// which measures the energy of the source, and the FanInDevice (see FanInDevice.ConnectWithActivity),
+// which ranks sources by their energy when limiting the number of sources mixed at once.
+type SourceActivity struct {
+	// The smoothed mean square of the samples, as the bits of a float32
+	energy atomic.Uint32
+	// When the energy was last updated (as Unix nanoseconds), or 0 if never
+	lastUpdate atomic.Int64
+	// Set by Silence, and cleared by the next update, which starts the estimate afresh.
+	// Only the processing of the source writes the energy, so it is never reset from another goroutine.
+	silenced atomic.Bool
+	// If set, the volume the source is mixed at (see WeightByVolume)
+	volume *AudioAugmentation
+
+	selected atomic.Bool
+}
+
+// Create a new SourceActivity. A new source is selected until a FanInDevice decides otherwise.
+func NewSourceActivity() *SourceActivity {
+	activity := &SourceActivity{}
+	activity.selected.Store(true)
+	return activity
+}
+
+// Weigh the energy of the source by the volume the given augmentation applies to it, so a source that is
+// turned down ranks as quietly as it is heard. The energy is still measured before the augmentation,
+// so a source that is not selected skips it, and a change of volume takes effect immediately.
+//
+// Must be called before the source is processed.
+func (a *SourceActivity) WeightByVolume(augmentation *AudioAugmentation) {
+	a.volume = augmentation
+}
+
+// The smoothed energy (mean square of the samples) of the source, at the volume it is mixed at.
+func (a *SourceActivity) Energy() float32 {
+	if a.silenced.Load() {
+		return 0
+	}
+	energy := math.Float32frombits(a.energy.Load())
+	if a.volume != nil {
+		volume := a.volume.GetVolumeAdjustMagnitude()
+		energy *= volume * volume
+	}
+	return energy
+}
+
+// Whether the source is currently mixed by its FanInDevice.
+func (a *SourceActivity) Selected() bool {
+	return a.selected.Load()
+}
+
+// Forget the energy of the source, e.g. once it will no longer produce audio,
+// so that it does not hold a place among the sources mixed by its FanInDevice.
+//
+// May be called from any goroutine. The source is silent from now on, and the processing of the
+// source starts its estimate afresh on its next frame.
+func (a *SourceActivity) Silence() {
+	a.silenced.Store(true)
+}
+
+// Update the energy estimate with a new frame of samples.
+// Only a single goroutine (i.e. the processing of the source) may call update.
+func (a *SourceActivity) update(samples frame.PCMFrame) {
+	if len(samples) == 0 {
+		return
+	}
+	var sumOfSquares float32
+	for _, sample := range samples {
+		sumOfSquares += sample * sample
+	}
+	meanSquare := sumOfSquares / float32(len(samples))
+
+	var energy float32
+	if !a.silenced.Swap(false) {
+		energy = math.Float32frombits(a.energy.Load())
+	}
+	if meanSquare > energy {
+		energy += sourceActivityAttack * (meanSquare - energy)
+	} else {
+		energy += sourceActivityRelease * (meanSquare - energy)
+	}
+	a.energy.Store(math.Float32bits(energy))
+	a.lastUpdate.Store(time.Now().UnixNano())
+}
+
+// The energy used to rank the source against others at the given time. A selected source is favoured,
+// so it is only replaced by a clearly louder source. A source without a recent frame is silent (see sourceActivityTimeout).
+func (a *SourceActivity) rankingEnergy(now time.Time) float32 {
+	if now.UnixNano()-a.lastUpdate.Load() > int64(sourceActivityTimeout) {
+		return 0
+	}
+	if a.Selected() {
+		return a.Energy() * sourceActivityHysteresis
+	}
+	return a.Energy()
+}
+
+// Measure the energy of each frame. While the source is not selected, the frame is dropped,
+// skipping every later stage of the pipeline (e.g. format conversion).
+func (a *SourceActivity) measureFunction() pipelineStage {
+	return func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame {
+		a.update(sourceFrame.Samples())
+		if !a.Selected() {
+			sourceFrame.Release()
+			return nil
+		}
+		return sourceFrame
+	}
+}
@@ -0,0 +1,116 @@
+package device
+
+import (
+	"sync/atomic"
+	"time"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/audiodevice"
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+const (
+	// A frame is voice if its energy is this many times the noise floor (about 6dB above it)...
+	voiceActivityThresholdRatio float32 = 4
+	// ...and above this absolute energy (about -50dBFS), so that a quiet room is never voice.
+	voiceActivityMinEnergy float32 = 1e-5
+
+	// The noise floor follows falling energy quickly, and rising energy very slowly (as the weight given
+	// to each new frame), so it settles on the background noise between words rather than on speech.
+	voiceActivityNoiseFloorFall float32 = 0.5
+	voiceActivityNoiseFloorRise float32 = 0.001
+	// The lowest noise floor, so that digital silence (e.g. a muted microphone) does not make any noise voice.
+	voiceActivityMinNoiseFloor float32 = 1e-7
+
+	// Speech is held for this long after the last voice frame, so the quiet ends of words
+	// and short pauses between them are not cut.
+	voiceActivityHangover = 300 * time.Millisecond
+)
+
+// VoiceActivityDetector decides whether the audio of a stream (e.g. a microphone) is speech or silence.
+//
+// The detector compares the energy of each frame against an adaptive estimate of the background noise.
+// When silence suppression is enabled (the default), silent frames are dropped, so silence costs nothing
+// downstream: no conversion, no encoding, and no packets sent. The receiver conceals the gap as it would
+// any pause in the stream (see OPUS discontinuous transmission).
+//
+// A VoiceActivityDetector is added to a Pipeline with PipelineBuilder.DetectVoiceActivity.
+type VoiceActivityDetector struct {
+	// The number of samples in voiceActivityHangover
+	hangoverSamples int
+
+	// The smoothed energy of the background noise. Only used by the pipeline goroutine.
+	noiseFloor float32
+	// The number of samples left before speech ends, without more voice. Only used by the pipeline goroutine.
+	hangoverRemaining int
+
+	speaking        atomic.Bool
+	suppressSilence atomic.Bool
+}
+
+// Create a new VoiceActivityDetector for frames with the given properties, with silence suppression enabled.
+func NewVoiceActivityDetector(deviceProperties audiodevice.DeviceProperties) *VoiceActivityDetector {
+	detector := &VoiceActivityDetector{
+		hangoverSamples: int(voiceActivityHangover) * deviceProperties.SampleRate * deviceProperties.NumChannels / int(time.Second),
+		noiseFloor:      voiceActivityMinNoiseFloor,
+	}
+	detector.suppressSilence.Store(true)
+	return detector
+}
+
+// Whether the stream currently holds speech.
+func (d *VoiceActivityDetector) Speaking() bool {
+	return d.speaking.Load()
+}
+
+// Set whether silent frames are dropped. Whether or not they are, Speaking still reports voice activity.
+func (d *VoiceActivityDetector) SetSuppressSilence(suppressSilence bool) {
+	d.suppressSilence.Store(suppressSilence)
+}
+
+// Whether silent frames are dropped.
+func (d *VoiceActivityDetector) GetSuppressSilence() bool {
+	return d.suppressSilence.Load()
+}
+
+// Update the detector with a new frame of samples, returning whether the stream holds speech.
+// Only a single goroutine (i.e. the processing of the stream) may call update.
+func (d *VoiceActivityDetector) update(samples frame.PCMFrame) bool {
+	if len(samples) == 0 {
+		return d.Speaking()
+	}
+	var sumOfSquares float32
+	for _, sample := range samples {
+		sumOfSquares += sample * sample
+	}
+	energy := sumOfSquares / float32(len(samples))
+
+	isVoice := energy > d.noiseFloor*voiceActivityThresholdRatio && energy > voiceActivityMinEnergy
+
+	if energy < d.noiseFloor {
+		d.noiseFloor += voiceActivityNoiseFloorFall * (energy - d.noiseFloor)
+	} else {
+		d.noiseFloor += voiceActivityNoiseFloorRise * (energy - d.noiseFloor)
+	}
+	d.noiseFloor = max(d.noiseFloor, voiceActivityMinNoiseFloor)
+
+	if isVoice {
+		d.hangoverRemaining = d.hangoverSamples
+	} else {
+		d.hangoverRemaining = max(d.hangoverRemaining-len(samples), 0)
+	}
+	speaking := isVoice || d.hangoverRemaining > 0
+	d.speaking.Store(speaking)
+	return speaking
+}
+
+// Detect voice in each frame. While the stream is silent (and silence suppression is enabled),
+// the frame is dropped, skipping every later stage of the pipeline and everything downstream.
+func (d *VoiceActivityDetector) detectFunction() pipelineStage {
+	return func(sourceFrame *frame.PooledPCMFrame) *frame.PooledPCMFrame {
+		if !d.update(sourceFrame.Samples()) && d.GetSuppressSilence() {
+			sourceFrame.Release()
+			return nil
+		}
+		return sourceFrame
+	}
+}
@@ -0,0 +1,200 @@
+package audiodevice
+
+import (
+	"math/bits"
+	"sync/atomic"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+const (
+	// The number of frames a RingStream holds when created by a device.
+	// Kept small, since every frame held in the ring is latency added to the pipeline.
+	DEFAULT_RING_STREAM_CAPACITY int = 8
+
+	// Size of a cache line, used to pad the producer and consumer indices apart
+	// so that the two goroutines do not contend on the same line (false sharing).
+	cacheLineSize = 64
+)
+
+// A RingStream is a lock-free, single-producer single-consumer stream of PooledPCMFrames.
+//
+// A RingStream is an alternative to the unbuffered channels used between devices.
+// Frames are written and read in batches, and the producer or consumer goroutines are
+// only parked when the ring is full or empty respectively. In the common case, passing
+// a frame from one device to the next is a pair of atomic operations rather than a
+// goroutine handoff through the scheduler.
+// BenchmarkStream compares the two.
+//
+// Exactly one goroutine may write to a RingStream, and exactly one goroutine may read from it.
+// Ownership of the reference to each frame is transferred through the ring, just like a channel.
+//
+// Devices that support RingStreams implement RingStreamSourceDevice and/or RingStreamSinkDevice.
+// Use Connect to join two devices with a RingStream where possible.
+type RingStream struct {
+	buffer []*frame.PooledPCMFrame
+	mask   uint64
+
+	// The index of the next frame to be read. Only ever advanced by the consumer.
+	head atomic.Uint64
+	_    [cacheLineSize - 8]byte
+
+	// The index of the next frame to be written. Only ever advanced by the producer.
+	tail atomic.Uint64
+	_    [cacheLineSize - 8]byte
+
+	// Set by the consumer (producer) before parking on an empty (full) ring.
+	// The other side checks the flag after publishing, and only then unparks.
+	consumerParked atomic.Bool
+	producerParked atomic.Bool
+
+	// Wake-up tokens. Buffered with capacity one, so unparking never blocks.
+	notEmpty chan struct{}
+	notFull  chan struct{}
+
+	closed atomic.Bool
+}
+
+// Create a new RingStream holding at least capacity frames.
+// The capacity is rounded up to a power of two.
+func NewRingStream(capacity int) *RingStream {
+	if capacity < 1 {
+		capacity = 1
+	}
+	capacity = 1 << bits.Len(uint(capacity-1))
+	return &RingStream{
+		buffer:   make([]*frame.PooledPCMFrame, capacity),
+		mask:     uint64(capacity - 1),
+		notEmpty: make(chan struct{}, 1),
+		notFull:  make(chan struct{}, 1),
+	}
+}
+
+// The number of frames this ring may hold at once.
+func (r *RingStream) Cap() int {
+	return len(r.buffer)
+}
+
+// The number of frames currently held in the ring.
+func (r *RingStream) Len() int {
+	return int(r.tail.Load() - r.head.Load())
+}
+
+// Write as many of the given frames as fit without blocking, and return the number written.
+// The ring takes ownership of the written frames. Producer only.
+func (r *RingStream) TryWrite(frames []*frame.PooledPCMFrame) int {
+	tail := r.tail.Load()
+	free := uint64(len(r.buffer)) - (tail - r.head.Load())
+	n := min(uint64(len(frames)), free)
+	for i := uint64(0); i < n; i += 1 {
+		r.buffer[(tail+i)&r.mask] = frames[i]
+	}
+	if n > 0 {
+		r.tail.Store(tail + n)
+		r.unpark(&r.consumerParked, r.notEmpty)
+	}
+	return int(n)
+}
+
+// Write all given frames, parking only while the ring is full.
+//
+// Returns the number of frames written, which is less than len(frames) only if the
+// ring was closed. Frames that were not written are still owned by the caller. Producer only.
+func (r *RingStream) Write(frames []*frame.PooledPCMFrame) int {
+	written := 0
+	for written < len(frames) {
+		if r.closed.Load() {
+			return written
+		}
+		n := r.TryWrite(frames[written:])
+		written += n
+		if n > 0 {
+			continue
+		}
+
+		// The ring is full: announce we are parking, then check again before sleeping,
+		// so that a consumer that read in the meantime cannot miss waking us.
+		r.producerParked.Store(true)
+		if r.Len() < len(r.buffer) || r.closed.Load() {
+			r.producerParked.Store(false)
+			continue
+		}
+		<-r.notFull
+	}
+	return written
+}
+
+// Read up to len(frames) frames without blocking, and return the number read.
+// The caller takes ownership of the read frames. Consumer only.
+func (r *RingStream) TryRead(frames []*frame.PooledPCMFrame) int {
+	head := r.head.Load()
+	available := r.tail.Load() - head
+	n := min(uint64(len(frames)), available)
+	for i := uint64(0); i < n; i += 1 {
+		index := (head + i) & r.mask
+		frames[i] = r.buffer[index]
+		r.buffer[index] = nil
+	}
+	if n > 0 {
+		r.head.Store(head + n)
+		r.unpark(&r.producerParked, r.notFull)
+	}
+	return int(n)
+}
+
+// Read up to len(frames) frames, parking only while the ring is empty.
+//
+// Returns the number of frames read, which is at least one unless the ring is closed
+// and fully drained, in which case ok is false. Consumer only.
+func (r *RingStream) Read(frames []*frame.PooledPCMFrame) (n int, ok bool) {
+	for {
+		if n := r.TryRead(frames); n > 0 {
+			return n, true
+		}
+		if r.closed.Load() {
+			// The producer may have written just before closing
+			if n := r.TryRead(frames); n > 0 {
+				return n, true
+			}
+			return 0, false
+		}
+
+		r.consumerParked.Store(true)
+		if r.Len() > 0 || r.closed.Load() {
+			r.consumerParked.Store(false)
+			continue
+		}
+		<-r.notEmpty
+	}
+}
+
+// Close the ring. No more frames may be written, and once the remaining frames
+// are read, Read returns ok = false. Both parked producers and consumers are woken.
+//
+// This function is idempotent.
+func (r *RingStream) Close() {
+	if r.closed.Swap(true) {
+		return
+	}
+	r.consumerParked.Store(false)
+	r.producerParked.Store(false)
+	select {
+	case r.notEmpty <- struct{}{}:
+	default:
+	}
+	select {
+	case r.notFull <- struct{}{}:
+	default:
+	}
+}
+
+// Wake the other side of the ring if it announced it is parking.
+func (r *RingStream) unpark(parked *atomic.Bool, wake chan struct{}) {
+	if !parked.Load() || !parked.CompareAndSwap(true, false) {
+		return
+	}
+	select {
+	case wake <- struct{}{}:
+	default:
+	}
+}
@@ -0,0 +1,57 @@
+package audiodevice
+
+import (
+	"fmt"
+	"testing"
+
+	"github.com/Honorable-Knights-of-the-Roundtable/roundtable/pkg/frame"
+)
+
+// Benchmark passing frames from one goroutine to another, as between two devices:
+// through a RingStream (written and read in batches of several sizes), against an unbuffered channel.
+//
+//	go test ./pkg/audiodevice -run '^$' -bench 'Stream'
+func BenchmarkStream(b *testing.B) {
+	pcmFrame := frame.GetPooledPCMFrame(480)
+	defer pcmFrame.Release()
+
+	for _, batchSize := range []int{1, DEFAULT_RING_STREAM_CAPACITY} {
+		b.Run(fmt.Sprintf("ring/batch=%d", batchSize), func(b *testing.B) {
+			ring := NewRingStream(DEFAULT_RING_STREAM_CAPACITY)
+			writeBatch := make([]*frame.PooledPCMFrame, batchSize)
+			for i := range writeBatch {
+				writeBatch[i] = pcmFrame
+			}
+			readBatch := make([]*frame.PooledPCMFrame, batchSize)
+
+			b.ReportAllocs()
+			b.ResetTimer()
+			go func() {
+				for written := 0; written < b.N; written += batchSize {
+					ring.Write(writeBatch[:min(batchSize, b.N-written)])
+				}
+				ring.Close()
+			}()
+			for {
+				if _, ok := ring.Read(readBatch); !ok {
+					break
+				}
+			}
+		})
+	}
+
+	b.Run("channel/unbuffered", func(b *testing.B) {
+		stream := make(chan *frame.PooledPCMFrame)
+
+		b.ReportAllocs()
+		b.ResetTimer()
+		go func() {
+			for range b.N {
+				stream <- pcmFrame
+			}
+			close(stream)
+		}()
+		for range stream {
+		}
+	})
+}
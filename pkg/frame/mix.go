@@ -0,0 +1,58 @@
+package frame
+
+// Kernels for mixing PCMFrames, e.g. in a FanInDevice.
+//
+// Mixing is the one per-frame cost that grows with the number of sources, so these kernels
+// are vectorized where possible (see mix_amd64.s and mix_arm64.s), with the implementation
+// selected once at startup based on the features of the CPU.
+// Build with the purego tag to use the portable implementation only.
+
+// Implementations of the kernels, selected in init (see mix_amd64.go, mix_arm64.go).
+// Both take slices of equal length.
+var (
+	accumulateKernel = accumulateGeneric
+	clipKernel       = clipGeneric
+)
+
+// Add the samples of src into dst, i.e. dst[i] += src[i].
+// Only the first min(len(dst), len(src)) samples are mixed.
+func Accumulate(dst PCMFrame, src PCMFrame) {
+	n := min(len(dst), len(src))
+	if n == 0 {
+		return
+	}
+	accumulateKernel(dst[:n], src[:n])
+}
+
+// Subtract the samples of src from dst, i.e. dst[i] -= src[i], e.g. to remove one source from a mix.
+// Only the first min(len(dst), len(src)) samples are subtracted.
+//
+// Only a few sources are ever removed from a mix (see FanInDevice.RenderMixMinus), so this is not vectorized.
+func Subtract(dst PCMFrame, src PCMFrame) {
+	n := min(len(dst), len(src))
+	dst, src = dst[:n], src[:n]
+	for i := range dst {
+		dst[i] -= src[i]
+	}
+}
+
+// Clip every sample of dst to the range [-1.0, 1.0].
+func Clip(dst PCMFrame) {
+	if len(dst) == 0 {
+		return
+	}
+	clipKernel(dst)
+}
+
+func accumulateGeneric(dst PCMFrame, src PCMFrame) {
+	src = src[:len(dst)]
+	for i := range dst {
+		dst[i] += src[i]
+	}
+}
+
+func clipGeneric(dst PCMFrame) {
+	for i := range dst {
+		dst[i] = max(-1.0, min(1.0, dst[i]))
+	}
+}
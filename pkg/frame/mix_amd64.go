@@ -0,0 +1,28 @@
+//go:build !purego
+
+package frame
+
+import "golang.org/x/sys/cpu"
+
+func init() {
+	if cpu.X86.HasAVX2 {
+		accumulateKernel = accumulateAVX2
+		clipKernel = clipAVX2
+		return
+	}
+	// SSE2 is part of the amd64 baseline
+	accumulateKernel = accumulateSSE
+	clipKernel = clipSSE
+}
+
+//go:noescape
+func accumulateAVX2(dst PCMFrame, src PCMFrame)
+
+//go:noescape
+func clipAVX2(dst PCMFrame)
+
+//go:noescape
+func accumulateSSE(dst PCMFrame, src PCMFrame)
+
+//go:noescape
+func clipSSE(dst PCMFrame)
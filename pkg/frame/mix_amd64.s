@@ -0,0 +1,242 @@
+//go:build !purego
+
+#include "textflag.h"
+
+// func accumulateAVX2(dst PCMFrame, src PCMFrame)
+// dst[i] += src[i], 32 samples per iteration, then 8, then one at a time.
+TEXT ·accumulateAVX2(SB), NOSPLIT, $0-48
+	MOVQ dst_base+0(FP), DI
+	MOVQ dst_len+8(FP), CX
+	MOVQ src_base+24(FP), SI
+
+accumulateavx2loop32:
+	CMPQ CX, $32
+	JL   accumulateavx2loop8
+	VMOVUPS (DI), Y0
+	VMOVUPS 32(DI), Y1
+	VMOVUPS 64(DI), Y2
+	VMOVUPS 96(DI), Y3
+	VADDPS  (SI), Y0, Y0
+	VADDPS  32(SI), Y1, Y1
+	VADDPS  64(SI), Y2, Y2
+	VADDPS  96(SI), Y3, Y3
+	VMOVUPS Y0, (DI)
+	VMOVUPS Y1, 32(DI)
+	VMOVUPS Y2, 64(DI)
+	VMOVUPS Y3, 96(DI)
+	ADDQ    $128, DI
+	ADDQ    $128, SI
+	SUBQ    $32, CX
+	JMP     accumulateavx2loop32
+
+accumulateavx2loop8:
+	CMPQ    CX, $8
+	JL      accumulateavx2tail
+	VMOVUPS (DI), Y0
+	VADDPS  (SI), Y0, Y0
+	VMOVUPS Y0, (DI)
+	ADDQ    $32, DI
+	ADDQ    $32, SI
+	SUBQ    $8, CX
+	JMP     accumulateavx2loop8
+
+accumulateavx2tail:
+	VZEROUPPER
+
+accumulateavx2loop1:
+	TESTQ CX, CX
+	JE    accumulateavx2done
+	MOVSS (DI), X0
+	ADDSS (SI), X0
+	MOVSS X0, (DI)
+	ADDQ  $4, DI
+	ADDQ  $4, SI
+	DECQ  CX
+	JMP   accumulateavx2loop1
+
+accumulateavx2done:
+	RET
+
+// func clipAVX2(dst PCMFrame)
+// dst[i] = max(-1.0, min(1.0, dst[i])), 32 samples per iteration, then 8, then one at a time.
+TEXT ·clipAVX2(SB), NOSPLIT, $0-24
+	MOVQ dst_base+0(FP), DI
+	MOVQ dst_len+8(FP), CX
+
+	// Broadcast +1.0 into Y8 and -1.0 into Y9
+	MOVL         $0x3f800000, AX
+	MOVQ         AX, X8
+	VBROADCASTSS X8, Y8
+	MOVL         $0xbf800000, AX
+	MOVQ         AX, X9
+	VBROADCASTSS X9, Y9
+
+clipavx2loop32:
+	CMPQ    CX, $32
+	JL      clipavx2loop8
+	VMOVUPS (DI), Y0
+	VMOVUPS 32(DI), Y1
+	VMOVUPS 64(DI), Y2
+	VMOVUPS 96(DI), Y3
+	VMINPS  Y8, Y0, Y0
+	VMINPS  Y8, Y1, Y1
+	VMINPS  Y8, Y2, Y2
+	VMINPS  Y8, Y3, Y3
+	VMAXPS  Y9, Y0, Y0
+	VMAXPS  Y9, Y1, Y1
+	VMAXPS  Y9, Y2, Y2
+	VMAXPS  Y9, Y3, Y3
+	VMOVUPS Y0, (DI)
+	VMOVUPS Y1, 32(DI)
+	VMOVUPS Y2, 64(DI)
+	VMOVUPS Y3, 96(DI)
+	ADDQ    $128, DI
+	SUBQ    $32, CX
+	JMP     clipavx2loop32
+
+clipavx2loop8:
+	CMPQ    CX, $8
+	JL      clipavx2tail
+	VMOVUPS (DI), Y0
+	VMINPS  Y8, Y0, Y0
+	VMAXPS  Y9, Y0, Y0
+	VMOVUPS Y0, (DI)
+	ADDQ    $32, DI
+	SUBQ    $8, CX
+	JMP     clipavx2loop8
+
+clipavx2tail:
+	VZEROUPPER
+
+clipavx2loop1:
+	TESTQ CX, CX
+	JE    clipavx2done
+	MOVSS (DI), X0
+	MINSS X8, X0
+	MAXSS X9, X0
+	MOVSS X0, (DI)
+	ADDQ  $4, DI
+	DECQ  CX
+	JMP   clipavx2loop1
+
+clipavx2done:
+	RET
+
+// func accumulateSSE(dst PCMFrame, src PCMFrame)
+// dst[i] += src[i], 16 samples per iteration, then 4, then one at a time.
+TEXT ·accumulateSSE(SB), NOSPLIT, $0-48
+	MOVQ dst_base+0(FP), DI
+	MOVQ dst_len+8(FP), CX
+	MOVQ src_base+24(FP), SI
+
+accumulatesseloop16:
+	CMPQ   CX, $16
+	JL     accumulatesseloop4
+	MOVUPS (DI), X0
+	MOVUPS 16(DI), X1
+	MOVUPS 32(DI), X2
+	MOVUPS 48(DI), X3
+	MOVUPS (SI), X4
+	MOVUPS 16(SI), X5
+	MOVUPS 32(SI), X6
+	MOVUPS 48(SI), X7
+	ADDPS  X4, X0
+	ADDPS  X5, X1
+	ADDPS  X6, X2
+	ADDPS  X7, X3
+	MOVUPS X0, (DI)
+	MOVUPS X1, 16(DI)
+	MOVUPS X2, 32(DI)
+	MOVUPS X3, 48(DI)
+	ADDQ   $64, DI
+	ADDQ   $64, SI
+	SUBQ   $16, CX
+	JMP    accumulatesseloop16
+
+accumulatesseloop4:
+	CMPQ   CX, $4
+	JL     accumulatesseloop1
+	MOVUPS (DI), X0
+	MOVUPS (SI), X4
+	ADDPS  X4, X0
+	MOVUPS X0, (DI)
+	ADDQ   $16, DI
+	ADDQ   $16, SI
+	SUBQ   $4, CX
+	JMP    accumulatesseloop4
+
+accumulatesseloop1:
+	TESTQ CX, CX
+	JE    accumulatessedone
+	MOVSS (DI), X0
+	ADDSS (SI), X0
+	MOVSS X0, (DI)
+	ADDQ  $4, DI
+	ADDQ  $4, SI
+	DECQ  CX
+	JMP   accumulatesseloop1
+
+accumulatessedone:
+	RET
+
+// func clipSSE(dst PCMFrame)
+// dst[i] = max(-1.0, min(1.0, dst[i])), 16 samples per iteration, then 4, then one at a time.
+TEXT ·clipSSE(SB), NOSPLIT, $0-24
+	MOVQ dst_base+0(FP), DI
+	MOVQ dst_len+8(FP), CX
+
+	// Broadcast +1.0 into X8 and -1.0 into X9
+	MOVL   $0x3f800000, AX
+	MOVQ   AX, X8
+	SHUFPS $0x00, X8, X8
+	MOVL   $0xbf800000, AX
+	MOVQ   AX, X9
+	SHUFPS $0x00, X9, X9
+
+clipsseloop16:
+	CMPQ   CX, $16
+	JL     clipsseloop4
+	MOVUPS (DI), X0
+	MOVUPS 16(DI), X1
+	MOVUPS 32(DI), X2
+	MOVUPS 48(DI), X3
+	MINPS  X8, X0
+	MINPS  X8, X1
+	MINPS  X8, X2
+	MINPS  X8, X3
+	MAXPS  X9, X0
+	MAXPS  X9, X1
+	MAXPS  X9, X2
+	MAXPS  X9, X3
+	MOVUPS X0, (DI)
+	MOVUPS X1, 16(DI)
+	MOVUPS X2, 32(DI)
+	MOVUPS X3, 48(DI)
+	ADDQ   $64, DI
+	SUBQ   $16, CX
+	JMP    clipsseloop16
+
+clipsseloop4:
+	CMPQ   CX, $4
+	JL     clipsseloop1
+	MOVUPS (DI), X0
+	MINPS  X8, X0
+	MAXPS  X9, X0
+	MOVUPS X0, (DI)
+	ADDQ   $16, DI
+	SUBQ   $4, CX
+	JMP    clipsseloop4
+
+clipsseloop1:
+	TESTQ CX, CX
+	JE    clipssedone
+	MOVSS (DI), X0
+	MINSS X8, X0
+	MAXSS X9, X0
+	MOVSS X0, (DI)
+	ADDQ  $4, DI
+	DECQ  CX
+	JMP   clipsseloop1
+
+clipssedone:
+	RET
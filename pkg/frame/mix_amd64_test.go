@@ -0,0 +1,11 @@
+//go:build !purego
+
+package frame
+
+import "golang.org/x/sys/cpu"
+
+// The vectorized kernels of this CPU, each checked against the generic loops.
+var mixTestKernels = []mixTestKernel{
+	{name: "AVX2", accumulate: accumulateAVX2, clip: clipAVX2, supported: cpu.X86.HasAVX2},
+	{name: "SSE", accumulate: accumulateSSE, clip: clipSSE, supported: true},
+}
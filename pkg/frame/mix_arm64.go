@@ -0,0 +1,18 @@
+//go:build !purego
+
+package frame
+
+import "golang.org/x/sys/cpu"
+
+func init() {
+	if cpu.ARM64.HasASIMD {
+		accumulateKernel = accumulateNEON
+		clipKernel = clipNEON
+	}
+}
+
+//go:noescape
+func accumulateNEON(dst PCMFrame, src PCMFrame)
+
+//go:noescape
+func clipNEON(dst PCMFrame)
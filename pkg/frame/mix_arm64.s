@@ -0,0 +1,106 @@
+//go:build !purego
+
+#include "textflag.h"
+
+// func accumulateNEON(dst PCMFrame, src PCMFrame)
+// dst[i] += src[i], 16 samples per iteration, then 4, then one at a time.
+//
+// The Go assembler has no vector FADD, so the sum is computed as dst + src*1.0 with a
+// fused multiply-add (VFMLA). Multiplying by one is exact, so this rounds exactly as FADD.
+TEXT ·accumulateNEON(SB), NOSPLIT, $0-48
+	MOVD dst_base+0(FP), R0
+	MOVD dst_len+8(FP), R2
+	MOVD src_base+24(FP), R1
+
+	// V30 = {1.0, 1.0, 1.0, 1.0}
+	MOVW $0x3f800000, R4
+	VDUP R4, V30.S4
+
+accumulateneonloop16:
+	CMP    $16, R2
+	BLT    accumulateneonloop4
+	VLD1   (R0), [V0.S4, V1.S4, V2.S4, V3.S4]
+	VLD1.P 64(R1), [V4.S4, V5.S4, V6.S4, V7.S4]
+	VFMLA  V30.S4, V4.S4, V0.S4
+	VFMLA  V30.S4, V5.S4, V1.S4
+	VFMLA  V30.S4, V6.S4, V2.S4
+	VFMLA  V30.S4, V7.S4, V3.S4
+	VST1.P [V0.S4, V1.S4, V2.S4, V3.S4], 64(R0)
+	SUB    $16, R2
+	B      accumulateneonloop16
+
+accumulateneonloop4:
+	CMP    $4, R2
+	BLT    accumulateneonloop1
+	VLD1   (R0), [V0.S4]
+	VLD1.P 16(R1), [V4.S4]
+	VFMLA  V30.S4, V4.S4, V0.S4
+	VST1.P [V0.S4], 16(R0)
+	SUB    $4, R2
+	B      accumulateneonloop4
+
+accumulateneonloop1:
+	CBZ    R2, accumulateneondone
+	FMOVS  (R0), F0
+	FMOVS.P 4(R1), F1
+	FADDS  F1, F0
+	FMOVS.P F0, 4(R0)
+	SUB    $1, R2
+	B      accumulateneonloop1
+
+accumulateneondone:
+	RET
+
+// func clipNEON(dst PCMFrame)
+// dst[i] = max(-1.0, min(1.0, dst[i])), 16 samples per iteration, then 4, then one at a time.
+//
+// The Go assembler has no vector FMIN/FMAX, so these are encoded by hand:
+//   FMIN Vk.4S, Vk.4S, V30.4S = 0x4EBEF400 | k<<5 | k
+//   FMAX Vk.4S, Vk.4S, V31.4S = 0x4E3FF400 | k<<5 | k
+TEXT ·clipNEON(SB), NOSPLIT, $0-24
+	MOVD dst_base+0(FP), R0
+	MOVD dst_len+8(FP), R2
+
+	// V30 = {1.0, ...}, V31 = {-1.0, ...}
+	MOVW $0x3f800000, R4
+	VDUP R4, V30.S4
+	MOVW $0xbf800000, R5
+	VDUP R5, V31.S4
+
+clipneonloop16:
+	CMP    $16, R2
+	BLT    clipneonloop4
+	VLD1   (R0), [V0.S4, V1.S4, V2.S4, V3.S4]
+	WORD   $0x4EBEF400 // FMIN V0.4S, V0.4S, V30.4S
+	WORD   $0x4EBEF421 // FMIN V1.4S, V1.4S, V30.4S
+	WORD   $0x4EBEF442 // FMIN V2.4S, V2.4S, V30.4S
+	WORD   $0x4EBEF463 // FMIN V3.4S, V3.4S, V30.4S
+	WORD   $0x4E3FF400 // FMAX V0.4S, V0.4S, V31.4S
+	WORD   $0x4E3FF421 // FMAX V1.4S, V1.4S, V31.4S
+	WORD   $0x4E3FF442 // FMAX V2.4S, V2.4S, V31.4S
+	WORD   $0x4E3FF463 // FMAX V3.4S, V3.4S, V31.4S
+	VST1.P [V0.S4, V1.S4, V2.S4, V3.S4], 64(R0)
+	SUB    $16, R2
+	B      clipneonloop16
+
+clipneonloop4:
+	CMP    $4, R2
+	BLT    clipneonloop1
+	VLD1   (R0), [V0.S4]
+	WORD   $0x4EBEF400 // FMIN V0.4S, V0.4S, V30.4S
+	WORD   $0x4E3FF400 // FMAX V0.4S, V0.4S, V31.4S
+	VST1.P [V0.S4], 16(R0)
+	SUB    $4, R2
+	B      clipneonloop4
+
+clipneonloop1:
+	CBZ     R2, clipneondone
+	FMOVS   (R0), F0
+	FMINS   F30, F0, F0
+	FMAXS   F31, F0, F0
+	FMOVS.P F0, 4(R0)
+	SUB     $1, R2
+	B       clipneonloop1
+
+clipneondone:
+	RET
@@ -0,0 +1,10 @@
+//go:build !purego
+
+package frame
+
+import "golang.org/x/sys/cpu"
+
+// The vectorized kernels of this CPU, each checked against the generic loops.
+var mixTestKernels = []mixTestKernel{
+	{name: "NEON", accumulate: accumulateNEON, clip: clipNEON, supported: cpu.ARM64.HasASIMD},
+}
@@ -0,0 +1,6 @@
+//go:build purego || (!amd64 && !arm64)
+
+package frame
+
+// Only the generic loops are built, so there is no vectorized kernel to check.
+var mixTestKernels = []mixTestKernel{}
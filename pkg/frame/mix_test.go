@@ -0,0 +1,163 @@
+package frame
+
+import (
+	"fmt"
+	"math/rand"
+	"slices"
+	"testing"
+)
+
+// A vectorized implementation of the mixing kernels (see mix_amd64.s, mix_arm64.s).
+type mixTestKernel struct {
+	name       string
+	accumulate func(dst PCMFrame, src PCMFrame)
+	clip       func(dst PCMFrame)
+	// Whether the CPU running the test supports the kernel
+	supported bool
+}
+
+// Lengths covering every tail the kernels handle one sample at a time (below and between multiples of
+// the widest vector loop, 32 samples), as well as whole frames (1920 is 20ms of 48000Hz stereo).
+func mixTestLengths() []int {
+	lengths := make([]int, 0, 80)
+	for length := 1; length <= 70; length++ {
+		lengths = append(lengths, length)
+	}
+	return append(lengths, 127, 128, 129, 480, 959, 960, 1919, 1920, 1921)
+}
+
+// The number of samples past the end of each slice given to a kernel, which it must leave untouched.
+const mixTestGuardLength = 8
+
+// Random samples, mostly beyond [-1.0, 1.0] so that clipping has work to do, followed by mixTestGuardLength guard samples.
+func mixTestSamples(rng *rand.Rand, length int) PCMFrame {
+	samples := make(PCMFrame, length+mixTestGuardLength)
+	for i := range samples {
+		samples[i] = rng.Float32()*4 - 2
+	}
+	return samples
+}
+
+// The index of the first sample (including the guard samples) differing between the frames, or -1 if none does.
+func mismatch(samples PCMFrame, expected PCMFrame) int {
+	for i := range samples {
+		if samples[i] != expected[i] {
+			return i
+		}
+	}
+	return -1
+}
+
+func TestAccumulateKernels(t *testing.T) {
+	for _, kernel := range mixTestKernels {
+		t.Run(kernel.name, func(t *testing.T) {
+			if !kernel.supported {
+				t.Skipf("%s is not supported by this CPU", kernel.name)
+			}
+			rng := rand.New(rand.NewSource(1))
+			for _, length := range mixTestLengths() {
+				dst := mixTestSamples(rng, length)
+				src := mixTestSamples(rng, length)
+				expected := slices.Clone(dst)
+				accumulateGeneric(expected[:length], src[:length])
+
+				kernel.accumulate(dst[:length], src[:length])
+				if i := mismatch(dst, expected); i >= 0 {
+					t.Fatalf("length %d: sample %d accumulated to %v, want %v", length, i, dst[i], expected[i])
+				}
+			}
+		})
+	}
+}
+
+func TestClipKernels(t *testing.T) {
+	for _, kernel := range mixTestKernels {
+		t.Run(kernel.name, func(t *testing.T) {
+			if !kernel.supported {
+				t.Skipf("%s is not supported by this CPU", kernel.name)
+			}
+			rng := rand.New(rand.NewSource(3))
+			for _, length := range mixTestLengths() {
+				dst := mixTestSamples(rng, length)
+				expected := slices.Clone(dst)
+				clipGeneric(expected[:length])
+
+				kernel.clip(dst[:length])
+				if i := mismatch(dst, expected); i >= 0 {
+					t.Fatalf("length %d: sample %d clipped to %v, want %v", length, i, dst[i], expected[i])
+				}
+			}
+		})
+	}
+}
+
+// Accumulate mixes only as many samples as the shorter frame holds, whichever kernel is selected.
+func TestAccumulateMismatchedLengths(t *testing.T) {
+	dst := PCMFrame{1, 1, 1, 1}
+	Accumulate(dst, PCMFrame{0.5, 0.5})
+	if expected := (PCMFrame{1.5, 1.5, 1, 1}); !slices.Equal(dst, expected) {
+		t.Errorf("accumulated %v, want %v", dst, expected)
+	}
+	Accumulate(dst[:1], PCMFrame{0.25, 0.25, 0.25})
+	if expected := (PCMFrame{1.75, 1.5, 1, 1}); !slices.Equal(dst, expected) {
+		t.Errorf("accumulated %v, want %v", dst, expected)
+	}
+}
+
+// Benchmark mixing numSources frames into one, i.e. the mixing of one tick of a FanInDevice,
+// with the kernel selected for this CPU against the generic loop. Build with the purego tag to
+// select the generic loop throughout.
+func BenchmarkAccumulate(b *testing.B) {
+	const frameLength = 1920
+	for _, numSources := range []int{1, 5, 10, 25, 50} {
+		rng := rand.New(rand.NewSource(5))
+		sources := make([]PCMFrame, numSources)
+		for i := range sources {
+			sources[i] = mixTestSamples(rng, frameLength)[:frameLength]
+		}
+		sink := make(PCMFrame, frameLength)
+
+		for _, implementation := range []struct {
+			name       string
+			accumulate func(dst PCMFrame, src PCMFrame)
+		}{
+			{"generic", accumulateGeneric},
+			{"kernel", Accumulate},
+		} {
+			b.Run(fmt.Sprintf("sources=%d/%s", numSources, implementation.name), func(b *testing.B) {
+				b.SetBytes(int64(numSources * frameLength * 4))
+				for range b.N {
+					clear(sink)
+					for _, source := range sources {
+						implementation.accumulate(sink, source)
+					}
+				}
+			})
+		}
+	}
+}
+
+// Benchmark clipping a mixed frame, with the kernel selected for this CPU against the generic loop.
+func BenchmarkClip(b *testing.B) {
+	const frameLength = 1920
+	rng := rand.New(rand.NewSource(7))
+	mix := mixTestSamples(rng, frameLength)[:frameLength]
+	sink := make(PCMFrame, frameLength)
+
+	for _, implementation := range []struct {
+		name string
+		clip func(dst PCMFrame)
+	}{
+		{"generic", clipGeneric},
+		{"kernel", Clip},
+	} {
+		b.Run(implementation.name, func(b *testing.B) {
+			b.SetBytes(frameLength * 4)
+			for range b.N {
+				// Clipped afresh each time, as a clipped frame has no samples left to clip
+				copy(sink, mix)
+				implementation.clip(sink)
+			}
+		})
+	}
+}
@@ -0,0 +1,170 @@
+package frame
+
+import (
+	"math/bits"
+	"sync"
+	"sync/atomic"
+)
+
+const (
+	// The smallest size class of pooled frames is 2**minPoolClassShift samples.
+	// 64 samples is shorter than any frame produced in practice
+	// (8000Hz mono audio at 2.5ms is 20 samples, but is rounded up to this class).
+	minPoolClassShift = 6
+
+	// The largest size class of pooled frames is 2**maxPoolClassShift samples.
+	// As a rough estimate, 48000Hz stereo audio with a duration of 120ms is 11520 samples,
+	// and one full second of that audio is 96000 samples, so 2**17 = 131072 covers anything
+	// a device would reasonably produce. Frames larger than this are allocated outside the pool.
+	maxPoolClassShift = 17
+
+	numPoolClasses = maxPoolClassShift - minPoolClassShift + 1
+)
+
+// A PooledPCMFrame is a reference-counted PCMFrame whose memory is drawn from,
+// and returned to, a set of size-classed pools.
+//
+// PooledPCMFrames are the unit of data passed along the streams between devices.
+// Ownership of a reference is transferred with the frame: a producer that sends a
+// PooledPCMFrame on a stream hands its reference to the consumer, and the consumer
+// must either forward the frame (again transferring the reference) or call Release.
+// A consumer that hands the same frame to several others (e.g. a FanOutDevice) must
+// call Retain once for each additional holder.
+//
+// Once the last reference is released, the underlying memory is returned to the pool
+// and the frame must not be touched again. In this way, the steady state of a pipeline
+// makes no heap allocations per frame.
+//
+// A frame with more than one reference is shared, and its samples are immutable.
+// A stage that needs to modify samples in place must first call Writable, which
+// copies the frame only if it is shared (copy-on-write). This allows one frame to be
+// handed to many consumers (e.g. by a FanOutDevice) without copying and without races.
+type PooledPCMFrame struct {
+	samples PCMFrame
+
+	// The number of outstanding references to this frame.
+	refs atomic.Int32
+
+	// The index into pcmFramePools this frame belongs to, or -1 if the frame
+	// was too large to be pooled.
+	class int
+}
+
+var pcmFramePools [numPoolClasses]sync.Pool
+
+func init() {
+	for i := range pcmFramePools {
+		classSize := 1 << (minPoolClassShift + i)
+		class := i
+		pcmFramePools[i].New = func() any {
+			return &PooledPCMFrame{
+				samples: make(PCMFrame, classSize),
+				class:   class,
+			}
+		}
+	}
+}
+
+// Return the index of the smallest size class that holds length samples,
+// or -1 if no size class is large enough.
+func poolClass(length int) int {
+	if length <= 1<<minPoolClassShift {
+		return 0
+	}
+	shift := bits.Len(uint(length - 1))
+	if shift > maxPoolClassShift {
+		return -1
+	}
+	return shift - minPoolClassShift
+}
+
+// Get a PooledPCMFrame holding exactly length samples, with a single reference
+// owned by the caller.
+//
+// The contents of the returned frame are undefined: callers are expected to
+// overwrite every sample (or call clear on the samples) before sending it on.
+func GetPooledPCMFrame(length int) *PooledPCMFrame {
+	class := poolClass(length)
+	if class < 0 {
+		f := &PooledPCMFrame{
+			samples: make(PCMFrame, length),
+			class:   -1,
+		}
+		f.refs.Store(1)
+		return f
+	}
+
+	f := pcmFramePools[class].Get().(*PooledPCMFrame)
+	f.samples = f.samples[:length]
+	f.refs.Store(1)
+	return f
+}
+
+// Get a PooledPCMFrame holding a copy of the given samples, with a single reference
+// owned by the caller.
+func NewPooledPCMFrameFrom(samples PCMFrame) *PooledPCMFrame {
+	f := GetPooledPCMFrame(len(samples))
+	copy(f.samples, samples)
+	return f
+}
+
+// The samples of this frame.
+//
+// The returned slice is only valid while the caller holds a reference to the frame,
+// and must be treated as read-only unless the frame was returned by Writable.
+func (f *PooledPCMFrame) Samples() PCMFrame {
+	return f.samples
+}
+
+// The number of samples in this frame.
+func (f *PooledPCMFrame) Len() int {
+	return len(f.samples)
+}
+
+// Shorten the frame to the given length, e.g. after writing fewer samples than requested.
+// The length may not exceed the length the frame was created with.
+func (f *PooledPCMFrame) Truncate(length int) {
+	f.samples = f.samples[:length]
+}
+
+// Report whether any other holder has a reference to this frame,
+// in which case its samples must not be modified.
+func (f *PooledPCMFrame) IsShared() bool {
+	return f.refs.Load() > 1
+}
+
+// Return a frame holding the same samples as this frame, which the caller may modify in place.
+//
+// Writable takes ownership of the caller's reference to f. If the caller holds the only
+// reference, f itself is returned. Otherwise the samples are copied into a new pooled frame,
+// and the caller's reference to f is released. Either way, the caller owns the returned frame.
+func (f *PooledPCMFrame) Writable() *PooledPCMFrame {
+	if !f.IsShared() {
+		return f
+	}
+	writable := NewPooledPCMFrameFrom(f.samples)
+	f.Release()
+	return writable
+}
+
+// Add a reference to this frame. Each call to Retain must be paired with a call to Release.
+func (f *PooledPCMFrame) Retain() {
+	f.refs.Add(1)
+}
+
+// Drop a reference to this frame. When the last reference is dropped, the frame is
+// returned to its pool, and must not be used again.
+func (f *PooledPCMFrame) Release() {
+	refs := f.refs.Add(-1)
+	if refs > 0 {
+		return
+	}
+	if refs < 0 {
+		panic("frame: PooledPCMFrame released more times than it was retained")
+	}
+	if f.class < 0 {
+		return
+	}
+	f.samples = f.samples[:cap(f.samples)]
+	pcmFramePools[f.class].Put(f)
+}
@@ -10,6 +10,9 @@ const (
 	//
 	// The endpoint is defined by fmt.Sprintf("%s/%s", localaddress, networking.SIGNAL_ENDPOINT)
 	SIGNAL_ENDPOINT = "signal"
+
+	// Defines the endpoint that ICE candidates are trickled through, once an offer is answered (see SignallingCandidates).
+	CANDIDATES_ENDPOINT = SIGNAL_ENDPOINT + "/candidates"
 )
 
 // Holds all relevant information for the signalling server to route
@@ -28,6 +31,11 @@ type SignallingOffer struct {
 	OfferUUID uuid.UUID
 
 	WebRTCSessionDescription webrtc.SessionDescription
+
+	// Whether the offering peer trickles its ICE candidates. If so, neither description holds candidates:
+	// the answer is sent as soon as it is created, and candidates are exchanged afterwards (see SignallingCandidates),
+	// so that connectivity checks start as soon as the first candidates are known, rather than once every candidate is gathered.
+	TrickleICE bool
 }
 
 // Holds information from answering peer to offering peer
@@ -37,3 +45,20 @@ type SignallingAnswer struct {
 
 	WebRTCSessionDescription webrtc.SessionDescription
 }
+
+// Holds the ICE candidates a peer has gathered since it last sent a SignallingCandidates, for an offer using trickle ICE.
+//
+// The offering peer sends its candidates to the CANDIDATES_ENDPOINT of the answering peer (routed as the offer is),
+// and the answering peer responds with its own, until both have finished gathering.
+type SignallingCandidates struct {
+	// Information about the answering peer, to route the candidates of the offering peer to
+	AnsweringPeerID PeerIdentifier
+
+	// The same UUID as given by the offering client
+	OfferUUID uuid.UUID
+
+	Candidates []webrtc.ICECandidateInit
+
+	// Whether the sending peer has finished gathering, i.e. no more candidates will follow
+	GatheringComplete bool
+}